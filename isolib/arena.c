@@ -0,0 +1,95 @@
+/*!	\file		arena.c
+ * 		\brief	This file implements the arena allocator. \n
+ * 					An allocation moves a pointer forward in the current chunk, a reset moves it back
+ * 					to the start of the first chunk. The chunks are kept, so an arena that is reused for
+ * 					one message after another stops calling malloc once it has grown to the largest message.
+ */
+#include <stdlib.h>
+#include "arena.h"
+
+/*!	\brief	The offset of the data of a chunk, the header is rounded up to 8 bytes */
+#define CHUNK_HDR		((int) ((sizeof(isochunk) + 7) & ~(size_t) 7))
+
+/*!	\brief	The data of a chunk */
+#define CHUNK_DATA(c)	((char*) (c) + CHUNK_HDR)
+
+/*!	\func	void init_arena(isoarena *a, int chunk_size);
+ * 		\brief	Initialize an empty arena, no memory is allocated until ::arena_alloc
+ * 		\param	a is the ::isoarena to initialize
+ * 		\param	chunk_size is the data size of a chunk, 0 for ARENA_CHUNK_SIZE
+ */
+void init_arena(isoarena *a, int chunk_size){
+	a->first = NULL;
+	a->cur = NULL;
+	a->chunk_size = (chunk_size > 0)? chunk_size : ARENA_CHUNK_SIZE;
+}
+
+/*!	\func	void* arena_alloc(isoarena *a, int size);
+ * 		\brief	Allocate memory from an arena. \n
+ * 					The memory is not initialized. It lives until ::reset_arena or ::free_arena.
+ * 		\param	a is an ::isoarena initialized by ::init_arena
+ * 		\param	size is the number of bytes to allocate
+ * 		\return	the allocated memory, aligned on 8 bytes \n
+ * 					NULL if size is negative or malloc fails
+ */
+void* arena_alloc(isoarena *a, int size){
+	isochunk *c = a->cur;
+	void *p;
+
+	if(size < 0)
+		return NULL;
+	size = (size + 7) & ~7;
+	if(c == NULL || c->used + size > c->size){
+		/* the next kept chunk is reused if it is large enough */
+		if(c != NULL && c->next != NULL && size <= c->next->size){
+			c = c->next;
+			c->used = 0;
+		}else{
+			isochunk *n;
+			int chunk_size = (size > a->chunk_size)? size : a->chunk_size;
+			n = (isochunk*) malloc(CHUNK_HDR + chunk_size);
+			if(n == NULL)
+				return NULL;
+			n->size = chunk_size;
+			n->used = 0;
+			/* the new chunk goes after the current one, the kept chunks follow it */
+			if(c == NULL){
+				n->next = a->first;
+				a->first = n;
+			}else{
+				n->next = c->next;
+				c->next = n;
+			}
+			c = n;
+		}
+		a->cur = c;
+	}
+	p = CHUNK_DATA(c) + c->used;
+	c->used += size;
+	return p;
+}
+
+/*!	\func	void reset_arena(isoarena *a);
+ * 		\brief	Give back every allocation of an arena at once. The chunks are kept for the next allocations.
+ * 		\param	a is an ::isoarena initialized by ::init_arena
+ */
+void reset_arena(isoarena *a){
+	a->cur = a->first;
+	if(a->cur != NULL)
+		a->cur->used = 0;
+}
+
+/*!	\func	void free_arena(isoarena *a);
+ * 		\brief	Free the chunks of an arena, it is empty afterwards and can be used again
+ * 		\param	a is an ::isoarena initialized by ::init_arena
+ */
+void free_arena(isoarena *a){
+	isochunk *c = a->first, *next;
+	while(c != NULL){
+		next = c->next;
+		free(c);
+		c = next;
+	}
+	a->first = NULL;
+	a->cur = NULL;
+}
@@ -0,0 +1,46 @@
+/*!	\file		arena.h
+ * 		\brief	A bump pointer allocator whose memory is released all at once
+ */
+#ifndef ARENA_H_
+#define ARENA_H_
+
+/*!	\brief	The default size of an arena chunk, enough for a typical message */
+#define ARENA_CHUNK_SIZE		4096
+
+/*!	\struct		isochunk
+ * 		\brief		A block of arena memory, the data follows the header
+ */
+typedef struct isochunk {
+	/*! \brief The next chunk of the arena */
+	struct isochunk *next;
+	/*! \brief The number of data bytes of the chunk */
+	int size;
+	/*! \brief The number of data bytes given out */
+	int used;
+} isochunk;
+
+/*!	\struct		isoarena
+ * 		\brief		An arena, a chain of chunks that is kept when the arena is reset
+ */
+typedef struct {
+	/*! \brief The first chunk, NULL until something is allocated */
+	isochunk *first;
+	/*! \brief The chunk that allocations come from */
+	isochunk *cur;
+	/*! \brief The data size of the chunks that are added */
+	int chunk_size;
+} isoarena;
+
+/*!	\brief	Initialize an empty arena, chunk_size is 0 for ARENA_CHUNK_SIZE */
+void init_arena(isoarena *a, int chunk_size);
+
+/*!	\brief	Allocate size bytes, aligned on 8 bytes, that live until the arena is reset */
+void* arena_alloc(isoarena *a, int size);
+
+/*!	\brief	Give back every allocation of the arena, its chunks are kept for reuse */
+void reset_arena(isoarena *a);
+
+/*!	\brief	Free the chunks of the arena */
+void free_arena(isoarena *a);
+
+#endif /*ARENA_H_*/
@@ -0,0 +1,83 @@
+/*!	\file		base64.c
+ * 		\brief	This file converts byte arrays to base64 character arrays and back. \n
+ * 					Like the hexa conversion it is table driven and doesn't depend on the locale.
+ */
+#include "base64.h"
+#include "errors.h"
+
+static const char base64_digits[64] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/*!	\brief	The value of each base64 character ORed with 0x40, 0 for the other characters */
+static const unsigned char base64_table[256] = {
+	['A'] = 0x40, ['B'] = 0x41, ['C'] = 0x42, ['D'] = 0x43, ['E'] = 0x44, ['F'] = 0x45, ['G'] = 0x46, ['H'] = 0x47,
+	['I'] = 0x48, ['J'] = 0x49, ['K'] = 0x4A, ['L'] = 0x4B, ['M'] = 0x4C, ['N'] = 0x4D, ['O'] = 0x4E, ['P'] = 0x4F,
+	['Q'] = 0x50, ['R'] = 0x51, ['S'] = 0x52, ['T'] = 0x53, ['U'] = 0x54, ['V'] = 0x55, ['W'] = 0x56, ['X'] = 0x57,
+	['Y'] = 0x58, ['Z'] = 0x59, ['a'] = 0x5A, ['b'] = 0x5B, ['c'] = 0x5C, ['d'] = 0x5D, ['e'] = 0x5E, ['f'] = 0x5F,
+	['g'] = 0x60, ['h'] = 0x61, ['i'] = 0x62, ['j'] = 0x63, ['k'] = 0x64, ['l'] = 0x65, ['m'] = 0x66, ['n'] = 0x67,
+	['o'] = 0x68, ['p'] = 0x69, ['q'] = 0x6A, ['r'] = 0x6B, ['s'] = 0x6C, ['t'] = 0x6D, ['u'] = 0x6E, ['v'] = 0x6F,
+	['w'] = 0x70, ['x'] = 0x71, ['y'] = 0x72, ['z'] = 0x73, ['0'] = 0x74, ['1'] = 0x75, ['2'] = 0x76, ['3'] = 0x77,
+	['4'] = 0x78, ['5'] = 0x79, ['6'] = 0x7A, ['7'] = 0x7B, ['8'] = 0x7C, ['9'] = 0x7D, ['+'] = 0x7E, ['/'] = 0x7F
+};
+
+/*!	\fn		void base64_encode(const char *src, int len, char *dst)
+ * 		\brief	Encode a byte array into base64 characters, the last group is padded with '='
+ * 		\param	src	the bytes to encode
+ * 		\param	len	the number of bytes in src
+ * 		\param	dst	the output buffer, it must hold BASE64_LEN(len) characters. It is not NUL terminated.
+ */
+void base64_encode(const char *src, int len, char *dst){
+	const unsigned char *s = (const unsigned char*) src;
+	unsigned long v;
+	int i;
+	for(i = 0; i + 3 <= len; i += 3, dst += 4){
+		v = (unsigned long) s[i] << 16 | (unsigned long) s[i+1] << 8 | s[i+2];
+		dst[0] = base64_digits[v >> 18];
+		dst[1] = base64_digits[(v >> 12) & 0x3F];
+		dst[2] = base64_digits[(v >> 6) & 0x3F];
+		dst[3] = base64_digits[v & 0x3F];
+	}
+	if(i < len){
+		v = (unsigned long) s[i] << 16 | ((i + 1 < len)? (unsigned long) s[i+1] << 8 : 0);
+		dst[0] = base64_digits[v >> 18];
+		dst[1] = base64_digits[(v >> 12) & 0x3F];
+		dst[2] = (i + 1 < len)? base64_digits[(v >> 6) & 0x3F] : '=';
+		dst[3] = '=';
+	}
+}
+
+/*!	\fn		int base64_decode_strict(const char *src, int len, char *dst, int *dst_len)
+ * 		\brief	Decode base64 characters into a byte array, validating every character
+ * 		\param	src	the base64 characters to decode, only the last group may be padded with '='
+ * 		\param	len	the number of characters in src, it must be a multiple of 4
+ * 		\param	dst	the output buffer, it must hold len/4*3 bytes. Its content is undefined on error.
+ * 		\param	dst_len	receives the number of bytes decoded
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_B64BYT if len is not a multiple of 4 or src contains a non base64 character
+ */
+int base64_decode_strict(const char *src, int len, char *dst, int *dst_len){
+	const unsigned char *s = (const unsigned char*) src;
+	unsigned char valid = 0x40, a, b, c, d;
+	int i, pad = 0, n = 0;
+
+	*dst_len = 0;
+	if(len < 0 || len % 4)
+		return ERR_B64BYT;
+	if(len > 0 && s[len-1] == '='){
+		pad = (s[len-2] == '=')? 2 : 1;
+	}
+	for(i = 0; i < len; i += 4){
+		a = base64_table[s[i]];
+		b = base64_table[s[i+1]];
+		/* the padding characters are taken as 'A', which decodes to 0 */
+		c = (i + 4 == len && pad == 2)? 0x40 : base64_table[s[i+2]];
+		d = (i + 4 == len && pad > 0)? 0x40 : base64_table[s[i+3]];
+		valid &= a & b & c & d;
+		dst[n++] = (char) ((a & 0x3F) << 2 | (b & 0x3F) >> 4);
+		dst[n++] = (char) ((b & 0x0F) << 4 | (c & 0x3F) >> 2);
+		dst[n++] = (char) ((c & 0x03) << 6 | (d & 0x3F));
+	}
+	if(!valid)
+		return ERR_B64BYT;
+	*dst_len = n - pad;
+	return SUCCEEDED;
+}
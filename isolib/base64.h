@@ -0,0 +1,18 @@
+/*!	\file		base64.h
+ * 		\brief	Conversion between byte arrays and base64 character arrays, with the standard alphabet and padding
+ */
+#ifndef BASE64_H_
+#define BASE64_H_
+
+/*!	\brief	The number of characters that encode len bytes */
+#define BASE64_LEN(len)		((((len) + 2) / 3) * 4)
+
+/*!	\brief	Encode len bytes of src into BASE64_LEN(len) characters at dst */
+void base64_encode(const char *src, int len, char *dst);
+
+/*!	\brief	Decode len base64 characters of src into at most len/4*3 bytes at dst, rejecting any non base64 character. \n
+ * 				The decoder works in place, dst may be src.
+ */
+int base64_decode_strict(const char *src, int len, char *dst, int *dst_len);
+
+#endif /*BASE64_H_*/
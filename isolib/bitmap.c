@@ -0,0 +1,85 @@
+/*!	\file		bitmap.c
+ * 		\brief	This file converts the field presence bitmap between its packed form and 64-bit words
+ */
+#include "bitmap.h"
+
+/*!	\fn		static uint64_t reverse_bits(uint64_t x)
+ * 		\brief	Reverse the bit order inside each byte of x. \n
+ * 					In a packed bitmap the first field of a byte is its most significant bit,
+ * 					in an ::isobitmap word it is the least significant one.
+ */
+static uint64_t reverse_bits(uint64_t x){
+	x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+	x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+	x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+	return x;
+}
+
+/*!	\fn		void bitmap_from_bytes(isobitmap *b, const unsigned char *src, int len)
+ * 		\brief	Load a bitmap from its packed binary form
+ * 		\param	b	the bitmap to fill
+ * 		\param	src	the packed bitmap, the first field is the most significant bit of src[0]
+ * 		\param	len	the length of src, 8 for a primary bitmap only or 16
+ */
+void bitmap_from_bytes(isobitmap *b, const unsigned char *src, int len){
+	int i, k;
+	for(i = 0; i < 2; i++){
+		uint64_t w = 0;
+		if(8*i < len){
+			for(k = 0; k < 8; k++)
+				w |= (uint64_t) src[8*i + k] << (8*k);
+		}
+		b->w[i] = reverse_bits(w);
+	}
+}
+
+/*!	\fn		void bitmap_to_bytes(const isobitmap *b, unsigned char *dst, int len)
+ * 		\brief	Store a bitmap in its packed binary form
+ * 		\param	b	the bitmap to store
+ * 		\param	dst	the output buffer, the first field is the most significant bit of dst[0]
+ * 		\param	len	the number of bytes to write, 8 for a primary bitmap only or 16
+ */
+void bitmap_to_bytes(const isobitmap *b, unsigned char *dst, int len){
+	int i, k;
+	for(i = 0; 8*i < len && i < 2; i++){
+		uint64_t w = reverse_bits(b->w[i]);
+		for(k = 0; k < 8; k++)
+			dst[8*i + k] = (unsigned char) (w >> (8*k));
+	}
+}
+
+#if !defined(__GNUC__)
+/*!	\fn		int bitmap_ctz(uint64_t x)
+ * 		\brief	Count the trailing zero bits of a non-zero word
+ */
+int bitmap_ctz(uint64_t x){
+	int n = 0;
+	while(!(x & 1)){
+		x >>= 1;
+		n++;
+	}
+	return n;
+}
+
+/*!	\fn		int bitmap_clz(uint64_t x)
+ * 		\brief	Count the leading zero bits of a non-zero word
+ */
+int bitmap_clz(uint64_t x){
+	int n = 0;
+	while(!(x & 0x8000000000000000ULL)){
+		x <<= 1;
+		n++;
+	}
+	return n;
+}
+
+/*!	\fn		int bitmap_popcount(uint64_t x)
+ * 		\brief	Count the set bits of a word
+ */
+int bitmap_popcount(uint64_t x){
+	int n = 0;
+	for(; x; x &= x - 1)
+		n++;
+	return n;
+}
+#endif
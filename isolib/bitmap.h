@@ -0,0 +1,141 @@
+/*!	\file		bitmap.h
+ * 		\brief	The field presence bitmap of an iso message held as two 64-bit words
+ */
+#ifndef BITMAP_H_
+#define BITMAP_H_
+
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define BITMAP_CTZ(x)			__builtin_ctzll(x)
+#define BITMAP_CLZ(x)			__builtin_clzll(x)
+#define BITMAP_POPCOUNT(x)	__builtin_popcountll(x)
+#else
+#define BITMAP_CTZ(x)			bitmap_ctz(x)
+#define BITMAP_CLZ(x)			bitmap_clz(x)
+#define BITMAP_POPCOUNT(x)	bitmap_popcount(x)
+int bitmap_ctz(uint64_t);
+int bitmap_clz(uint64_t);
+int bitmap_popcount(uint64_t);
+#endif
+
+/*!	\struct	isobitmap
+ * 		\brief	The primary and the secondary bitmap. \n
+ * 					Field i (1..128) is bit (i-1)%64 of w[(i-1)/64], so the present fields are found
+ * 					lowest first by counting trailing zeros. Field 1 flags the secondary bitmap.
+ */
+typedef struct {
+	uint64_t w[2];
+} isobitmap;
+
+/*!	\struct	isofldit
+ * 		\brief	An iterator over the present fields (2..128) of an ::isobitmap
+ */
+typedef struct {
+	/*! \brief The fields of the current word that are not visited yet */
+	uint64_t cur;
+	/*! \brief The next word to visit */
+	uint64_t next;
+	/*! \brief The field number of bit 0 of cur, minus one */
+	int base;
+} isofldit;
+
+/*!	\brief	Remove every field from a bitmap */
+static inline void bitmap_clear(isobitmap *b){
+	b->w[0] = b->w[1] = 0;
+}
+
+/*!	\brief	Mark field idx (1..128) as present */
+static inline void bitmap_set(isobitmap *b, int idx){
+	b->w[(idx-1) >> 6] |= (uint64_t) 1 << ((idx-1) & 63);
+}
+
+/*!	\brief	Mark field idx (1..128) as not present */
+static inline void bitmap_unset(isobitmap *b, int idx){
+	b->w[(idx-1) >> 6] &= ~((uint64_t) 1 << ((idx-1) & 63));
+}
+
+/*!	\brief	Check whether field idx (1..128) is present */
+static inline int bitmap_test(const isobitmap *b, int idx){
+	return (int) ((b->w[(idx-1) >> 6] >> ((idx-1) & 63)) & 1);
+}
+
+/*!	\brief	Count the present fields, field 1 included */
+static inline int bitmap_count(const isobitmap *b){
+	return BITMAP_POPCOUNT(b->w[0]) + BITMAP_POPCOUNT(b->w[1]);
+}
+
+/*!	\brief	Get the highest present field, 0 if none is present */
+static inline int bitmap_last(const isobitmap *b){
+	if(b->w[1])
+		return 128 - BITMAP_CLZ(b->w[1]);
+	if(b->w[0])
+		return 64 - BITMAP_CLZ(b->w[0]);
+	return 0;
+}
+
+/*!	\brief	Count the present fields before field idx (1..128), i.e. the rank of idx among the present fields */
+static inline int bitmap_rank(const isobitmap *b, int idx){
+	int bit = idx - 1;
+	if(bit < 64)
+		return BITMAP_POPCOUNT(b->w[0] & (((uint64_t) 1 << bit) - 1));
+	return BITMAP_POPCOUNT(b->w[0]) + BITMAP_POPCOUNT(b->w[1] & (((uint64_t) 1 << (bit - 64)) - 1));
+}
+
+/*!	\brief	Keep the fields of b that are also present in mask */
+static inline void bitmap_and(isobitmap *b, const isobitmap *mask){
+	b->w[0] &= mask->w[0];
+	b->w[1] &= mask->w[1];
+}
+
+/*!	\brief	Keep the fields first..last of b, remove the others */
+static inline void bitmap_keep_range(isobitmap *b, int first, int last){
+	int k, lo, hi;
+	uint64_t m;
+	for(k = 0; k < 2; k++){
+		/* the bits lo..hi-1 of word k are kept */
+		lo = first - 1 - 64*k;
+		hi = last - 64*k;
+		if(lo < 0)
+			lo = 0;
+		if(hi > 64)
+			hi = 64;
+		if(lo >= hi){
+			b->w[k] = 0;
+			continue;
+		}
+		m = (hi == 64)? ~(uint64_t) 0 : (((uint64_t) 1 << hi) - 1);
+		m &= ~(((uint64_t) 1 << lo) - 1);
+		b->w[k] &= m;
+	}
+}
+
+/*!	\brief	Start iterating the present fields of b, from field 2. b may change afterwards. */
+static inline void fldit_init(isofldit *it, const isobitmap *b){
+	it->cur = b->w[0] & ~(uint64_t) 1;
+	it->next = b->w[1];
+	it->base = 1;
+}
+
+/*!	\brief	Get the next present field of the iteration, 0 when all of them are visited */
+static inline int fldit_next(isofldit *it){
+	int bit;
+	while(it->cur == 0){
+		if(it->base > 1)
+			return 0;
+		it->cur = it->next;
+		it->next = 0;
+		it->base = 65;
+	}
+	bit = BITMAP_CTZ(it->cur);
+	it->cur &= it->cur - 1;
+	return it->base + bit;
+}
+
+/*!	\brief	Load a bitmap from its packed binary form, len is 8 or 16 bytes */
+void bitmap_from_bytes(isobitmap *b, const unsigned char *src, int len);
+
+/*!	\brief	Store a bitmap in its packed binary form, len is 8 or 16 bytes */
+void bitmap_to_bytes(const isobitmap *b, unsigned char *dst, int len);
+
+#endif /*BITMAP_H_*/
@@ -0,0 +1,278 @@
+/*!	\file		bytebuf.c
+ * 		\brief	This file implements the growable byte buffer. \n
+ * 					The data may start anywhere in the memory of the buffer: a trim from the left moves
+ * 					the start forward and a pad on the left takes back the room it left. The data is moved
+ * 					only when one side runs out of room, and the memory grows geometrically when both do,
+ * 					so a run of appends costs a constant time per byte.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "bytebuf.h"
+#include "errors.h"
+
+/*!	\brief	The room before the data of a buffer */
+#define FRONT_ROOM(b)	((int) ((b)->data.bytes - (b)->base))
+
+/*!	\brief	The room after the data of a buffer */
+#define BACK_ROOM(b)	((b)->capacity - FRONT_ROOM(b) - (b)->data.length)
+
+/*!	\func	static int make_room(bytebuf *b, int front, int back)
+ * 		\brief	Make sure that the buffer has front bytes of room before its data and back bytes after it
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_OVRLEN if the buffer would be longer than INT_MAX \n
+ * 					ERR_OUTMEM if the memory can't grow
+ */
+static int make_room(bytebuf *b, int front, int back){
+	int need, cap;
+	char *p;
+
+	if(b->base != NULL && FRONT_ROOM(b) >= front && BACK_ROOM(b) >= back)
+		return SUCCEEDED;
+	if(front > INT_MAX - back || b->data.length > INT_MAX - front - back)
+		return ERR_OVRLEN;
+	need = front + b->data.length + back;
+
+	/* the memory is large enough, the data is only misplaced */
+	if(b->base != NULL && b->capacity >= need){
+		memmove(b->base + front, b->data.bytes, b->data.length);
+		b->data.bytes = b->base + front;
+		return SUCCEEDED;
+	}
+
+	cap = (b->capacity > 0)? b->capacity : BYTEBUF_MIN_CAPACITY;
+	while(cap < need)
+		cap = (cap > INT_MAX / 2)? need : cap * 2;
+
+	if(front == 0){
+		/* realloc may extend the memory in place */
+		if(b->base != NULL && b->data.bytes != b->base)
+			memmove(b->base, b->data.bytes, b->data.length);
+		p = (char*) realloc(b->base, cap);
+		if(p == NULL)
+			return ERR_OUTMEM;
+	}else{
+		p = (char*) malloc(cap);
+		if(p == NULL)
+			return ERR_OUTMEM;
+		if(b->data.length > 0)
+			memcpy(p + front, b->data.bytes, b->data.length);
+		free(b->base);
+	}
+	b->base = p;
+	b->capacity = cap;
+	b->data.bytes = p + front;
+	return SUCCEEDED;
+}
+
+/*!	\func	void init_bytebuf(bytebuf *b);
+ * 		\brief	Initialize an empty buffer, the memory is allocated by the first store
+ * 		\param	b is the ::bytebuf to initialize
+ */
+void init_bytebuf(bytebuf *b){
+	empty_bytes(&b->data);
+	b->base = NULL;
+	b->capacity = 0;
+}
+
+/*!	\func	int bytebuf_reserve(bytebuf *b, int len);
+ * 		\brief	Make sure that len more bytes can be appended to a buffer without allocating
+ * 		\param	b is a ::bytebuf initialized by ::init_bytebuf
+ * 		\param	len is the number of bytes to make room for
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_IVLLEN if len is negative \n
+ * 					ERR_OUTMEM if the memory can't grow
+ */
+int bytebuf_reserve(bytebuf *b, int len){
+	if(len < 0)
+		return ERR_IVLLEN;
+	return make_room(b, 0, len);
+}
+
+/*!	\func	int bytebuf_append(bytebuf *b, const char *src, int len);
+ * 		\brief	Append bytes at the end of the data of a buffer
+ * 		\param	b is a ::bytebuf initialized by ::init_bytebuf
+ * 		\param	src is the bytes to append, it must not point inside b
+ * 		\param	len is the length of src
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_IVLLEN if len is negative \n
+ * 					ERR_OUTMEM if the memory can't grow
+ */
+int bytebuf_append(bytebuf *b, const char *src, int len){
+	int err;
+	if(len < 0)
+		return ERR_IVLLEN;
+	err = make_room(b, 0, len);
+	if(err != SUCCEEDED)
+		return err;
+	memcpy(b->data.bytes + b->data.length, src, len);
+	b->data.length += len;
+	return SUCCEEDED;
+}
+
+/*!	\func	int bytebuf_insert(bytebuf *b, int pos, const char *src, int len);
+ * 		\brief	Insert bytes into the data of a buffer. \n
+ * 					The shorter side of the data is moved: the head into the room before the data when
+ * 					there is enough of it, else the tail.
+ * 		\param	b is a ::bytebuf initialized by ::init_bytebuf
+ * 		\param	pos is the offset of the data at which src is inserted, 0 to the length of the data
+ * 		\param	src is the bytes to insert, it must not point inside b
+ * 		\param	len is the length of src
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_IVLPOS if pos is out of the data \n
+ * 					ERR_IVLLEN if len is negative \n
+ * 					ERR_OUTMEM if the memory can't grow
+ */
+int bytebuf_insert(bytebuf *b, int pos, const char *src, int len){
+	int err;
+	if(pos < 0 || pos > b->data.length)
+		return ERR_IVLPOS;
+	if(len < 0)
+		return ERR_IVLLEN;
+	if(len == 0)
+		return SUCCEEDED;
+	if(b->base != NULL && pos < b->data.length / 2 && FRONT_ROOM(b) >= len){
+		memmove(b->data.bytes - len, b->data.bytes, pos);
+		b->data.bytes -= len;
+	}else{
+		err = make_room(b, 0, len);
+		if(err != SUCCEEDED)
+			return err;
+		memmove(b->data.bytes + pos + len, b->data.bytes + pos, b->data.length - pos);
+	}
+	memcpy(b->data.bytes + pos, src, len);
+	b->data.length += len;
+	return SUCCEEDED;
+}
+
+/*!	\func	int bytebuf_left_pad(bytebuf *b, int max_len, char ch);
+ * 		\brief	Pad the left side of the data of a buffer with a character. \n
+ * 					The padding takes the room before the data, the data is moved only if it is too small.
+ * 		\param	b is a ::bytebuf initialized by ::init_bytebuf
+ * 		\param	max_len is the length of the data after padding
+ * 		\param	ch is the character to pad with
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_OVRLEN if the data is longer than max_len \n
+ * 					ERR_OUTMEM if the memory can't grow
+ */
+int bytebuf_left_pad(bytebuf *b, int max_len, char ch){
+	int pad = max_len - b->data.length, err;
+	if(pad < 0)
+		return ERR_OVRLEN;
+	err = make_room(b, pad, 0);
+	if(err != SUCCEEDED)
+		return err;
+	b->data.bytes -= pad;
+	memset(b->data.bytes, ch, pad);
+	b->data.length = max_len;
+	return SUCCEEDED;
+}
+
+/*!	\func	int bytebuf_right_pad(bytebuf *b, int max_len, char ch);
+ * 		\brief	Pad the right side of the data of a buffer with a character
+ * 		\param	b is a ::bytebuf initialized by ::init_bytebuf
+ * 		\param	max_len is the length of the data after padding
+ * 		\param	ch is the character to pad with
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_OVRLEN if the data is longer than max_len \n
+ * 					ERR_OUTMEM if the memory can't grow
+ */
+int bytebuf_right_pad(bytebuf *b, int max_len, char ch){
+	int pad = max_len - b->data.length, err;
+	if(pad < 0)
+		return ERR_OVRLEN;
+	err = make_room(b, 0, pad);
+	if(err != SUCCEEDED)
+		return err;
+	memset(b->data.bytes + b->data.length, ch, pad);
+	b->data.length = max_len;
+	return SUCCEEDED;
+}
+
+/*!	\func	void bytebuf_left_trim(bytebuf *b, char ch);
+ * 		\brief	Trim a character from the left side of the data of a buffer. \n
+ * 					Nothing is moved, the data starts later and the room before it grows.
+ * 		\param	b is a ::bytebuf initialized by ::init_bytebuf
+ * 		\param	ch is the character to trim
+ */
+void bytebuf_left_trim(bytebuf *b, char ch){
+	int i = 0;
+	while(i < b->data.length && b->data.bytes[i] == ch)
+		i++;
+	b->data.bytes += i;
+	b->data.length -= i;
+}
+
+/*!	\func	void bytebuf_right_trim(bytebuf *b, char ch);
+ * 		\brief	Trim a character from the right side of the data of a buffer
+ * 		\param	b is a ::bytebuf initialized by ::init_bytebuf
+ * 		\param	ch is the character to trim
+ */
+void bytebuf_right_trim(bytebuf *b, char ch){
+	while(b->data.length > 0 && b->data.bytes[b->data.length - 1] == ch)
+		b->data.length--;
+}
+
+/*!	\func	int bytebuf_slice(const bytebuf *b, int pos, int len, bytes *out);
+ * 		\brief	Refer to a part of the data of a buffer without copying it. \n
+ * 					out must not be freed, it is valid until the buffer is changed.
+ * 		\param	b is a ::bytebuf initialized by ::init_bytebuf
+ * 		\param	pos is the offset of the part in the data
+ * 		\param	len is the length of the part
+ * 		\param	out receives the part
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_IVLPOS if the part is out of the data
+ */
+int bytebuf_slice(const bytebuf *b, int pos, int len, bytes *out){
+	if(pos < 0 || len < 0 || pos > b->data.length - len)
+		return ERR_IVLPOS;
+	out->bytes = b->data.bytes + pos;
+	out->length = len;
+	return SUCCEEDED;
+}
+
+/*!	\func	void bytebuf_adopt(bytebuf *b, bytes *src);
+ * 		\brief	Take the memory of a bytes struct, the data is not copied. \n
+ * 					The memory of src must come from malloc, e.g. from ::import_data. src is emptied.
+ * 		\param	b is a ::bytebuf initialized by ::init_bytebuf, its own memory is freed
+ * 		\param	src is the bytes struct to take
+ */
+void bytebuf_adopt(bytebuf *b, bytes *src){
+	free(b->base);
+	b->base = src->bytes;
+	b->capacity = (src->bytes != NULL)? src->length : 0;
+	b->data = *src;
+	empty_bytes(src);
+}
+
+/*!	\func	void bytebuf_detach(bytebuf *b, bytes *dst);
+ * 		\brief	Give the data of a buffer to a bytes struct, the data is moved to the start of the
+ * 					memory so that ::free_bytes can free it. The buffer is left empty.
+ * 		\param	b is a ::bytebuf initialized by ::init_bytebuf
+ * 		\param	dst receives the data
+ */
+void bytebuf_detach(bytebuf *b, bytes *dst){
+	if(b->base != NULL && b->data.bytes != b->base)
+		memmove(b->base, b->data.bytes, b->data.length);
+	dst->bytes = b->base;
+	dst->length = b->data.length;
+	init_bytebuf(b);
+}
+
+/*!	\func	void clear_bytebuf(bytebuf *b);
+ * 		\brief	Drop the data of a buffer, its memory is kept for the next data
+ * 		\param	b is a ::bytebuf initialized by ::init_bytebuf
+ */
+void clear_bytebuf(bytebuf *b){
+	b->data.bytes = b->base;
+	b->data.length = 0;
+}
+
+/*!	\func	void free_bytebuf(bytebuf *b);
+ * 		\brief	Free the memory of a buffer, it is left empty and can be used again
+ * 		\param	b is a ::bytebuf initialized by ::init_bytebuf
+ */
+void free_bytebuf(bytebuf *b){
+	free(b->base);
+	init_bytebuf(b);
+}
@@ -0,0 +1,65 @@
+/*!	\file		bytebuf.h
+ * 		\brief	A growable byte buffer that keeps room on both sides of its data
+ */
+#ifndef BYTEBUF_H_
+#define BYTEBUF_H_
+
+#include "utilities.h"
+
+/*!	\brief	The smallest capacity a buffer grows to */
+#define BYTEBUF_MIN_CAPACITY		32
+
+/*!	\struct		bytebuf
+ * 		\brief		A byte buffer with a capacity. \n
+ * 						data is a ::bytes struct that points inside the memory of the buffer, it can be passed
+ * 						to the functions that read a ::bytes struct but must not be freed or reallocated by them.
+ */
+typedef struct {
+	/*! \brief The data of the buffer, data.bytes is between base and base + capacity */
+	bytes data;
+	/*! \brief The memory of the buffer, NULL until something is stored */
+	char *base;
+	/*! \brief The size of the memory of the buffer */
+	int capacity;
+} bytebuf;
+
+/*!	\brief	Initialize an empty buffer, nothing is allocated */
+void init_bytebuf(bytebuf *b);
+
+/*!	\brief	Make sure that len more bytes can be appended without allocating */
+int bytebuf_reserve(bytebuf *b, int len);
+
+/*!	\brief	Append len bytes at the end of the data of a buffer */
+int bytebuf_append(bytebuf *b, const char *src, int len);
+
+/*!	\brief	Insert len bytes at an offset of the data of a buffer */
+int bytebuf_insert(bytebuf *b, int pos, const char *src, int len);
+
+/*!	\brief	Pad the left side of the data of a buffer up to max_len bytes */
+int bytebuf_left_pad(bytebuf *b, int max_len, char ch);
+
+/*!	\brief	Pad the right side of the data of a buffer up to max_len bytes */
+int bytebuf_right_pad(bytebuf *b, int max_len, char ch);
+
+/*!	\brief	Trim a character from the left side of the data of a buffer */
+void bytebuf_left_trim(bytebuf *b, char ch);
+
+/*!	\brief	Trim a character from the right side of the data of a buffer */
+void bytebuf_right_trim(bytebuf *b, char ch);
+
+/*!	\brief	Refer to a part of the data of a buffer without copying it */
+int bytebuf_slice(const bytebuf *b, int pos, int len, bytes *out);
+
+/*!	\brief	Take the memory of a bytes struct allocated by ::import_data */
+void bytebuf_adopt(bytebuf *b, bytes *src);
+
+/*!	\brief	Give the data of a buffer to a bytes struct that ::free_bytes can free */
+void bytebuf_detach(bytebuf *b, bytes *dst);
+
+/*!	\brief	Drop the data of a buffer, its memory is kept */
+void clear_bytebuf(bytebuf *b);
+
+/*!	\brief	Free the memory of a buffer */
+void free_bytebuf(bytebuf *b);
+
+#endif /*BYTEBUF_H_*/
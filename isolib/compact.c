@@ -0,0 +1,249 @@
+/*!	\file		compact.c
+ * 		\brief	This file stores ISO messages in a compact layout. \n
+ * 					An ::isomsg holds 129 field slots and a heap block per present field. A compact message
+ * 					holds a slot per present field only, found by the popcount rank of the field in the
+ * 					presence bitmap. Short fields live in their slot, the longer ones in a data block
+ * 					that follows the slots in the same allocation.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compact.h"
+#include "errors.h"
+
+/*!	\brief	The data block of a compact message */
+#define COMPACT_DATA(c)	((char*) ((c)->slot + bitmap_count(&(c)->present)))
+
+/*!	\func	static void set_slot(cfield *f, const char *fld, int fld_len, char *data, int *data_len)
+ * 		\brief	Fill a slot, the data goes inline or at the end of the data block
+ */
+static void set_slot(cfield *f, const char *fld, int fld_len, char *data, int *data_len){
+	f->length = fld_len;
+	if(fld_len <= COMPACT_INLINE){
+		memcpy(f->data.bytes, fld, fld_len);
+	}else{
+		f->data.offset = *data_len;
+		memcpy(data + *data_len, fld, fld_len);
+		*data_len += fld_len;
+	}
+}
+
+/*!	\func	static int build(isocompact *c, const isobitmap *present, const char *base, const fldview *vfld, const bytes *mfld, isoerr *e)
+ * 		\brief	Allocate and fill the slots of the present fields, the errors are recorded into e. \n
+ * 					The fields are either views into base (vfld) or bytes structs (mfld).
+ */
+static int build(isocompact *c, const isobitmap *present, const char *base, const fldview *vfld, const bytes *mfld, isoerr *e){
+	isofldit it;
+	const char *p;
+	char *data;
+	int i, k, len, long_len = 0, data_len = 0;
+
+	/* size the data block */
+	fldit_init(&it, present);
+	while((i = fldit_next(&it)) != 0){
+		len = (vfld != NULL)? vfld[i].length : mfld[i].length;
+		if(len > COMPACT_INLINE)
+			long_len += len;
+	}
+	c->present = *present;
+	c->slot = (cfield*) malloc(bitmap_count(present) * sizeof(cfield) + long_len + 1);
+	if(c->slot == NULL){
+		bitmap_clear(&c->present);
+		return fail_isoerr(e, ERR_OUTMEM, -1, -1, long_len, -1, -1);
+	}
+	data = COMPACT_DATA(c);
+	fldit_init(&it, present);
+	for(k = 0; (i = fldit_next(&it)) != 0; k++){
+		if(vfld != NULL){
+			p = base + vfld[i].offset;
+			len = vfld[i].length;
+		}else{
+			p = mfld[i].bytes;
+			len = mfld[i].length;
+		}
+		set_slot(&c->slot[k], p, len, data, &data_len);
+	}
+	return SUCCEEDED;
+}
+
+/*!	\func	void init_compact(isocompact *c);
+ * 		\brief	Initialize an empty compact message
+ * 		\param	c is the ::isocompact to initialize
+ */
+void init_compact(isocompact *c){
+	c->def = NULL;
+	c->plan = NULL;
+	memset(&c->prop, '\0', sizeof(c->prop));
+	bitmap_clear(&c->present);
+	c->mti.length = 0;
+	c->slot = NULL;
+}
+
+/*!	\func	int compact_message(isocompact *c, const isomsg *m);
+ * 		\brief	Store the MTI and the fields of an ISO message into a compact message. \n
+ * 					The previous content of c is freed. The definition, properties and plan of m are kept.
+ * 					An error is recorded into the error context of m, see ::set_errctx.
+ * 		\param	c is an ::isocompact initialized by ::init_compact
+ * 		\param	m is the message to store, it is not modified
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_IVLFLD if the MTI is missing or longer than COMPACT_INLINE \n
+ * 					ERR_OUTMEM if the memory can't be allocated
+ */
+int compact_message(isocompact *c, const isomsg *m){
+	isoerr local, *e = (m->err != NULL)? m->err : &local;
+	isobitmap present;
+
+	e->code = SUCCEEDED;
+	free_compact(c);
+	if(m->fld[0].bytes == NULL || m->fld[0].length <= 0 || m->fld[0].length > COMPACT_INLINE)
+		return report_isoerr(m->err, e, fail_isoerr(e, ERR_IVLFLD, 0, -1, COMPACT_INLINE, m->fld[0].length, -1));
+	c->def = m->def;
+	c->plan = m->plan;
+	c->prop = m->prop;
+	/* the MTI always fits its slot */
+	c->mti.length = m->fld[0].length;
+	memcpy(c->mti.data.bytes, m->fld[0].bytes, m->fld[0].length);
+	message_bitmap(m, &present);
+	bitmap_unset(&present, 1);
+	return report_isoerr(m->err, e, build(c, &present, NULL, NULL, m->fld, e));
+}
+
+/*!	\func	int compact_view(isocompact *c, isoview *v);
+ * 		\brief	Store the MTI and the fields of an ISO message view into a compact message. \n
+ * 					The view is indexed if it is not yet. Empty variable length fields are dropped,
+ * 					as ::unpack_message does. The previous content of c is freed. An error is recorded
+ * 					into the error context of v, see ::set_view_errctx.
+ * 		\param	c is an ::isocompact initialized by ::init_compact
+ * 		\param	v is an ::isoview opened by ::open_view or unpacked by ::unpack_view
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_IVLFLD if the MTI is missing or longer than COMPACT_INLINE \n
+ * 					ERR_OUTMEM if the memory can't be allocated \n
+ * 					the error of ::index_view
+ */
+int compact_view(isocompact *c, isoview *v){
+	isoerr local, *e = (v->err != NULL)? v->err : &local;
+	isobitmap present;
+	isofldit it;
+	int i, err;
+
+	free_compact(c);
+	err = index_view(v);
+	if(err != SUCCEEDED)
+		return err;
+	e->code = SUCCEEDED;
+	if(v->fld[0].length <= 0 || v->fld[0].length > COMPACT_INLINE)
+		return report_isoerr(v->err, e, fail_isoerr(e, ERR_IVLFLD, 0, v->fld[0].offset, COMPACT_INLINE, v->fld[0].length, -1));
+	c->def = v->def;
+	c->plan = v->plan;
+	c->prop = v->prop;
+	/* the MTI is not at the start of every view, e.g. of a snapshot record */
+	c->mti.length = v->fld[0].length;
+	memcpy(c->mti.data.bytes, v->buf + v->fld[0].offset, v->fld[0].length);
+	present = v->bitmap;
+	bitmap_unset(&present, 1);
+	fldit_init(&it, &v->bitmap);
+	while((i = fldit_next(&it)) != 0)
+		if(v->fld[i].length == 0)
+			bitmap_unset(&present, i);
+	return report_isoerr(v->err, e, build(c, &present, v->buf, v->fld, NULL, e));
+}
+
+/*!	\func	int compact_field(const isocompact *c, int idx, const char **fld, int *fld_len);
+ * 		\brief	Get the location of a field of a compact message, in constant time
+ * 		\param	c is an ::isocompact
+ * 		\param	idx is index of the field to be retrieved, 0 or 2..128
+ * 		\param	fld receives a pointer to the field data, which lives as long as c
+ * 		\param	fld_len receives the length of the field data
+ * 		\return	SUCCEEDED if the field is present \n
+ * 					ERR_IVLFLD if idx is out of range or the field is not present
+ */
+int compact_field(const isocompact *c, int idx, const char **fld, int *fld_len){
+	const cfield *f;
+	if(idx == 0){
+		f = &c->mti;
+	}else{
+		if(idx < 2 || idx > 128 || !bitmap_test(&c->present, idx))
+			return ERR_IVLFLD;
+		f = &c->slot[bitmap_rank(&c->present, idx)];
+	}
+	if(f->length == 0)
+		return ERR_IVLFLD;
+	*fld = (f->length <= COMPACT_INLINE)? f->data.bytes : COMPACT_DATA(c) + f->data.offset;
+	*fld_len = f->length;
+	return SUCCEEDED;
+}
+
+/*!	\func	int pack_compact(const isocompact *c, char *buf, int buf_size, int *buf_len, isoerr *err);
+ * 		\brief	Pack a compact message into a caller-owned buffer, as ::pack_message_buf does for an ::isomsg
+ * 		\param	c is an ::isocompact
+ * 		\param	buf is the caller's buffer, it may be NULL to only compute the packed length
+ * 		\param	buf_size is the number of bytes available in buf
+ * 		\param	buf_len receives the packed length, which is the required size when buf is too small
+ * 		\param	err is the error context that receives the error, NULL to log the error
+ * 		\return	SUCCEEDED(0) if having no error. \n
+ * 					ERR_SHTBUF if buf is too small, *buf_len holds the required size \n
+ * 					error number if having another error
+ */
+int pack_compact(const isocompact *c, char *buf, int buf_size, int *buf_len, isoerr *err){
+	isoplan tmp_plan;
+	const isoplan *plan = c->plan;
+	bytes fld[129];
+	isofldit it;
+	int i, ret;
+
+	*buf_len = 0;
+	if(plan == NULL){
+		if(c->def == NULL)
+			return ERR_IVLFLD;
+		ret = compile_plan(&tmp_plan, c->def, &c->prop, err);
+		if(ret != SUCCEEDED)
+			return ret;
+		plan = &tmp_plan;
+	}
+	/* only the entries of the present fields are read by the packer */
+	if(compact_field(c, 0, (const char**) &fld[0].bytes, &fld[0].length) != SUCCEEDED)
+		empty_bytes(&fld[0]);
+	fldit_init(&it, &c->present);
+	while((i = fldit_next(&it)) != 0)
+		compact_field(c, i, (const char**) &fld[i].bytes, &fld[i].length);
+	return pack_fields(plan, &c->present, fld, buf, buf_size, buf_len, err);
+}
+
+/*!	\func	int expand_compact(const isocompact *c, isomsg *m);
+ * 		\brief	Copy the MTI and the fields of a compact message into an ISO message
+ * 		\param	c is an ::isocompact
+ * 		\param	m is an ::isomsg initialized by ::init_message, its previous content is freed
+ * 		\return	SUCCEEDED if having no error \n
+ * 					the error of ::set_field
+ */
+int expand_compact(const isocompact *c, isomsg *m){
+	const char *fld;
+	isofldit it;
+	int i, len, err;
+
+	free_message(m);
+	fldit_init(&it, &c->present);
+	i = 0;
+	do{
+		if(compact_field(c, i, &fld, &len) != SUCCEEDED)
+			continue;
+		err = set_field(m, i, fld, len);
+		if(err != SUCCEEDED){
+			free_message(m);
+			return err;
+		}
+	}while((i = fldit_next(&it)) != 0);
+	return SUCCEEDED;
+}
+
+/*!	\func	void free_compact(isocompact *c);
+ * 		\brief	Free the memory of a compact message, it is empty afterwards
+ * 		\param	c is an ::isocompact initialized by ::init_compact
+ */
+void free_compact(isocompact *c){
+	if(c->slot != NULL)
+		free(c->slot);
+	c->slot = NULL;
+	bitmap_clear(&c->present);
+	c->mti.length = 0;
+}
@@ -0,0 +1,67 @@
+/*!	\file		compact.h
+ * 		\brief	A compact layout of an ISO message for keeping many of them in memory
+ */
+#ifndef COMPACT_H_
+#define COMPACT_H_
+
+#include "iso8583.h"
+
+/*!	\brief	The fields that are not longer than this are held in their slot */
+#define COMPACT_INLINE		16
+
+/*!	\struct		cfield
+ * 		\brief		The slot of a present field
+ */
+typedef struct {
+	/*! \brief The length of the field data */
+	int length;
+	union {
+		/*! \brief The data of a field of up to COMPACT_INLINE bytes */
+		char bytes[COMPACT_INLINE];
+		/*! \brief The offset of the data of a longer field in the data block */
+		int offset;
+	} data;
+} cfield;
+
+/*!	\struct		isocompact
+ * 		\brief		An ISO message held as a presence bitmap and the slots of the present fields only. \n
+ * 						The slots are ordered by field number, so the slot of a field is its rank in the bitmap.
+ * 						The slots and the data of the long fields share one allocation.
+ */
+typedef struct {
+	/*! \brief The iso definition that the fields conform to */
+	const isodef *def;
+	/*! \brief The compiled plan of def and prop, NULL if it has to be compiled on each call */
+	const isoplan *plan;
+	/*! \brief Properties of the message */
+	msgprop prop;
+	/*! \brief The present fields 2..128 */
+	isobitmap present;
+	/*! \brief The MTI */
+	cfield mti;
+	/*! \brief The slots of the present fields, followed by the data of the long fields */
+	cfield *slot;
+} isocompact;
+
+/*!	\brief	Initialize an empty compact message */
+void init_compact(isocompact *c);
+
+/*!	\brief	Store the fields of an ISO message into a compact message */
+int compact_message(isocompact *c, const isomsg *m);
+
+/*!	\brief	Store the fields of an ISO message view into a compact message */
+int compact_view(isocompact *c, isoview *v);
+
+/*!	\brief	Get the location of a field of a compact message, the data is not copied */
+int compact_field(const isocompact *c, int idx, const char **fld, int *fld_len);
+
+/*!	\brief	Pack a compact message into a caller-owned buffer */
+int pack_compact(const isocompact *c, char *buf, int buf_size, int *buf_len, isoerr *err);
+
+/*!	\brief	Copy the fields of a compact message into an ISO message */
+int expand_compact(const isocompact *c, isomsg *m);
+
+/*!	\brief	Free the memory of a compact message */
+void free_compact(isocompact *c);
+
+#endif /*COMPACT_H_*/
@@ -0,0 +1,196 @@
+/*
+ * Differential test of the xml conversion: the documents of the usual form are read without the
+ * parser, the others with it, and both must give the same message or the same error. Random
+ * documents are converted as they are, then with a comment after the root element, which makes
+ * them go through the parser.
+ *
+ * 	usage: convert-test [count [seed]]		300000 documents by default
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "iso8583.h"
+#include "iso8583_std.h"
+#include "errors.h"
+#include "convert.h"
+
+#define DOC_SIZE	8192
+
+static unsigned long seed = 8583;
+
+/* a small generator so that a seed gives the same documents everywhere */
+static int rnd(int n)
+{
+	seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+	return (int) ((seed >> 33) % (unsigned long) n);
+}
+
+static int put(char *doc, int len, const char *s)
+{
+	int n = strlen(s);
+	if(len + n >= DOC_SIZE)
+		return len;
+	memcpy(doc + len, s, n + 1);
+	return len + n;
+}
+
+static int put_space(char *doc, int len)
+{
+	static const char *space[] = {"", " ", "  ", "\n", "\t", "\r\n "};
+	return put(doc, len, space[rnd(100) < 80? 0 : rnd(6)]);
+}
+
+/* the index of a field, mostly one of the definition */
+static void make_index(char *s)
+{
+	static const char *bad[] = {"1", "129", "999", "", "x", "-2", " 3", "3 ", "0011", "&#52;"};
+	if(rnd(100) < 95)
+		sprintf(s, "%d", (rnd(4) == 0)? 0 : 2 + rnd(127));
+	else
+		strcpy(s, bad[rnd(10)]);
+}
+
+/* a value of a field of the definition, sometimes of the wrong kind or length */
+static void make_value(int idx, char *s)
+{
+	static const char digits[] = "0123456789";
+	static const char alnum[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789 ";
+	static const char hexa[] = "0123456789ABCDEFabcdef";
+	static const char *odd[] = {"&amp;", "&lt;", "\xC3\xA9", "'", "\"", ">", "\t", "&#65;", "G", "-"};
+	const char *set = alnum;
+	int i, n, max = 20, fixed = 0;
+
+	if(idx >= 0 && idx <= 128){
+		max = iso87[idx].flds;
+		fixed = (iso87[idx].lenflds == 0);
+		if(iso87[idx].format == ISO_BINARY){
+			set = hexa;
+			max *= 2;
+		}else if(iso87[idx].format == ISO_NUMERIC){
+			set = digits;
+		}
+	}
+	if(rnd(20) == 0)
+		n = rnd(max + 4);
+	else
+		n = (fixed || rnd(2) == 0)? max : rnd(max + 1);
+	if(n > 200)
+		n = 200;
+	for(i = 0; i < n; i++)
+		s[i] = set[rnd(strlen(set))];
+	s[i] = '\0';
+	if(rnd(20) == 0)
+		strcat(s, odd[rnd(10)]);
+}
+
+/* an attribute, its value is quoted with either quote unless it contains that quote */
+static int put_attr(char *doc, int len, const char *name, const char *value)
+{
+	char q[2] = {(rnd(2) == 0)? '"' : '\'', '\0'};
+	if(strchr(value, q[0]) != NULL)
+		q[0] = (q[0] == '"')? '\'' : '"';
+	len = put(doc, len, " ");
+	len = put_space(doc, len);
+	len = put(doc, len, name);
+	len = put_space(doc, len);
+	len = put(doc, len, "=");
+	len = put_space(doc, len);
+	len = put(doc, len, q);
+	len = put(doc, len, value);
+	return put(doc, len, q);
+}
+
+static int make_field(char *doc, int len, int mti)
+{
+	char id[16], value[256], other[256];
+	int idx, order = rnd(50);
+
+	if(mti)
+		strcpy(id, "0");
+	else
+		make_index(id);
+	idx = atoi(id);
+	make_value(idx, value);
+	len = put(doc, len, "<field");
+	if(order == 0){
+		len = put_attr(doc, len, "value", value);
+		len = put_attr(doc, len, "id", id);
+	}else{
+		len = put_attr(doc, len, "id", id);
+		if(order != 1)
+			len = put_attr(doc, len, "value", value);
+	}
+	/* the attributes that the fast path leaves to the parser */
+	switch(rnd(40)){
+		case 0:
+			make_value(idx, other);
+			len = put_attr(doc, len, "value", other);
+			break;
+		case 1:
+			make_index(other);
+			len = put_attr(doc, len, "id", other);
+			break;
+		case 2:
+			len = put_attr(doc, len, "type", "n");
+			break;
+		case 3:
+			len = put_attr(doc, len, "Value", value);
+			break;
+	}
+	len = put_space(doc, len);
+	return put(doc, len, (rnd(100) == 0)? "></field>" : "/>");
+}
+
+static int make_document(char *doc)
+{
+	int i, n = rnd(12), len = 0;
+
+	doc[0] = '\0';
+	if(rnd(3) == 0)
+		len = put(doc, len, (rnd(10) == 0)? "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" : "<?xml version='1.0'?>");
+	len = put_space(doc, len);
+	len = put(doc, len, "<isomsg");
+	len = put_space(doc, len);
+	len = put(doc, len, ">");
+	for(i = 0; i < n; i++){
+		len = put_space(doc, len);
+		len = make_field(doc, len, i == 0 && rnd(20) != 0);
+	}
+	len = put_space(doc, len);
+	len = put(doc, len, "</isomsg>");
+	return put_space(doc, len);
+}
+
+int main(int argc, char **argv)
+{
+	msgprop prop = {BMP_BINARY, ' ', '0'};
+	xmlctx x;
+	isoerr err;
+	char doc[DOC_SIZE + 16], iso1[ISO_MAX_LENGTH], iso2[ISO_MAX_LENGTH];
+	long i, count = (argc > 1)? atol(argv[1]) : 300000, failed = 0, packed = 0;
+	int len, len1, len2, err1, err2;
+
+	if(argc > 2)
+		seed = strtoul(argv[2], NULL, 10);
+	if(init_xmlctx(&x) != SUCCEEDED)
+		return 1;
+	/* most documents are not valid, their errors are compared instead of logged */
+	set_xml_errctx(&x, &err);
+	for(i = 0; i < count; i++){
+		len = make_document(doc);
+		err1 = xmlctx_to_iso(&x, doc, len, iso87, &prop, iso1, sizeof(iso1), &len1);
+		memcpy(doc + len, "<!---->", 8);
+		err2 = xmlctx_to_iso(&x, doc, len + 7, iso87, &prop, iso2, sizeof(iso2), &len2);
+		if(err1 != err2 || (err1 == SUCCEEDED && (len1 != len2 || memcmp(iso1, iso2, len1) != 0))){
+			doc[len] = '\0';
+			printf("document %ld: %d without the parser, %d with it\n%s\n", i, err1, err2, doc);
+			if(++failed == 10)
+				break;
+		}
+		if(err1 == SUCCEEDED)
+			packed++;
+	}
+	free_xmlctx(&x);
+	printf("convert-test: %ld documents, %ld packed, %s\n", i, packed, failed? "FAILED" : "passed");
+	return failed? 1 : 0;
+}
@@ -4,138 +4,557 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include	 <string.h>
-#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
 #include "expat.h"
 #include "convert.h"
 #include "errors.h"
 #include "iso8583.h"
+#include "hexa.h"
 
+/*!	\brief	The result of ::scan_fast for a document that must go through the parser */
+#define XML_FALLBACK	-1
 
+/*!	\func	int write_iso_xml(isowriter *w, const isoplan *plan, const char *iso_msg, int iso_len, isoerr *err);
+ * 		\brief	Write a packed iso message in xml format, without unpacking it. \n
+ * 					The fields are located in the packed buffer and written from it as they are, binary
+ * 					ones hexa encoded on the fly. Nothing is allocated per field or per message.
+ * 		\param	w is the ::isowriter that receives the xml
+ * 		\param	plan is an ::isoplan compiled by ::compile_plan
+ * 		\param	iso_msg is the packed message
+ * 		\param	iso_len is the length of iso_msg
+ * 		\param	err is the error context that receives the error, NULL to log the error
+ * 		\return	SUCCEEDED if having no error \n
+ * 					the error of ::unpack_view, nothing is written then \n
+ * 					the error of the writer
+ */
+int write_iso_xml(isowriter *w, const isoplan *plan, const char *iso_msg, int iso_len, isoerr *err){
+	isoview v;
+	int ret;
+	init_view_plan(&v, plan);
+	set_view_errctx(&v, err);
+	ret = open_view(&v, iso_msg, iso_len);
+	if(ret != SUCCEEDED)
+		return ret;
+	return write_view(w, &v, FMT_XML);
+}
 
-int Depth;
-XML_Parser parser;
-static int err_no;
-
-/*!	\func		char* iso_to_xml(char* iso_msg)
+/*!	\func		char* iso_to_xml(char* iso_msg, int iso_len, const isodef* def, msgprop* prop)
  * 		\brief		convert a message in iso format to xml format
  * 		\param		iso_msg	a character pointer that points to this message
  * 		\param		ios_len		the length of the iso message
  * 		\param 	def is an array of ::isodef structures which refers to all data element definitions of  an iso standard
- * 		\param		bmp_flag  a flag that indicates which fomat the bitmap is packaged (binary, hexa)
- * 		\return		a xml string if successfully convert the message	\n
+ * 		\param		prop  the properties of the iso message (bitmap format, padding characters)
+ * 		\return		a xml string if successfully convert the message, the caller frees it	\n
  * 						NULL in case having an error
  */
-char* iso_to_xml(char* iso_msg, int iso_len, const isodef* def, int bmp_flag){
+char* iso_to_xml(char* iso_msg, int iso_len, const isodef* def, msgprop* prop){
 	char* xml_str; // xml string buffer
-	isomsg unpacked_msg;
-	char  tmp[FIELD_MAX_LENGTH];
-	int err = 0, i = 0;
-	init_message(&unpacked_msg, bmp_flag);
-	err = unpack_message(&unpacked_msg, def, iso_msg, iso_len);
-	if(err > 0){
-		handle_err(WARN, ISO, "Can not unpack the iso message");
+	isoplan plan;
+	isowriter w;
+	int err = 0;
+	err = compile_plan(&plan, def, prop, NULL);
+	/* the callees log their own errors */
+	if(err != SUCCEEDED)
+		return NULL;
+	/* the writer grows with the message, there is no length limit */
+	init_writer_buffer(&w);
+	err = write_iso_xml(&w, &plan, iso_msg, iso_len, NULL);
+	if(err != SUCCEEDED){
+		free_writer(&w);
 		return NULL;
+	}
+	xml_str = writer_detach(&w, NULL);
+	if(xml_str == NULL)
+		handle_err(ERR_OUTMEM, SYS, "Can not allocate the xml string");
+	return xml_str;
+}
+
+static void XMLCALL handle_start(void *data, const char *el, const char **attr);
+static void XMLCALL handle_end(void *data, const char *el);
+static void XMLCALL batch_start(void *data, const char *el, const char **attr);
+static void XMLCALL batch_end(void *data, const char *el);
+static int set_xml_field(xmlctx *x, int idx, const char *value, int len);
+static int scan_fast(xmlctx *x, const char *p, const char *end, bytes *fld, isobitmap *bmp);
+
+/*!	\func	int init_xmlctx(xmlctx *x);
+ * 		\brief	Initialize a conversion context, its parser is created once here
+ * 		\param	x is the ::xmlctx to initialize
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_PASMEM if the parser can't be created
+ */
+int init_xmlctx(xmlctx *x){
+	x->parser = XML_ParserCreate(NULL);
+	init_arena(&x->arena, 0);
+	x->depth = 0;
+	x->err_no = 0;
+	x->def = NULL;
+	x->prop = NULL;
+	x->cb = NULL;
+	x->cb_ctx = NULL;
+	x->in_msg = 0;
+	x->count = 0;
+	x->plan_def = NULL;
+	x->err = NULL;
+	if(x->parser == NULL){
+		handle_err(ERR_PASMEM, SYS, "Can not create the xml parser");
+		return ERR_PASMEM;
+	}
+	return SUCCEEDED;
+}
+
+/*!	\func	void free_xmlctx(xmlctx *x);
+ * 		\brief	Free the parser and the memory of a conversion context
+ * 		\param	x is an ::xmlctx initialized by ::init_xmlctx
+ */
+void free_xmlctx(xmlctx *x){
+	if(x->parser != NULL)
+		XML_ParserFree(x->parser);
+	x->parser = NULL;
+	free_arena(&x->arena);
+}
+
+/*!	\func	void set_xml_errctx(xmlctx *x, isoerr *err);
+ * 		\brief	Give an error context to a conversion context. The errors of its documents and messages are
+ * 					then recorded into err, with their offset in the document, and nothing is logged.
+ * 		\param	x is an ::xmlctx initialized by ::init_xmlctx
+ * 		\param	err is the error context, NULL to log the errors again
+ */
+void set_xml_errctx(xmlctx *x, isoerr *err){
+	x->err = err;
+}
+
+/*!	\func	static isoerr* xml_err(xmlctx *x)
+ * 		\brief	Get the context that records the errors of x, the one of the caller or the local one
+ */
+static isoerr* xml_err(xmlctx *x){
+	return (x->err != NULL)? x->err : &x->local;
+}
+
+/*!	\func	static int xml_error(xmlctx *x, int err)
+ * 		\brief	Record an error of the document at the current position of the parser
+ * 		\return	err
+ */
+static int xml_error(xmlctx *x, int err){
+	XML_Index pos = XML_GetCurrentByteIndex(x->parser);
+	return fail_isoerr(xml_err(x), err, -1, (pos < 0 || pos > INT_MAX)? -1 : (int) pos, -1, -1, -1);
+}
+
+/*!	\func	static int resolve_plan(xmlctx *x, const isodef *def, const msgprop *prop)
+ * 		\brief	Compile the plan of x, unless it is already compiled from def and prop
+ * 		\return	SUCCEEDED if having no error \n
+ * 					the error of ::compile_plan
+ */
+static int resolve_plan(xmlctx *x, const isodef *def, const msgprop *prop){
+	int err;
+	if(x->plan_def == def && x->plan_prop.bmp_flag == prop->bmp_flag
+			&& x->plan_prop.alphanumeric_pad == prop->alphanumeric_pad && x->plan_prop.numeric_pad == prop->numeric_pad)
+		return SUCCEEDED;
+	x->plan_def = NULL;
+	err = compile_plan(&x->plan, def, prop, xml_err(x));
+	if(err != SUCCEEDED)
+		return err;
+	x->plan_def = def;
+	x->plan_prop = *prop;
+	return SUCCEEDED;
+}
+
+/*!	\func	int xmlctx_to_iso(xmlctx *x, const char *xml_str, int xml_len, const isodef *def, const msgprop *prop, char *buf, int size, int *iso_len);
+ * 		\brief	Convert an xml document to an iso message. \n
+ * 					A document of the form written by ::iso_to_xml is read by ::scan_fast and packed from
+ * 					the document itself: the text fields are packed from where they are in xml_str and only
+ * 					the binary ones are decoded, into the arena of x. Any other document is read by the
+ * 					parser of x, which is reset and parses it in one call. The plan compiled from def and
+ * 					prop is kept by x for the next call. Nothing is allocated once the arena has grown to
+ * 					the largest document.
+ * 		\param	x is an ::xmlctx initialized by ::init_xmlctx
+ * 		\param	xml_str is the xml document
+ * 		\param	xml_len is the length of xml_str
+ * 		\param	def is an array of ::isodef structures which refers to all data element definitions of an iso standard
+ * 		\param	prop the properties that will be used to build the iso message
+ * 		\param	buf receives the iso message
+ * 		\param	size is the size of buf
+ * 		\param	iso_len receives the length of the iso message
+ * 		\return	SUCCEEDED if having no error, the errors are recorded into the context of x \n
+ * 					ERR_PASMEM if the parser can't be reset \n
+ * 					ERR_XMLPAS if the document is not well formed \n
+ * 					the first error met in the fields of the document \n
+ * 					the error of ::compile_plan or ::pack_fields
+ */
+int xmlctx_to_iso(xmlctx *x, const char *xml_str, int xml_len, const isodef *def, const msgprop *prop, char *buf, int size, int *iso_len){
+	isoerr *e = xml_err(x);
+	bytes fld[129];
+	isobitmap bmp;
+	int err;
+
+	*iso_len = 0;
+	x->depth = 0;
+	x->err_no = 0;
+	e->code = SUCCEEDED;
+	err = resolve_plan(x, def, prop);
+	if(err != SUCCEEDED)
+		return report_isoerr(x->err, e, err);
+
+	/* the documents of the usual form don't need the parser, their fields are packed from the document */
+	err = scan_fast(x, xml_str, xml_str + xml_len, fld, &bmp);
+	if(err != XML_FALLBACK){
+		if(err == SUCCEEDED)
+			err = pack_fields(&x->plan, &bmp, fld, buf, size, iso_len, e);
+		reset_arena(&x->arena);
+		/* as ::pack_fields, a buffer that is too small is never logged */
+		return (err == ERR_SHTBUF)? err : report_isoerr(x->err, e, err);
+	}
+	reset_arena(&x->arena);
+	init_message_plan(&x->msg, &x->plan);
+	set_arena(&x->msg, &x->arena);
+	set_errctx(&x->msg, e);
+
+	if(x->parser == NULL || XML_ParserReset(x->parser, NULL) == XML_FALSE){
+		handle_err(ERR_PASMEM, SYS, "Can not reset the xml parser");
+		return ERR_PASMEM;
+	}
+	/* a reset parser has lost its handlers */
+	XML_SetUserData(x->parser, x);
+	XML_SetElementHandler(x->parser, handle_start, handle_end);
+
+	if(XML_Parse(x->parser, xml_str, xml_len, 1) == XML_STATUS_ERROR){
+		free_message(&x->msg);
+		return report_isoerr(x->err, e, xml_error(x, ERR_XMLPAS));
+	}
+	if(x->err_no){
+		err = x->err_no;
 	}else{
-		char *tail;
-		xml_str = (char*) calloc(XML_MAX_LENGTH, sizeof(char));
-		tail = xml_str;
-		sprintf(tail, "<?xml\tversion=\"1.0\"?>\n<%s>\n", XML_ROOT_TAG);
-		tail = xml_str + strlen(xml_str);
-		for(i = 0; i <= 128; i++){
-			if (i == 1) continue;
-			if (unpacked_msg.fld[i] != NULL){
-				memset(tmp, '\0', sizeof(tmp));
-				sprintf(tmp, "\t<%s\tid=\"%d\"\tvalue=\"%s\"/>\n", XML_CHILD_TAG, i, unpacked_msg.fld[i]);
-				if(strlen(tmp) + strlen(xml_str) <= XML_MAX_LENGTH){
-					sprintf(tail, "%s", tmp);
-					tail = xml_str + strlen(xml_str);
-				}else{
-					handle_err(ERR_OVRLEN, SYS, "The xml string's length exceeds the defined maximum value");
-					free(xml_str);
-					return NULL;
-				}
-			}
-		}
-		memset(tmp, '\0', sizeof(tmp));
-		sprintf(tmp, "</%s>", XML_ROOT_TAG);
-		if(strlen(tmp) + strlen(xml_str) <= XML_MAX_LENGTH){
-				sprintf(tail, "%s", tmp);
-		}else{
-				handle_err(ERR_OVRLEN, SYS, "The xml string's length exceeds the defined maximum value");
-				free(xml_str);
-				return NULL;
-		}
-		return xml_str;
+		err = pack_message_buf(&x->msg, buf, size, iso_len);
 	}
+	/* the field values go back with the arena */
+	free_message(&x->msg);
+	return (err == ERR_SHTBUF)? err : report_isoerr(x->err, e, err);
+}
+
+/*!	\brief	The key of the conversion context of each thread */
+static pthread_key_t ctx_key;
+static pthread_once_t ctx_once = PTHREAD_ONCE_INIT;
+
+/*!	\brief	Free the conversion context of a thread that exits */
+static void free_local_ctx(void *p){
+	free_xmlctx((xmlctx*) p);
+	free(p);
+}
+
+static void create_ctx_key(void){
+	pthread_key_create(&ctx_key, free_local_ctx);
 }
 
-/*!	\func		char* xml_to_iso(char* xml_str, const isodef *def);
- * 		\brief		convert a xml string to an iso message
+/*!	\func	static xmlctx* local_ctx(void)
+ * 		\brief	Get the conversion context of the calling thread, it is created on the first call
+ * 		\return	the context, NULL if it can't be created
+ */
+static xmlctx* local_ctx(void){
+	xmlctx *x;
+	pthread_once(&ctx_once, create_ctx_key);
+	x = (xmlctx*) pthread_getspecific(ctx_key);
+	if(x != NULL)
+		return x;
+	x = (xmlctx*) malloc(sizeof(xmlctx));
+	if(x == NULL)
+		return NULL;
+	if(init_xmlctx(x) != SUCCEEDED || pthread_setspecific(ctx_key, x) != 0){
+		free_xmlctx(x);
+		free(x);
+		return NULL;
+	}
+	return x;
+}
+
+/*!	\func		char* xml_to_iso(char* xml_str, const isodef *def, msgprop* prop, int* iso_len);
+ * 		\brief		convert a xml string to an iso message. \n
+ * 						It converts with the context of the calling thread, so threads can call it at the same time.
  * 		\param		xml_str the xml input string
  * 		\param 	def is an array of ::isodef structures which refers to all data element definitions of  an iso standard
- * 		\param		bitmap flag that will be used to build the iso message
+ * 		\param		prop the properties that will be used to build the iso message
  * 		\param		iso_len the output iso message's length
- * 		\return 	 	the iso message string if having no error
+ * 		\return 	 	the iso message, terminated by '\0', if having no error. The caller frees it. \n
  * 						NULL if having an error
  */
- char* xml_to_iso(char* xml_str, const isodef *def, int bmp_flag, int* iso_len){
- 	int done=0;
- 	char* current_pos = xml_str;
- 	char iso_buf[ISO_MAX_LENGTH];
- 	int len = 0;
- 	isomsg	iso_msg;
-	int err = 0;
-	/* reset the err_no */
-	err_no = 0;
- 	parser = XML_ParserCreate(NULL);
+char* xml_to_iso(char* xml_str, const isodef *def, msgprop* prop, int* iso_len){
+	char iso_buf[ISO_MAX_LENGTH];
+	char *iso;
+	xmlctx *x = local_ctx();
+
+	*iso_len = 0;
+	if(x == NULL)
+		return NULL;
+	if(xmlctx_to_iso(x, xml_str, strlen(xml_str), def, prop, iso_buf, sizeof(iso_buf), iso_len) != SUCCEEDED)
+		return NULL;
+	iso = (char*) malloc(*iso_len + 1);
+	if(iso == NULL){
+		handle_err(ERR_OUTMEM, SYS, "Can not allocate the iso message");
+		return NULL;
+	}
+	memcpy(iso, iso_buf, *iso_len);
+	iso[*iso_len] = '\0';
+	return iso;
+}
+
+/*!	\func	static int decode_binary(xmlctx *x, int idx, const char *value, int len, bytes *fld)
+ * 		\brief	Decode the hexa char array of a binary field into the arena of x
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_OUTMEM if the arena can't grow \n
+ * 					ERR_HEXBYT if value is not a hexa char array
+ */
+static int decode_binary(xmlctx *x, int idx, const char *value, int len, bytes *fld){
+	char *p = (char*) arena_alloc(&x->arena, len/2);
+	if(p == NULL)
+		return fail_isoerr(xml_err(x), ERR_OUTMEM, idx, -1, len/2, -1, -1);
+	if(hexa_decode_strict(value, len, p) != SUCCEEDED)
+		return fail_isoerr(xml_err(x), ERR_HEXBYT, idx, -1, -1, len, ISO_BINARY);
+	fld->bytes = p;
+	fld->length = len/2;
+	return SUCCEEDED;
+}
 
- 	init_message(&iso_msg, bmp_flag);
+/*!	\func	static int set_xml_field(xmlctx *x, int idx, const char *value, int len)
+ * 		\brief	Set the value of a field element to the message of x, binary values are decoded from hexa
+ * 		\return	SUCCEEDED if having no error \n
+ * 					the error of ::decode_binary \n
+ * 					the error of ::set_field
+ */
+static int set_xml_field(xmlctx *x, int idx, const char *value, int len){
+	if(len == 0)
+		return SUCCEEDED;		/* an empty value leaves the field absent */
+	if(x->msg.def[idx].format != ISO_BINARY)
+		return set_field(&x->msg, idx, value, len);
+	/* binary data is read from a hexa char array, decoded straight into the arena */
+	return decode_binary(x, idx, value, len, &x->msg.fld[idx]);
+}
 
- 	XML_SetUserData(parser, &iso_msg);
+/*!	\brief	The characters that ::scan_fast takes as they are in an attribute value. \n
+ * 			The others, entities, white spaces that the parser normalizes, control and non ascii
+ * 			characters, are left to the parser.
+ */
+#define PLAIN_VALUE(c)	((c) >= 0x20 && (c) < 0x7F && (c) != '&' && (c) != '<')
 
- 	memset(iso_buf, '\0', sizeof(iso_buf));
+/*!	\brief	The white spaces of xml */
+#define XML_SPACE(c)	((c) == ' ' || (c) == '\t' || (c) == '\n' || (c) == '\r')
 
-	if (! parser) {
-		char	err_msg[100];
-		sprintf(err_msg, "At file: %s		line:%s", __FILE__, __LINE__);
-		handle_err(ERR_PASMEM, SYS, err_msg);
+/*!	\func	static const char* skip_space(const char *p, const char *end)
+ * 		\brief	Skip the white spaces
+ */
+static const char* skip_space(const char *p, const char *end){
+	while(p < end && XML_SPACE(*p))
+		p++;
+	return p;
+}
+
+/*!	\func	static const char* skip_word(const char *p, const char *end, const char *word)
+ * 		\brief	Skip a word
+ * 		\return	the character after the word, NULL if the word is not at p
+ */
+static const char* skip_word(const char *p, const char *end, const char *word){
+	int len = strlen(word);
+	if(end - p < len || memcmp(p, word, len) != 0)
 		return NULL;
-  }
-	XML_SetElementHandler(parser, handle_start, handle_end);
+	return p + len;
+}
+
+/*!	\struct		xmlspan
+ * 		\brief		A field element found by ::scan_fast, its value points into the document
+ */
+typedef struct {
+	int idx;
+	const char *value;
+	int len;
+} xmlspan;
 
+/*!	\func	static const char* scan_field(const char *p, const char *end, xmlspan *f)
+ * 		\brief	Read the attributes of a field element, from the end of its name to the end of the element. \n
+ * 					The element has an id and a value once each and no other attribute: a repeated
+ * 					attribute is an error of the parser, and another one would have to be checked as such.
+ * 		\return	the character after the element \n
+ * 					NULL if the element is not of the usual form
+ */
+static const char* scan_field(const char *p, const char *end, xmlspan *f){
+	const char *name, *v;
+	int name_len, n;
+	char quote;
+
+	f->idx = -1;
+	f->value = NULL;
 	for(;;){
-		len = (strlen(current_pos) < TMPSIZE)? strlen(current_pos): TMPSIZE;
-		if(len < TMPSIZE) done = 1;
-		if (XML_Parse(parser, current_pos, len, done) == XML_STATUS_ERROR) {
-		  char err_msg[100];
-	      sprintf(err_msg, "Parse error at line %" XML_FMT_INT_MOD "u:\n%s\n",
-	              XML_GetCurrentLineNumber(parser),
-	              XML_ErrorString(XML_GetErrorCode(parser)));
-	         handle_err(ERR_XMLPAS, ISO, err_msg);
-	      return NULL;
-	    }
-	    current_pos += len;
-	    if(*current_pos=='\0') break;
-	}
-	/* free allocated resources, and return	*/
-	XML_ParserFree(parser);
-
-	if(err_no){
-		free_message(&iso_msg);
-		/* reset the erro_no before return */
-		err_no = 0;
+		if(p == end || !XML_SPACE(*p)){
+			/* the element ends after the attributes, "/>" without children */
+			if(end - p >= 2 && p[0] == '/' && p[1] == '>')
+				break;
+			return NULL;
+		}
+		p = skip_space(p, end);
+		if(end - p >= 2 && p[0] == '/' && p[1] == '>')
+			break;
+		name = p;
+		while(p < end && ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || *p == '_'))
+			p++;
+		name_len = p - name;
+		p = skip_space(p, end);
+		if(name_len == 0 || p == end || *p != '=')
+			return NULL;
+		p = skip_space(p + 1, end);
+		if(p == end || (*p != '"' && *p != '\''))
+			return NULL;
+		quote = *p++;
+		if(name_len == sizeof(XML_FIELD_INDEX) - 1 && memcmp(name, XML_FIELD_INDEX, name_len) == 0){
+			if(f->idx >= 0)
+				return NULL;
+			for(f->idx = 0, n = 0; p < end && *p >= '0' && *p <= '9' && n < 3; p++, n++)
+				f->idx = f->idx*10 + *p - '0';
+			/* a bad index is reported by the parser */
+			if(n == 0 || f->idx > 128 || f->idx == 1)
+				return NULL;
+		}else if(name_len == sizeof(XML_FIELD_VALUE) - 1 && memcmp(name, XML_FIELD_VALUE, name_len) == 0){
+			if(f->value != NULL)
+				return NULL;
+			for(v = p; p < end && *p != quote && PLAIN_VALUE((unsigned char) *p); p++)
+				;
+			f->value = v;
+			f->len = p - v;
+		}else{
+			return NULL;
+		}
+		if(p == end || *p != quote)
+			return NULL;
+		p++;
+	}
+	if(f->idx < 0 || f->value == NULL)
+		return NULL;
+	return p + 2;
+}
+
+/*!	\func	static const char* scan_declaration(const char *p, const char *end)
+ * 		\brief	Skip an xml declaration that has only the version 1.0
+ * 		\return	the character after the declaration \n
+ * 					NULL if the declaration is not of this form
+ */
+static const char* scan_declaration(const char *p, const char *end){
+	char quote;
+	p = skip_word(p, end, "<?xml");
+	if(p == NULL || p == end || !XML_SPACE(*p))
+		return NULL;
+	p = skip_word(skip_space(p, end), end, "version");
+	if(p == NULL)
 		return NULL;
+	p = skip_space(p, end);
+	if(p == end || *p != '=')
+		return NULL;
+	p = skip_space(p + 1, end);
+	if(p == end || (*p != '"' && *p != '\''))
+		return NULL;
+	quote = *p;
+	p = skip_word(p + 1, end, "1.0");
+	if(p == NULL || p == end || *p != quote)
+		return NULL;
+	return skip_word(skip_space(p + 1, end), end, "?>");
+}
+
+/*!	\func	static int scan_fast(xmlctx *x, const char *p, const char *end, bytes *fld, isobitmap *bmp)
+ * 		\brief	Read a document of the form written by ::iso_to_xml, without the parser. \n
+ * 					The document is an optional xml declaration, then a message element whose children are
+ * 					empty field elements, in any order. Their id and value are read in place, and once the
+ * 					whole document is known to be of this form the fields are staged in fld: a text value
+ * 					refers to the document, a binary one is decoded into the arena of x. As with the parser,
+ * 					a field given twice takes its last value. Anything else, comments, entities, other
+ * 					elements or attributes, an encoding, is left to the parser, as are the errors of syntax, so that
+ * 					they are reported the same way.
+ * 		\param	fld receives the fields, fld[0] and the entries of the fields in bmp are set
+ * 		\param	bmp receives the present fields 2..128
+ * 		\return	SUCCEEDED if having no error \n
+ * 					XML_FALLBACK if the document must be parsed by the parser \n
+ * 					the error of the first field that can't be set
+ */
+static int scan_fast(xmlctx *x, const char *p, const char *end, bytes *fld, isobitmap *bmp){
+	xmlspan span[129], *f;
+	const char *q;
+	int i, n = 0, err;
+
+	/* the declaration comes first, nothing may precede it */
+	if(skip_word(p, end, "<?") != NULL){
+		p = scan_declaration(p, end);
+		if(p == NULL)
+			return XML_FALLBACK;
+	}
+	p = skip_space(p, end);
+	p = skip_word(p, end, "<" XML_ROOT_TAG);
+	if(p == NULL)
+		return XML_FALLBACK;
+	p = skip_space(p, end);
+	if(p == end || *p != '>')
+		return XML_FALLBACK;
+	p = skip_space(p + 1, end);
+	while((q = skip_word(p, end, "<" XML_CHILD_TAG)) != NULL){
+		if(n == 129)
+			return XML_FALLBACK;
+		p = scan_field(q, end, &span[n++]);
+		if(p == NULL)
+			return XML_FALLBACK;
+		p = skip_space(p, end);
+	}
+	p = skip_word(p, end, "</" XML_ROOT_TAG);
+	if(p == NULL)
+		return XML_FALLBACK;
+	p = skip_space(p, end);
+	if(p == end || *p != '>' || skip_space(p + 1, end) != end)
+		return XML_FALLBACK;
+
+	/* the fields are staged in order, the first error stops them as it stops the parser handlers */
+	empty_bytes(&fld[0]);
+	bitmap_clear(bmp);
+	for(i = 0; i < n; i++){
+		f = &span[i];
+		if(f->len == 0)
+			continue;		/* an empty value leaves the field absent */
+		if(x->plan.def[f->idx].format == ISO_BINARY){
+			err = decode_binary(x, f->idx, f->value, f->len, &fld[f->idx]);
+			if(err != SUCCEEDED)
+				return err;
+		}else{
+			fld[f->idx].bytes = (char*) f->value;
+			fld[f->idx].length = f->len;
+		}
+		if(f->idx != 0)
+			bitmap_set(bmp, f->idx);
+	}
+	return SUCCEEDED;
+}
+
+/*!	\func	static void read_field(xmlctx *x, const char **attr)
+ * 		\brief	Set the field of a field element to the message of x, or set x->err_no. \n
+ * 					An index out of the [0, 128] range or equal to 1 is taken as a missing one.
+ */
+static void read_field(xmlctx *x, const char **attr){
+	int i, fld_index = -1;
+	const char *fld_data = NULL;
+	char *end;
+
+	for(i = 0; attr[i] && attr[i+1]; i += 2){
+		if(strcmp(attr[i], XML_FIELD_INDEX) == 0){
+			if(fld_index >= 0) continue;		/* There are two 'index' attribute, ormit the second one*/
+			fld_index = strtol(attr[i+1], &end, 10);
+			if(end == attr[i+1] || *end != '\0'){
+				fld_index = -1;
+			}else if(fld_index < 0 || fld_index > 128 || fld_index == 1){ /* the index value is not correct */
+				fld_index = -1;
+			}
+		}else if(strcmp(attr[i], XML_FIELD_VALUE) == 0){
+			if(fld_data) continue;			/* There are two 'value' attribute, ormit the second one*/
+			fld_data = attr[i+1];
+		}
+	}
+	if(fld_index >= 0 && fld_data){
+		/*	having both the field index and the field value, set them to the isomsg struct */
+		x->err_no = set_xml_field(x, fld_index, fld_data, strlen(fld_data));
 	}else{
-		err = pack_message(&iso_msg, def, iso_buf, iso_len);
-		iso_buf[*iso_len] = '\0';
-		free_message(&iso_msg);
-		/* reset the erro_no before return */
-		err_no = 0;
-		if(err) return NULL;
-		else
-		return iso_buf;
+		/* either the index attribute or the value attribute is not correct */
+		x->err_no = xml_error(x, ERR_XMLSYT);
 	}
- }
+}
 
 /*!
  * 		\brief	handle xml start tag
@@ -143,50 +562,13 @@ char* iso_to_xml(char* iso_msg, int iso_len, const isodef* def, int bmp_flag){
 static void XMLCALL
 handle_start(void *data, const char *el, const char **attr)
 {
-  int i = 0;
-  int fld_index = -1;
-  char* fld_data = NULL;
-  /* check err_no */
-  if(err_no) return;
-  isomsg* tmp = (isomsg*)data;
-  if(strcmp(el, XML_CHILD_TAG) ==0){
-		while(attr[i]){
-			if((strcmp(attr[i], XML_FIELD_INDEX) == 0) && (i%2 == 0) ){	/* found the index attribute */
-				if(!attr[i+1]) continue;		/* don't have a value for 'index' attribute, continue */
-				if(fld_index >= 0) continue;		/* There are two 'index' attribute, ormit the second one*/
-				fld_index = strtol(attr[i+1],(char**)NULL, 10);
-				if(errno){
-					fld_index = -1;
-				}else{
-					if( fld_index < 0 || fld_index > 128 || fld_index == 1){ /* the index value is not correct */
-						char	err_msg[100];
-						sprintf(err_msg, "The index value(%d) is not in the [0, 128] range and <> 1", fld_index);
-						handle_err(ERR_OUTRAG, ISO, err_msg);
-						fld_index = -1;
-					}
-				}
-			}else{
-				if((strcmp(attr[i], XML_FIELD_VALUE) ==0) && (i%2 ==0)){	/* found the value attribute */
-					if(!attr[i+1]) continue;		/*	don't have a value for 'value' attribute, continue */
-					if(fld_data) continue;			/* There are two 'value' attribute, ormit the second one*/
-					fld_data = (char*) calloc(strlen(attr[i+1])+1, sizeof(char));
-					memcpy(fld_data, attr[i+1], strlen(attr[i+1]));
-				}
-			}
-			i+=2;
-		}
-		if( (fld_index >= 0) && fld_data){
-			/*	having both the field index and the field value, set them to the isomsg struct */
-			tmp->fld[fld_index] = (char*) calloc(strlen(fld_data)+1, sizeof(char));
-			memcpy(tmp->fld[fld_index], fld_data, strlen(fld_data));
-		}else{
-			char err_msg[100];
-			sprintf(err_msg, "Syntax error at line: %d of the parsing xml document, either index attribute or value attribute is not correct", XML_GetCurrentLineNumber(parser));
-			handle_err(WARN,ISO, err_msg);
-			err_no = ERR_XMLSYT;
-		}
-  }
-  Depth++;
+	xmlctx *x = (xmlctx*) data;
+
+	x->depth++;
+	/* stop at the first error */
+	if(x->err_no || strcmp(el, XML_CHILD_TAG) != 0)
+		return;
+	read_field(x, attr);
 }
 
 /*!
@@ -195,5 +577,181 @@ handle_start(void *data, const char *el, const char **attr)
 static void XMLCALL
 handle_end(void *data, const char *el)
 {
-  Depth--;
+	(void) el;
+	((xmlctx*) data)->depth--;
+}
+
+/*!	\func	static void stop_batch(xmlctx *x, int err)
+ * 		\brief	Stop the parsing of a batch, ::feed_xml_batch then returns err
+ */
+static void stop_batch(xmlctx *x, int err){
+	x->err_no = err;
+	XML_StopParser(x->parser, XML_FALSE);
+}
+
+/*!
+ * 		\brief	handle xml start tag of a batch, each message element starts a new message
+ */
+static void XMLCALL
+batch_start(void *data, const char *el, const char **attr)
+{
+	xmlctx *x = (xmlctx*) data;
+
+	x->depth++;
+	if(x->err_no)
+		return;
+	if(strcmp(el, XML_ROOT_TAG) == 0){
+		if(x->in_msg){
+			/* a message element is nested in another one */
+			stop_batch(x, xml_error(x, ERR_XMLSYT));
+			return;
+		}
+		init_message_plan(&x->msg, &x->plan);
+		set_arena(&x->msg, &x->arena);
+		set_errctx(&x->msg, xml_err(x));
+		x->in_msg = 1;
+	}else if(strcmp(el, XML_CHILD_TAG) == 0){
+		if(!x->in_msg){
+			/* a field element is out of a message element */
+			stop_batch(x, xml_error(x, ERR_XMLSYT));
+			return;
+		}
+		read_field(x, attr);
+		if(x->err_no)
+			stop_batch(x, x->err_no);
+	}
+}
+
+/*!
+ * 		\brief	handle xml end tag of a batch, the end of a message element packs it and gives it to the callback
+ */
+static void XMLCALL
+batch_end(void *data, const char *el)
+{
+	xmlctx *x = (xmlctx*) data;
+	char iso[ISO_MAX_LENGTH];
+	int len, err;
+
+	x->depth--;
+	if(x->err_no || !x->in_msg || strcmp(el, XML_ROOT_TAG) != 0)
+		return;
+	x->in_msg = 0;
+	err = pack_message_buf(&x->msg, iso, sizeof(iso), &len);
+	if(err == SUCCEEDED){
+		err = x->cb(x->cb_ctx, &x->msg, iso, len);
+		x->count++;
+	}
+	/* the fields go back with the arena, the memory of a batch doesn't grow with its length */
+	free_message(&x->msg);
+	if(err != SUCCEEDED)
+		stop_batch(x, err);
+}
+
+/*!	\func	int begin_xml_batch(xmlctx *x, const isodef *def, const msgprop *prop, isobatch_cb cb, void *cb_ctx);
+ * 		\brief	Start a batch. A batch is an xml document whose message elements are found at any depth,
+ * 					usually under a wrapper root. Each message is packed and given to cb as soon as its
+ * 					element ends, then its memory is reused by the next one.
+ * 		\param	x is an ::xmlctx initialized by ::init_xmlctx
+ * 		\param	def is an array of ::isodef structures which refers to all data element definitions of an iso standard
+ * 		\param	prop the properties that will be used to build the iso messages
+ * 		\param	cb is the callback that receives each message
+ * 		\param	cb_ctx is passed to cb
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_PASMEM if the parser can't be reset
+ */
+int begin_xml_batch(xmlctx *x, const isodef *def, const msgprop *prop, isobatch_cb cb, void *cb_ctx){
+	int err;
+
+	xml_err(x)->code = SUCCEEDED;
+	err = resolve_plan(x, def, prop);
+	if(err != SUCCEEDED)
+		return report_isoerr(x->err, xml_err(x), err);
+	if(x->parser == NULL || XML_ParserReset(x->parser, NULL) == XML_FALSE){
+		handle_err(ERR_PASMEM, SYS, "Can not reset the xml parser");
+		return ERR_PASMEM;
+	}
+	XML_SetUserData(x->parser, x);
+	XML_SetElementHandler(x->parser, batch_start, batch_end);
+	x->depth = 0;
+	x->err_no = 0;
+	x->def = def;
+	x->prop = prop;
+	x->cb = cb;
+	x->cb_ctx = cb_ctx;
+	x->in_msg = 0;
+	x->count = 0;
+	return SUCCEEDED;
+}
+
+/*!	\func	static int batch_error(xmlctx *x)
+ * 		\brief	Report the error that has stopped the parser of a batch and drop the open message
+ * 		\return	the error of the batch
+ */
+static int batch_error(xmlctx *x){
+	if(x->err_no == 0)
+		x->err_no = xml_error(x, ERR_XMLPAS);
+	if(x->in_msg){
+		free_message(&x->msg);
+		x->in_msg = 0;
+	}
+	return report_isoerr(x->err, xml_err(x), x->err_no);
+}
+
+/*!	\func	int feed_xml_batch(xmlctx *x, const char *data, int len, int final);
+ * 		\brief	Parse the next chunk of a batch, the chunks may be cut anywhere
+ * 		\param	x is an ::xmlctx started by ::begin_xml_batch
+ * 		\param	data is the chunk
+ * 		\param	len is the length of data
+ * 		\param	final is 1 for the last chunk, 0 for the others
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_XMLPAS if the document is not well formed \n
+ * 					the first error of a message or of the callback, the batch is then stopped
+ */
+int feed_xml_batch(xmlctx *x, const char *data, int len, int final){
+	/* the error of a stopped batch has been reported by the call that stopped it */
+	if(x->err_no)
+		return x->err_no;
+	xml_err(x)->code = SUCCEEDED;
+	if(XML_Parse(x->parser, data, len, final) == XML_STATUS_ERROR)
+		return batch_error(x);
+	return SUCCEEDED;
+}
+
+/*!	\func	int xml_batch_file(xmlctx *x, FILE *fp, const isodef *def, const msgprop *prop, isobatch_cb cb, void *cb_ctx);
+ * 		\brief	Convert every message of a batch read from a FILE. The file is read in BUFFSIZE blocks
+ * 					straight into the buffer of the parser, so a file of any size is converted in constant memory.
+ * 		\param	x is an ::xmlctx initialized by ::init_xmlctx, x->count receives the number of messages
+ * 		\param	fp is the FILE to read up to its end
+ * 		\param	def is an array of ::isodef structures which refers to all data element definitions of an iso standard
+ * 		\param	prop the properties that will be used to build the iso messages
+ * 		\param	cb is the callback that receives each message
+ * 		\param	cb_ctx is passed to cb
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_OUTMEM if the buffer of the parser can't be allocated \n
+ * 					ERR_IOREAD if the file can't be read \n
+ * 					the error of ::feed_xml_batch
+ */
+int xml_batch_file(xmlctx *x, FILE *fp, const isodef *def, const msgprop *prop, isobatch_cb cb, void *cb_ctx){
+	void *buf;
+	int len, done, err;
+
+	err = begin_xml_batch(x, def, prop, cb, cb_ctx);
+	if(err != SUCCEEDED)
+		return err;
+	do{
+		buf = XML_GetBuffer(x->parser, BUFFSIZE);
+		if(buf == NULL){
+			handle_err(ERR_OUTMEM, SYS, "Can not allocate the buffer of the xml parser");
+			return ERR_OUTMEM;
+		}
+		len = fread(buf, 1, BUFFSIZE, fp);
+		if(ferror(fp)){
+			handle_err(ERR_IOREAD, SYS, "Can not read the xml batch");
+			return ERR_IOREAD;
+		}
+		done = feof(fp);
+		if(XML_ParseBuffer(x->parser, len, done) == XML_STATUS_ERROR)
+			return batch_error(x);
+	}while(!done);
+	return SUCCEEDED;
 }
@@ -17,9 +17,68 @@
 #define BUFFSIZE        8192
 #define TMPSIZE		512
 
-static void XMLCALL
-handle_start(void *data, const char *el, const char **attr);
+/*!	\brief	The callback that receives each message of a batch. \n
+ * 			m holds the fields and iso is the packed message, both are valid only during the call.
+ * 			It returns SUCCEEDED to go on, anything else stops the batch and is returned by it.
+ */
+typedef int (*isobatch_cb)(void *ctx, isomsg *m, const char *iso, int iso_len);
+
+/*!	\struct		xmlctx
+ * 		\brief		A context that converts xml documents to iso messages, one document at a time. \n
+ * 						The parser is reset between two documents instead of being created again, and the
+ * 						field values are kept in an arena that is reused. A context holds all the state of a
+ * 						conversion, so each thread converts with its own context without any lock.
+ */
+typedef struct {
+	/*! \brief The parser, reset before each document */
+	XML_Parser parser;
+	/*! \brief The field values of the document being converted */
+	isoarena arena;
+	/*! \brief The message built from the document */
+	isomsg msg;
+	/*! \brief The depth of the current element */
+	int depth;
+	/*! \brief The first error met in the document, 0 if none */
+	int err_no;
+	/*! \brief The plan the messages are packed with, compiled from plan_def and plan_prop, plan_def is NULL until then */
+	isoplan plan;
+	const isodef *plan_def;
+	msgprop plan_prop;
+	/*! \brief The definition and the properties of the messages of a batch */
+	const isodef *def;
+	const msgprop *prop;
+	/*! \brief The callback of a batch and its context */
+	isobatch_cb cb;
+	void *cb_ctx;
+	/*! \brief Whether a message of a batch is open */
+	int in_msg;
+	/*! \brief The number of messages of the batch given to cb */
+	long count;
+	/*! \brief The error context of the caller, NULL to log the errors, see ::set_xml_errctx */
+	isoerr *err;
+	/*! \brief The context that records the errors when err is NULL */
+	isoerr local;
+} xmlctx;
+
+/*!	\brief	Initialize a conversion context and create its parser */
+int init_xmlctx(xmlctx *x);
+
+/*!	\brief	Give an error context to a conversion context, its errors are then recorded instead of logged */
+void set_xml_errctx(xmlctx *x, isoerr *err);
+
+/*!	\brief	Convert an xml document to an iso message written into a caller buffer */
+int xmlctx_to_iso(xmlctx *x, const char *xml_str, int xml_len, const isodef *def, const msgprop *prop, char *buf, int size, int *iso_len);
+
+/*!	\brief	Start a batch, a document with any number of messages under a wrapper root */
+int begin_xml_batch(xmlctx *x, const isodef *def, const msgprop *prop, isobatch_cb cb, void *cb_ctx);
+
+/*!	\brief	Parse the next chunk of a batch, final is 1 for the last chunk */
+int feed_xml_batch(xmlctx *x, const char *data, int len, int final);
+
+/*!	\brief	Convert every message of a batch read from a FILE */
+int xml_batch_file(xmlctx *x, FILE *fp, const isodef *def, const msgprop *prop, isobatch_cb cb, void *cb_ctx);
+
+/*!	\brief	Free the parser and the memory of a conversion context */
+void free_xmlctx(xmlctx *x);
 
-static void XMLCALL
-handle_end(void *data, const char *el);
 #endif /*CONVERT_H_*/
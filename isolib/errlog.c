@@ -0,0 +1,373 @@
+/*!	\file		errlog.c
+ * 		\brief	This file implements the asynchronous error log. \n
+ * 					The ring is a bounded queue whose slots carry a sequence number: a producer claims a
+ * 					slot by a compare and swap on the head, fills it and publishes it by its sequence, so
+ * 					the threads that report errors never wait on each other or on the disk. When the ring
+ * 					is full the error is counted as dropped instead. A single writer thread takes the
+ * 					slots in order, formats them into a buffer and writes it to the log file of the day
+ * 					in one call. It opens the file of the next day when the date of an error changes.
+ * 					A child process has no writer thread after a fork, its first error starts one.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "errlog.h"
+#include "errors.h"
+
+#define RING_MASK		(ERRLOG_RING_SIZE - 1)
+
+/*!	\brief	The longest line of the log, without the description given by the caller */
+#define LINE_MAX_LEN	(ERRLOG_DESC_LEN + 256)
+
+/*!	\struct		logslot
+ * 		\brief		A slot of the ring
+ */
+typedef struct {
+	/*! \brief The position the slot is free for, or that position plus 1 once it is filled */
+	unsigned long seq;
+	/*! \brief The time of the error */
+	time_t time;
+	/*! \brief The error code and its type, ISO or SYS */
+	int code;
+	int type;
+	/*! \brief The description given by the caller */
+	char desc[ERRLOG_DESC_LEN];
+} logslot;
+
+/*!	\struct		logfile
+ * 		\brief		The state of the writer thread
+ */
+typedef struct {
+	/*! \brief The log file, -1 if none is open */
+	int fd;
+	/*! \brief The day of the log file */
+	int year;
+	int yday;
+	/*! \brief The time last converted and its local time */
+	time_t last;
+	struct tm tm;
+	/*! \brief The lines not written yet, and how many they are */
+	char buf[ERRLOG_BUF_SIZE];
+	int len;
+	int lines;
+	/*! \brief The number of dropped errors already reported in the log */
+	unsigned long reported;
+} logfile;
+
+static logslot ring[ERRLOG_RING_SIZE];
+/* the producers share the head, the writer owns the tail, they are kept on separate cache lines */
+static unsigned long head __attribute__((aligned(64)));
+static unsigned long tail __attribute__((aligned(64)));
+static unsigned long written __attribute__((aligned(64)));
+static unsigned long dropped;
+static int running;
+static int stopping;
+static int ring_ready;
+static int exit_hook;
+static int fork_hook;
+static pthread_t writer;
+static pthread_mutex_t state_lock = PTHREAD_MUTEX_INITIALIZER;
+static char log_dir[ERRLOG_PATH_LEN] = ".";
+static logfile out;
+
+/*!	\func	static void nap(int ms)
+ * 		\brief	Sleep for some milliseconds
+ */
+static void nap(int ms){
+	struct timespec ts;
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (long) (ms % 1000) * 1000000L;
+	while(nanosleep(&ts, &ts) != 0 && errno == EINTR)
+		;
+}
+
+/*!	\func	static void write_lines(logfile *f)
+ * 		\brief	Write the buffered lines to the log file, they are counted as dropped if it fails
+ */
+static void write_lines(logfile *f){
+	const char *p = f->buf;
+	ssize_t n;
+	int len = f->len;
+
+	while(len > 0 && f->fd >= 0){
+		n = write(f->fd, p, len);
+		if(n < 0){
+			if(errno == EINTR)
+				continue;
+			break;
+		}
+		p += n;
+		len -= n;
+	}
+	if(len > 0)
+		__atomic_fetch_add(&dropped, f->lines, __ATOMIC_RELAXED);
+	f->len = 0;
+	f->lines = 0;
+}
+
+/*!	\func	static void open_day(logfile *f)
+ * 		\brief	Write the buffered lines, then open the log file of the day of f->tm instead of the current one
+ */
+static void open_day(logfile *f){
+	char day[16];
+	char path[ERRLOG_PATH_LEN + sizeof(day) + 8];
+
+	write_lines(f);
+	if(f->fd >= 0)
+		close(f->fd);
+	strftime(day, sizeof(day), "%d-%m-%Y", &f->tm);
+	snprintf(path, sizeof(path), "%s/%s.log", log_dir, day);
+	f->fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	f->year = f->tm.tm_year;
+	f->yday = f->tm.tm_yday;
+}
+
+/*!	\func	static void add_line(logfile *f, time_t t, int err_code, int err_type, const char *desc, const char *moredesc)
+ * 		\brief	Format a line of the log, the file of the next day is opened first if t is in another day
+ * 		\param	desc is the description of err_code, NULL for a line of the log itself
+ */
+static void add_line(logfile *f, time_t t, int err_code, int err_type, const char *desc, const char *moredesc){
+	char stamp[32];
+
+	if(t != f->last){
+		localtime_r(&t, &f->tm);
+		f->last = t;
+	}
+	if(f->fd < 0 || f->tm.tm_year != f->year || f->tm.tm_yday != f->yday)
+		open_day(f);
+	if(f->len + LINE_MAX_LEN > ERRLOG_BUF_SIZE)
+		write_lines(f);
+	strftime(stamp, sizeof(stamp), "%d-%m-%Y:%H:%M:%S", &f->tm);
+	if(desc == NULL)
+		f->len += snprintf(f->buf + f->len, LINE_MAX_LEN, "%s -%s\n", stamp, moredesc);
+	else
+		f->len += snprintf(f->buf + f->len, LINE_MAX_LEN, "%s -%d - %s - %s - %s\n", stamp, err_code,
+				(err_type == ISO)? "ISO" : "SYS", desc, moredesc);
+	f->lines++;
+}
+
+/*!	\func	static int drain(logfile *f)
+ * 		\brief	Format the errors of the ring into lines, in the order they were claimed
+ * 		\return	the number of errors taken from the ring
+ */
+static int drain(logfile *f){
+	logslot *s;
+	const char *desc;
+	int n = 0;
+
+	for(;;){
+		s = &ring[tail & RING_MASK];
+		if(__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) != tail + 1)
+			break;
+		/* the errors of an unknown code are not logged, as before */
+		desc = find_err(s->code);
+		if(desc != NULL)
+			add_line(f, s->time, s->code, s->type, desc, s->desc);
+		__atomic_store_n(&s->seq, tail + ERRLOG_RING_SIZE, __ATOMIC_RELEASE);
+		tail++;
+		n++;
+	}
+	return n;
+}
+
+/*!	\func	static void* write_log(void *arg)
+ * 		\brief	The writer thread, it drains the ring until it is stopped and the ring is empty
+ */
+static void* write_log(void *arg){
+	unsigned long lost;
+	char line[64];
+	int n, stop;
+
+	(void) arg;
+	for(;;){
+		/* stopping is read before draining, so every error put before the stop is written */
+		stop = __atomic_load_n(&stopping, __ATOMIC_ACQUIRE);
+		n = drain(&out);
+		lost = __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+		if(lost != out.reported){
+			sprintf(line, "%lu errors dropped, the ring was full", lost - out.reported);
+			add_line(&out, time(NULL), 0, SYS, NULL, line);
+			out.reported = lost;
+		}
+		write_lines(&out);
+		__atomic_store_n(&written, tail, __ATOMIC_RELEASE);
+		if(n == 0){
+			if(stop)
+				break;
+			nap(ERRLOG_IDLE_MS);
+		}
+	}
+	if(out.fd >= 0)
+		close(out.fd);
+	out.fd = -1;
+	return NULL;
+}
+
+/*!	\func	static void reset_ring(void)
+ * 		\brief	Empty the ring and forget the log file, the writer thread is not running
+ */
+static void reset_ring(void){
+	int i;
+
+	for(i = 0; i < ERRLOG_RING_SIZE; i++)
+		ring[i].seq = i;
+	head = 0;
+	tail = 0;
+	written = 0;
+	out.fd = -1;
+	out.last = 0;
+	out.len = 0;
+	out.lines = 0;
+	out.reported = __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+	ring_ready = 1;
+}
+
+/*!	\brief	Keep the state lock out of the hands of another thread while the process forks */
+static void fork_prepare(void){
+	pthread_mutex_lock(&state_lock);
+}
+
+static void fork_parent(void){
+	pthread_mutex_unlock(&state_lock);
+}
+
+/*!	\func	static void fork_child(void)
+ * 		\brief	Forget the writer thread of the parent in a child, the next error starts a writer of its own. \n
+ * 					The errors left in the ring are the parent's, it writes them, and a slot claimed by
+ * 					another thread of the parent would never be filled, so the ring is emptied.
+ */
+static void fork_child(void){
+	pthread_mutex_init(&state_lock, NULL);
+	__atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+	__atomic_store_n(&stopping, 0, __ATOMIC_RELEASE);
+	if(out.fd >= 0)
+		close(out.fd);
+	reset_ring();
+}
+
+/*!	\func	int start_errlog(const char *dir);
+ * 		\brief	Start the writer thread of the error log. \n
+ * 					It is started by the first error if it is not started before, with the current directory.
+ * 					Nothing is done if it is already running. It is stopped when the process exits, and
+ * 					a child process forked while it runs starts its own writer on its first error.
+ * 		\param	dir is the directory of the log files, NULL to keep the one of the last start
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_OVRLEN if dir is too long \n
+ * 					ERR_OUTMEM if the thread can't be created
+ */
+int start_errlog(const char *dir){
+	int err = SUCCEEDED;
+
+	pthread_mutex_lock(&state_lock);
+	if(__atomic_load_n(&running, __ATOMIC_ACQUIRE)){
+		pthread_mutex_unlock(&state_lock);
+		return SUCCEEDED;
+	}
+	if(dir != NULL){
+		if(strlen(dir) >= sizeof(log_dir)){
+			pthread_mutex_unlock(&state_lock);
+			return ERR_OVRLEN;
+		}
+		strcpy(log_dir, dir);
+	}
+	if(!ring_ready)
+		reset_ring();
+	if(!exit_hook)
+		exit_hook = (atexit(stop_errlog) == 0);
+	if(!fork_hook)
+		fork_hook = (pthread_atfork(fork_prepare, fork_parent, fork_child) == 0);
+	if(pthread_create(&writer, NULL, write_log, NULL) != 0)
+		err = ERR_OUTMEM;
+	else
+		__atomic_store_n(&running, 1, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&state_lock);
+	return err;
+}
+
+/*!	\func	int errlog_push(int err_code, int err_type, const char *desc);
+ * 		\brief	Put an error into the ring for the writer thread. \n
+ * 					It never waits: if the ring is full the error is dropped and counted, the writer
+ * 					reports the count in the log.
+ * 		\param	err_code is the error code
+ * 		\param	err_type is ISO or SYS
+ * 		\param	desc is the description of the error, it is copied and cut to ERRLOG_DESC_LEN
+ * 		\return	0 if the error is put into the ring \n
+ * 					-1 if it is dropped
+ */
+int errlog_push(int err_code, int err_type, const char *desc){
+	logslot *s;
+	unsigned long pos, seq;
+	long diff;
+	size_t len;
+
+	if(!__atomic_load_n(&running, __ATOMIC_ACQUIRE) && start_errlog(NULL) != SUCCEEDED){
+		__atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+		return -1;
+	}
+	pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+	for(;;){
+		s = &ring[pos & RING_MASK];
+		seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+		diff = (long) (seq - pos);
+		if(diff == 0){
+			/* the slot is free, it is ours if no other producer claims pos first */
+			if(__atomic_compare_exchange_n(&head, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		}else if(diff < 0){
+			/* the writer has not taken the slot of the previous round yet */
+			__atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+			return -1;
+		}else{
+			pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+		}
+	}
+	s->time = time(NULL);
+	s->code = err_code;
+	s->type = err_type;
+	if(desc == NULL)
+		desc = "";
+	len = strlen(desc);
+	if(len >= ERRLOG_DESC_LEN)
+		len = ERRLOG_DESC_LEN - 1;
+	memcpy(s->desc, desc, len);
+	s->desc[len] = '\0';
+	__atomic_store_n(&s->seq, pos + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/*!	\func	void flush_errlog(void);
+ * 		\brief	Wait until the errors put into the ring before the call are written to the log file
+ */
+void flush_errlog(void){
+	unsigned long target = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+	while(__atomic_load_n(&running, __ATOMIC_ACQUIRE) && (long) (__atomic_load_n(&written, __ATOMIC_ACQUIRE) - target) < 0)
+		nap(1);
+}
+
+/*!	\func	void stop_errlog(void);
+ * 		\brief	Stop the writer thread once it has written the errors of the ring, and close the log file. \n
+ * 					An error put after it is kept in the ring and written by the next start.
+ */
+void stop_errlog(void){
+	pthread_mutex_lock(&state_lock);
+	if(__atomic_load_n(&running, __ATOMIC_ACQUIRE)){
+		__atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+		pthread_join(writer, NULL);
+		__atomic_store_n(&stopping, 0, __ATOMIC_RELEASE);
+		__atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&state_lock);
+}
+
+/*!	\func	unsigned long errlog_dropped(void);
+ * 		\brief	Get the number of errors dropped since the start of the process
+ * 		\return	the number of errors dropped because the ring was full or the log file could not be written
+ */
+unsigned long errlog_dropped(void){
+	return __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+}
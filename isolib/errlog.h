@@ -0,0 +1,30 @@
+/*!	\file		errlog.h
+ * 		\brief	The asynchronous error log behind ::handle_err. \n
+ * 				The threads that report errors put them into a lock-free ring, a writer thread formats
+ * 				them and writes them in batches to the log file of the day, which it keeps open.
+ */
+#ifndef ERRLOG_H_
+#define ERRLOG_H_
+
+#define ERRLOG_RING_SIZE		1024		/*!	\brief	The number of errors the ring holds, a power of 2 */
+#define ERRLOG_DESC_LEN			192			/*!	\brief	The longest description kept, the rest is cut */
+#define ERRLOG_BUF_SIZE			65536		/*!	\brief	The size of the batches of lines the writer writes */
+#define ERRLOG_PATH_LEN			256			/*!	\brief	The longest path of a log file */
+#define ERRLOG_IDLE_MS			10			/*!	\brief	How long the writer sleeps when the ring is empty */
+
+/*!	\brief	Start the writer thread, the log files go to dir, the current directory if dir is NULL */
+int start_errlog(const char *dir);
+
+/*!	\brief	Put an error into the ring, without waiting */
+int errlog_push(int err_code, int err_type, const char *desc);
+
+/*!	\brief	Wait until the errors put before the call are written */
+void flush_errlog(void);
+
+/*!	\brief	Write the errors left in the ring, stop the writer thread and close the log file */
+void stop_errlog(void);
+
+/*!	\brief	Get the number of errors dropped because the ring was full */
+unsigned long errlog_dropped(void);
+
+#endif /*ERRLOG_H_*/
@@ -8,8 +8,58 @@
 #include	 <string.h>
 #include	 <time.h>
 #include	 <ctype.h>
+#include	 <stdarg.h>
+#include	 <pthread.h>
 #include "errors.h"
 #include "iso8583.h"
+#include "errlog.h"
+
+/*!	\brief	The error codes are grouped by thousands, the table indexes the first ERR_BAND_SIZE codes of ERR_BANDS groups */
+#define ERR_BANDS		8
+#define ERR_BAND_SIZE	128
+
+/*!	\brief	The index of each error code into errdef plus 1, 0 for a code that is not an error code */
+static unsigned char err_index[ERR_BANDS][ERR_BAND_SIZE];
+static pthread_once_t err_once = PTHREAD_ONCE_INIT;
+
+/*!	\func	static void build_err_index(void)
+ * 		\brief	Fill the table of the error codes from errdef, once per process
+ */
+static void build_err_index(void)
+{
+	int i, nerr;
+	nerr = sizeof(errdef)/sizeof(errmsg);
+	for(i = 0; i < nerr; i++)
+	{
+		if (errdef[i].Err_ID >= 0 && errdef[i].Err_ID < ERR_BANDS * 1000 && errdef[i].Err_ID % 1000 < ERR_BAND_SIZE)
+			err_index[errdef[i].Err_ID / 1000][errdef[i].Err_ID % 1000] = i + 1;
+	}
+}
+
+/*!	\func	const char* find_err(int err_code)
+ * 		\brief	This function is used to look up the description of an error code, in constant time
+ * 		\param	err_code is the error code
+ * 		\return	the description of the error, which must not be freed \n
+ * 					NULL if err_code is not an error code
+ */
+const char* find_err(int err_code)
+{
+	int i, nerr;
+	pthread_once(&err_once, build_err_index);
+	if (err_code >= 0 && err_code < ERR_BANDS * 1000 && err_code % 1000 < ERR_BAND_SIZE)
+	{
+		i = err_index[err_code / 1000][err_code % 1000];
+		return (i == 0)? NULL : errdef[i - 1].dsc;
+	}
+	/* a code outside the table, which errdef should not have */
+	nerr = sizeof(errdef)/sizeof(errmsg);
+	for(i = 0; i < nerr; i++)
+	{
+		if (errdef[i].Err_ID == err_code)
+			return errdef[i].dsc;
+	}
+	return NULL;
+}
 
 /*!	\func	void iso_err(int *fldErr, char *filename)
  *  	\brief	Show the message error to the logfile.
@@ -21,11 +71,11 @@
 void iso_err(int *fldErr, char *filename)
 {
 	time_t t;
-	int i, j, nerr;
+	int i;
 	char* tmp;
+	const char *desc;
     FILE *fp;
     fp = fopen(filename, "a+");
-    //nerr = sizeof(errdef)/sizeof(errmsg);
     if (!fp)
     {
     	printf("Can not open file %s", filename);
@@ -39,21 +89,15 @@ void iso_err(int *fldErr, char *filename)
     {
     	if (fldErr[i] != 0)
     	{
-    		j = 0;
-    		while (j < nerr)
+    		desc = find_err(fldErr[i]);
+    		if (desc != NULL)
     		{
-    			if (fldErr[i] == errdef[j].Err_ID)
-    			{
-
-    				fprintf(fp, "	<field id = %d>\n", i);
-    				fprintf(fp, "		<err_code>%d>", fldErr[i]);
-    				fprintf(fp, "		</err_code>\n");
-    				fprintf(fp, "		<desc>%s>", errdef[i].dsc);
-    				fprintf(fp, "		</desc>\n");
-    				fprintf(fp, "	</field>\n", i);
-    				break;
-    			}
-    			j++;
+    			fprintf(fp, "	<field id = %d>\n", i);
+    			fprintf(fp, "		<err_code>%d>", fldErr[i]);
+    			fprintf(fp, "		</err_code>\n");
+    			fprintf(fp, "		<desc>%s>", desc);
+    			fprintf(fp, "		</desc>\n");
+    			fprintf(fp, "	</field>\n");
     		}
     	}
     }
@@ -61,35 +105,18 @@ void iso_err(int *fldErr, char *filename)
     fclose(fp);
 }
 
-/*!	\func	char *scan_err(int *fldErr, FILE *fp)
+/*!	\func	const char *scan_err(int err_code)
 * 		\brief	this procedure is call when having error during field setting
 * 		\param	err_code is the return value of the function iso8583_set_fmtbitmap
-* 		\Output: description about the error
+* 		\Output: description about the error, which must not be freed \n
+* 					ERR_UNKNOWN_DESC if err_code is not an error code
 */
 
-char* scan_err(int err_code)
+const char* scan_err(int err_code)
 {
-	int i, nerr;
-	char *desc;
-	i = 0;
-	nerr = sizeof(errdef)/sizeof(errmsg);
-	for(; i < nerr; i++)
-	{
-		if (errdef[i].Err_ID == err_code)
-		{
-			desc = (char *) malloc(strlen(errdef[i].dsc) * sizeof(char));
-			strcpy(desc, errdef[i].dsc);
-			break;
-		}
-	}
-	if (!desc)
-	{
-		return "Can not recognize this error code";
-	}
-	else
-	{
-		return desc;
-	}
+	const char *desc;
+	desc = find_err(err_code);
+	return (desc == NULL)? ERR_UNKNOWN_DESC : desc;
 }
 
 /*!	\func	void *sys_err(int err_code, FILE *fp)
@@ -101,7 +128,7 @@ char* scan_err(int err_code)
 void sys_err(int err_code, char *filename)
 {
 	time_t t;
-	char *desc;
+	const char *desc;
     FILE *fp;
     fp = fopen(filename, "a+");
     if (!fp)
@@ -120,46 +147,131 @@ void sys_err(int err_code, char *filename)
  * 		\param err_code the error code that recieved when error appear
  * 		\param err_type is type of error, if err_type = 1 is the system error else is the iso error
  * 		\param desc is the description of this error of developer
- * 		\output: the desc of this error is written to log file (file name)
+ * 		\output: the desc of this error is put into the ring of the error log, the writer thread writes it
+ * 				to the log file of the day (dd-mm-yyyy.log) without the caller waiting on the file
+ * 		\return 0 if the error is logged, -1 if it is dropped because the ring is full
  */
 
 int handle_err(int err_code, int err_type, char *moredesc)
 {
-	char *filename;
-	char str[100]; //Stirng of time
-	FILE *fp;
-	time_t t;
-	struct tm *ptr;
-	char *desc;
-//	filename = "log.txt";
-	t = time(0);
-	ptr = localtime(&t);
-	filename = malloc(100);
-	strftime(filename, 100, "%d-%m-%Y", ptr);
-	strcat(filename, ".log");
-	fp = fopen(filename, "a+");
-	if (!fp)
-	{
-		printf("Can not open file %s", filename);
-		return -1;
-	}
-	desc = scan_err(err_code);
-	if (!desc)
-	{
-		printf("Error when scan this error");
+	if (find_err(err_code) == NULL)
 		return -1;
-	}
-	if (strcmp(desc, "Can not recognize this error code") == 0)
-	{
-		return -1;
-	}
-    //fprintf(fp, "%s -",  ctime(&t));
-    strftime(str, 100, "%d-%m-%Y:%H:%M:%S", ptr);
-    fprintf(fp, "%s -", str);
-    if (err_type == ISO)
-    	fprintf(fp, "%d - ISO - %s - %s\n", err_code, desc, moredesc);
-    else
-    	fprintf(fp, "%d - SYS - %s - %s\n", err_code, desc, moredesc);
-    fclose(fp);
-    return 0;
+	return errlog_push(err_code, err_type, moredesc);
+}
+
+/*!	\brief	The names of the ISO_ datatypes, by value */
+static const char *const datatype_name[] = {"BITMAP", "N", "A", "B", "Z", "AN", "AS", "NS", "XN", "ANP", "ANS"};
+
+/*!	\func	static int append(char *buf, int size, int len, const char *fmt, ...)
+ * 		\brief	Append to a description of len characters, nothing is written past size
+ * 		\return	the length of the description with the appended text, even if it is cut
+ */
+static int append(char *buf, int size, int len, const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	if (len < size)
+		len += vsnprintf(buf + len, size - len, fmt, ap);
+	else
+		len += vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+	return len;
+}
+
+/*!	\func	void clear_isoerr(isoerr *e)
+ * 		\brief	Reset an error context, its code is SUCCEEDED and the other values are -1
+ * 		\param	e is the error context
+ */
+void clear_isoerr(isoerr *e)
+{
+	e->code = SUCCEEDED;
+	e->field = -1;
+	e->offset = -1;
+	e->expected = -1;
+	e->actual = -1;
+	e->format = -1;
+}
+
+/*!	\func	int fail_isoerr(isoerr *e, int code, int field, int offset, int expected, int actual, int format)
+ * 		\brief	Record an error into an error context, nothing is formatted
+ * 		\param	e is the error context
+ * 		\return	code
+ */
+int fail_isoerr(isoerr *e, int code, int field, int offset, int expected, int actual, int format)
+{
+	e->code = code;
+	e->field = field;
+	e->offset = offset;
+	e->expected = expected;
+	e->actual = actual;
+	e->format = format;
+	return code;
+}
+
+/*!	\func	int report_isoerr(const isoerr *ctx, isoerr *e, int err)
+ * 		\brief	End a call that records its errors into e, which is the caller's context ctx or a local one. \n
+ * 				The error is logged only if the caller has no context, as the library always did.
+ * 		\param	ctx is the context of the caller, NULL to log the error
+ * 		\param	e is ctx, or the local context of the call when ctx is NULL
+ * 		\param	err is the result of the call
+ * 		\return	err
+ */
+int report_isoerr(const isoerr *ctx, isoerr *e, int err)
+{
+	if (err == SUCCEEDED)
+		return err;
+	if (e->code != err)
+		/* the error comes from a call that has already reported it, with another context */
+		fail_isoerr(e, err, -1, -1, -1, -1, -1);
+	else if (ctx == NULL)
+		log_isoerr(e);
+	return err;
+}
+
+/*!	\func	static int describe_isoerr(const isoerr *e, const char *desc, char *buf, int size)
+ * 		\brief	Describe an error context in one line, the values that don't apply are left out
+ * 		\param	desc is the description of the error code, NULL to leave it out
+ * 		\return	the length of the description, which may be more than size - 1 if it is cut
+ */
+static int describe_isoerr(const isoerr *e, const char *desc, char *buf, int size)
+{
+	int len = 0;
+
+	if (size > 0)
+		buf[0] = '\0';
+	if (e->field >= 0)
+		len = append(buf, size, len, "Field %d", e->field);
+	if (e->offset >= 0)
+		len = append(buf, size, len, "%sat offset %d", (len > 0)? " " : "", e->offset);
+	if (desc != NULL)
+		len = append(buf, size, len, "%s%s", (len > 0)? " --> " : "", desc);
+	if (e->actual >= 0 && e->expected >= 0)
+		len = append(buf, size, len, "%s%d bytes, %d expected", (len > 0)? ": " : "", e->actual, e->expected);
+	if (e->format >= 0 && e->format < (int) (sizeof(datatype_name)/sizeof(datatype_name[0])))
+		len = append(buf, size, len, "%s(%s)", (len > 0)? " " : "", datatype_name[e->format]);
+	return len;
+}
+
+/*!	\func	int format_isoerr(const isoerr *e, char *buf, int size)
+ * 		\brief	Describe an error context in one line, the values that don't apply are left out
+ * 		\param	e is the error context filled by a failing call
+ * 		\param	buf receives the description, it is cut to size - 1 characters
+ * 		\param	size is the size of buf
+ * 		\return	the length of the description, which may be more than size - 1 if it is cut
+ */
+int format_isoerr(const isoerr *e, char *buf, int size)
+{
+	return describe_isoerr(e, scan_err(e->code), buf, size);
+}
+
+/*!	\func	int log_isoerr(const isoerr *e)
+ * 		\brief	Write an error context to the log file, by ::handle_err which adds the description of the code
+ * 		\param	e is the error context filled by a failing call
+ * 		\return	the result of ::handle_err
+ */
+int log_isoerr(const isoerr *e)
+{
+	char desc[160];
+	describe_isoerr(e, NULL, desc, sizeof(desc));
+	return handle_err(e->code, (e->code == ERR_OUTMEM)? SYS : ISO, desc);
 }
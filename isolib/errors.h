@@ -23,6 +23,7 @@
 #define  ERR_HEXBYT	2000
 #define	ERR_BYTHEX	2001
 #define	ERR_WROFMT	2002
+#define	ERR_B64BYT	2003
 
 #define	ERR_NODFMT	4000	// not support this dump format
 
@@ -31,9 +32,18 @@
 #define ERR_XMLPAS		5001
 #define ERR_IVLIDX		5002
 #define ERR_XMLSYT		5003
+#define ERR_JSNPAS		5004
+#define ERR_JSNSYT		5005
+#define ERR_SNPHDR		5006
+#define ERR_SNPREC		5007
+#define ERR_SNPDEF		5008
 
 /*!	\brief	buffer-related errors	from 6001 to 7000	*/
 #define ERR_SHTBUF		6001
+#define ERR_IOWRIT		6002		// Failed to write the output
+#define ERR_IOREAD		6003		// Failed to read the input
+#define ERR_SOCKET		6004		// Failed to set up a socket
+#define ERR_CONCLS		6005		// The connection is closed
 
 
 #define ISO 1
@@ -67,6 +77,7 @@ static const errmsg errdef[] ={
 		{ERR_IVLFLD, "Invalid field"},
 		{ERR_HEXBYT, "Failed to convert hexa characters to a byte array"},
 		{ERR_BYTHEX, "Failed to convert a byte array to hexa characters"},
+		{ERR_B64BYT, "Failed to convert base64 characters to a byte array"},
 		{ERR_NODFMT, "Not support this dump format"},
 		{ERR_IVLVER, "Invalid version"},
 		{ERR_IVLFLG, "Invalid flag"},
@@ -76,7 +87,16 @@ static const errmsg errdef[] ={
 		{ERR_XMLPAS, "The XML document is not well-formed"},
 		{ERR_IVLIDX,"Invalid index value"},
 		{ERR_SHTBUF,"The buffer is too short"},
+		{ERR_IOWRIT,"Failed to write the output"},
+		{ERR_IOREAD,"Failed to read the input"},
+		{ERR_SOCKET,"Failed to set up the socket"},
+		{ERR_CONCLS,"The connection is closed"},
 		{ERR_XMLSYT,"Xml syntax error"},
+		{ERR_JSNPAS,"The JSON document is not well-formed"},
+		{ERR_JSNSYT,"Json syntax error"},
+		{ERR_SNPHDR,"The data is not a snapshot"},
+		{ERR_SNPREC,"The snapshot record is corrupted"},
+		{ERR_SNPDEF,"The definition of the snapshot record is not registered"},
 		{ERR_CPYNUL,"Copy NULL memory"},
 		{ERR_APDNUL,"Use an empty memory to append"},
 		{ERR_INSNUL, "Use an empty memory to insert"},
@@ -89,13 +109,24 @@ static const errmsg errdef[] ={
  * 		\filename is name of log file
 */
 void iso_err(int *fldErr, char *filename);
-//char *scan_err(int err_code, int fld_idx)
-/*!	\func	char *scan_err(int *fldErr, FILE *fp)
+/*!	\brief	The description scan_err gives to a code that is not an error code */
+#define ERR_UNKNOWN_DESC	"Can not recognize this error code"
+
+/*!	\func	const char* find_err(int err_code)
+ * 		\brief	This function is used to look up the description of an error code, in constant time
+ * 		\param	err_code is the error code
+ * 		\return	the description of the error, which must not be freed \n
+ * 					NULL if err_code is not an error code
+ */
+const char* find_err(int err_code);
+
+/*!	\func	const char *scan_err(int err_code)
  * 		\brief	This function is used to show the description of errors
  * 		\param	err_code is the return value of the function iso8583_set_fmtbitmap
- * 		\Output: one message to description the error
+ * 		\Output: one message to description the error, which must not be freed \n
+ * 					ERR_UNKNOWN_DESC if err_code is not an error code
  */
-char *scan_err(int err_code);
+const char *scan_err(int err_code);
 
 /*!	\func	void *sys_err(int err_code, FILE *fp)
  * 		\brief	This function is used to process the system error (such as out of memory ...)
@@ -110,7 +141,43 @@ void sys_err(int err_code, char *filename);
  * 		\param err_code the error code that recieved when error appear
  * 		\param err_type is type of error, if err_type = 1 is the system error else is the iso error
  * 		\param moredesc is the description of this error of developer
- * 		\output: the desc of this error is written to log file (file name)
+ * 		\output: the desc of this error is put into the ring of the error log, the writer thread writes it
+ * 				to the log file of the day (dd-mm-yyyy.log) without the caller waiting on the file
+ * 		\return 0 if the error is logged, -1 if it is dropped because the ring is full
  */
 int handle_err(int err_code, int err_type, char *moredesc);
+
+/*!	\func	void clear_isoerr(isoerr *e)
+ * 		\brief	Reset an error context, its code is SUCCEEDED and the other values are -1
+ * 		\param	e is the error context
+ */
+void clear_isoerr(isoerr *e);
+
+/*!	\func	int fail_isoerr(isoerr *e, int code, int field, int offset, int expected, int actual, int format)
+ * 		\brief	Record an error into an error context, the values that don't apply are -1
+ * 		\return	code
+ */
+int fail_isoerr(isoerr *e, int code, int field, int offset, int expected, int actual, int format);
+
+/*!	\func	int report_isoerr(const isoerr *ctx, isoerr *e, int err)
+ * 		\brief	End a call that records its errors into e: the error is logged if the caller's context ctx is NULL
+ * 		\return	err
+ */
+int report_isoerr(const isoerr *ctx, isoerr *e, int err);
+
+/*!	\func	int format_isoerr(const isoerr *e, char *buf, int size)
+ * 		\brief	Describe an error context in one line, e.g. "Field 4 at offset 22 --> The length of field is not correct: 13 bytes, 12 expected (N)"
+ * 		\param	e is the error context filled by a failing call
+ * 		\param	buf receives the description, it is cut to size - 1 characters
+ * 		\param	size is the size of buf
+ * 		\return	the length of the description, which may be more than size - 1 if it is cut
+ */
+int format_isoerr(const isoerr *e, char *buf, int size);
+
+/*!	\func	int log_isoerr(const isoerr *e)
+ * 		\brief	Write an error context to the log file, by ::handle_err
+ * 		\param	e is the error context filled by a failing call
+ * 		\return	the result of ::handle_err
+ */
+int log_isoerr(const isoerr *e);
 #endif /*ERRORS_H_*/
@@ -0,0 +1,240 @@
+/*!	\file		hexa.c
+ * 		\brief	This file converts byte arrays to hexa character arrays and back. \n
+ * 					The scalar code is table driven and doesn't depend on the locale,
+ * 					longer runs go through SSE2 or AVX2 kernels when the CPU has them.
+ */
+#include "hexa.h"
+#include "errors.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define HEXA_SIMD	1
+#include <immintrin.h>
+#endif
+
+/*!	\brief	The value of each hexa character ORed with 0x10, 0 for the other characters */
+static const unsigned char hexa_table[256] = {
+	['0'] = 0x10, ['1'] = 0x11, ['2'] = 0x12, ['3'] = 0x13, ['4'] = 0x14,
+	['5'] = 0x15, ['6'] = 0x16, ['7'] = 0x17, ['8'] = 0x18, ['9'] = 0x19,
+	['A'] = 0x1A, ['B'] = 0x1B, ['C'] = 0x1C, ['D'] = 0x1D, ['E'] = 0x1E, ['F'] = 0x1F,
+	['a'] = 0x1A, ['b'] = 0x1B, ['c'] = 0x1C, ['d'] = 0x1D, ['e'] = 0x1E, ['f'] = 0x1F
+};
+
+static const char hexa_digits[16] = HEXA_DIGITS;
+
+#ifdef HEXA_SIMD
+/*!	\fn		static __m128i nibbles_to_chars(__m128i n)
+ * 		\brief	Convert 16 nibbles (0..15) to upper case hexa characters
+ */
+static inline __m128i nibbles_to_chars(__m128i n){
+	__m128i gt9 = _mm_cmpgt_epi8(n, _mm_set1_epi8(9));
+	n = _mm_add_epi8(n, _mm_set1_epi8('0'));
+	return _mm_add_epi8(n, _mm_and_si128(gt9, _mm_set1_epi8('A' - '0' - 10)));
+}
+
+/*!	\fn		static int encode_sse2(const char *src, int len, char *dst)
+ * 		\brief	Encode the 16-byte blocks of src, return the number of bytes encoded
+ */
+static int encode_sse2(const char *src, int len, char *dst){
+	const __m128i mask = _mm_set1_epi8(0x0F);
+	int i;
+	for(i = 0; i + 16 <= len; i += 16){
+		__m128i in = _mm_loadu_si128((const __m128i*) (src + i));
+		__m128i hi = _mm_and_si128(_mm_srli_epi16(in, 4), mask);
+		__m128i lo = _mm_and_si128(in, mask);
+		_mm_storeu_si128((__m128i*) (dst + 2*i), nibbles_to_chars(_mm_unpacklo_epi8(hi, lo)));
+		_mm_storeu_si128((__m128i*) (dst + 2*i + 16), nibbles_to_chars(_mm_unpackhi_epi8(hi, lo)));
+	}
+	return i;
+}
+
+/*!	\fn		static __m128i chars_to_nibbles(__m128i c, __m128i *valid)
+ * 		\brief	Convert 16 hexa characters to their values, *valid has 0xFF for each hexa character
+ */
+static inline __m128i chars_to_nibbles(__m128i c, __m128i *valid){
+	const __m128i zero = _mm_setzero_si128();
+	__m128i d = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+	__m128i l = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+	__m128i is_d = _mm_cmpeq_epi8(_mm_subs_epu8(d, _mm_set1_epi8(9)), zero);
+	__m128i is_l = _mm_cmpeq_epi8(_mm_subs_epu8(l, _mm_set1_epi8(5)), zero);
+	*valid = _mm_or_si128(is_d, is_l);
+	return _mm_or_si128(_mm_and_si128(is_d, d), _mm_and_si128(is_l, _mm_add_epi8(l, _mm_set1_epi8(10))));
+}
+
+/*!	\fn		static __m128i pair_nibbles(__m128i v)
+ * 		\brief	Combine 16 nibbles into 8 bytes, each held by a 16-bit lane
+ */
+static inline __m128i pair_nibbles(__m128i v){
+	__m128i hi = _mm_slli_epi16(_mm_and_si128(v, _mm_set1_epi16(0x00FF)), 4);
+	return _mm_or_si128(hi, _mm_srli_epi16(v, 8));
+}
+
+/*!	\fn		static int decode_sse2(const char *src, int len, char *dst, int *bad)
+ * 		\brief	Decode the 32-character blocks of src, return the number of characters decoded. \n
+ * 					*bad is set if a block contains a non hexa character.
+ */
+static int decode_sse2(const char *src, int len, char *dst, int *bad){
+	__m128i ok = _mm_set1_epi8(-1);
+	int i;
+	for(i = 0; i + 32 <= len; i += 32){
+		__m128i v0, v1, ok0, ok1;
+		v0 = chars_to_nibbles(_mm_loadu_si128((const __m128i*) (src + i)), &ok0);
+		v1 = chars_to_nibbles(_mm_loadu_si128((const __m128i*) (src + i + 16)), &ok1);
+		ok = _mm_and_si128(ok, _mm_and_si128(ok0, ok1));
+		_mm_storeu_si128((__m128i*) (dst + i/2), _mm_packus_epi16(pair_nibbles(v0), pair_nibbles(v1)));
+	}
+	*bad = (_mm_movemask_epi8(ok) != 0xFFFF);
+	return i;
+}
+
+/*!	\fn		static int encode_avx2(const char *src, int len, char *dst)
+ * 		\brief	Encode the 32-byte blocks of src, return the number of bytes encoded
+ */
+__attribute__((target("avx2")))
+static int encode_avx2(const char *src, int len, char *dst){
+	const __m256i mask = _mm256_set1_epi8(0x0F);
+	const __m256i nine = _mm256_set1_epi8(9);
+	int i;
+	for(i = 0; i + 32 <= len; i += 32){
+		__m256i in = _mm256_loadu_si256((const __m256i*) (src + i));
+		__m256i hi = _mm256_and_si256(_mm256_srli_epi16(in, 4), mask);
+		__m256i lo = _mm256_and_si256(in, mask);
+		__m256i a = _mm256_unpacklo_epi8(hi, lo);
+		__m256i b = _mm256_unpackhi_epi8(hi, lo);
+		/* unpack works per 128-bit lane, restore the byte order */
+		__m256i c0 = _mm256_permute2x128_si256(a, b, 0x20);
+		__m256i c1 = _mm256_permute2x128_si256(a, b, 0x31);
+		c0 = _mm256_add_epi8(_mm256_add_epi8(c0, _mm256_set1_epi8('0')),
+				_mm256_and_si256(_mm256_cmpgt_epi8(c0, nine), _mm256_set1_epi8('A' - '0' - 10)));
+		c1 = _mm256_add_epi8(_mm256_add_epi8(c1, _mm256_set1_epi8('0')),
+				_mm256_and_si256(_mm256_cmpgt_epi8(c1, nine), _mm256_set1_epi8('A' - '0' - 10)));
+		_mm256_storeu_si256((__m256i*) (dst + 2*i), c0);
+		_mm256_storeu_si256((__m256i*) (dst + 2*i + 32), c1);
+	}
+	return i;
+}
+
+/*!	\fn		static int decode_avx2(const char *src, int len, char *dst, int *bad)
+ * 		\brief	Decode the 64-character blocks of src, return the number of characters decoded. \n
+ * 					*bad is set if a block contains a non hexa character.
+ */
+__attribute__((target("avx2")))
+static int decode_avx2(const char *src, int len, char *dst, int *bad){
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i ok = _mm256_set1_epi8(-1);
+	__m256i v[2];
+	int i, k;
+	for(i = 0; i + 64 <= len; i += 64){
+		for(k = 0; k < 2; k++){
+			__m256i c = _mm256_loadu_si256((const __m256i*) (src + i + 32*k));
+			__m256i d = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+			__m256i l = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+			__m256i is_d = _mm256_cmpeq_epi8(_mm256_subs_epu8(d, _mm256_set1_epi8(9)), zero);
+			__m256i is_l = _mm256_cmpeq_epi8(_mm256_subs_epu8(l, _mm256_set1_epi8(5)), zero);
+			__m256i n = _mm256_or_si256(_mm256_and_si256(is_d, d), _mm256_and_si256(is_l, _mm256_add_epi8(l, _mm256_set1_epi8(10))));
+			ok = _mm256_and_si256(ok, _mm256_or_si256(is_d, is_l));
+			v[k] = _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(n, _mm256_set1_epi16(0x00FF)), 4), _mm256_srli_epi16(n, 8));
+		}
+		/* pack works per 128-bit lane, restore the qword order */
+		_mm256_storeu_si256((__m256i*) (dst + i/2), _mm256_permute4x64_epi64(_mm256_packus_epi16(v[0], v[1]), 0xD8));
+	}
+	*bad = (_mm256_movemask_epi8(ok) != -1);
+	return i;
+}
+
+/*!	\fn		static int has_avx2(void)
+ * 		\brief	Check once whether the CPU runs AVX2 code
+ */
+static int has_avx2(void){
+	static int avx2 = -1;
+	if(avx2 < 0){
+		__builtin_cpu_init();
+		avx2 = __builtin_cpu_supports("avx2")? 1 : 0;
+	}
+	return avx2;
+}
+#endif
+
+/*!	\fn		void hexa_encode(const char *src, int len, char *dst)
+ * 		\brief	Encode a byte array into upper case hexa characters, the high nibble first
+ * 		\param	src	the bytes to encode
+ * 		\param	len	the number of bytes in src
+ * 		\param	dst	the output buffer, it must hold 2*len characters. It is not NUL terminated.
+ */
+void hexa_encode(const char *src, int len, char *dst){
+	int i = 0;
+#ifdef HEXA_SIMD
+	if(len >= 32 && has_avx2())
+		i = encode_avx2(src, len, dst);
+	if(len - i >= 16)
+		i += encode_sse2(src + i, len - i, dst + 2*i);
+#endif
+	for(; i < len; i++){
+		unsigned char b = (unsigned char) src[i];
+		dst[2*i] = hexa_digits[b >> 4];
+		dst[2*i+1] = hexa_digits[b & 0x0F];
+	}
+}
+
+/*!	\fn		void hexa_decode(const char *src, int len, char *dst)
+ * 		\brief	Decode hexa characters of either case into a byte array. \n
+ * 					The input is trusted, a non hexa character is decoded as 0.
+ * 					Use ::hexa_decode_strict for data that comes from outside.
+ * 		\param	src	the hexa characters to decode
+ * 		\param	len	the number of characters in src, it should be even, the last odd one is ignored
+ * 		\param	dst	the output buffer, it must hold len/2 bytes
+ */
+void hexa_decode(const char *src, int len, char *dst){
+	int i = 0;
+#ifdef HEXA_SIMD
+	int bad;
+	if(len >= 64 && has_avx2())
+		i = decode_avx2(src, len, dst, &bad);
+	if(len - i >= 32)
+		i += decode_sse2(src + i, len - i, dst + i/2, &bad);
+#endif
+	for(; i + 1 < len; i += 2)
+		dst[i/2] = (char) ((hexa_table[(unsigned char) src[i]] & 0x0F) << 4 | (hexa_table[(unsigned char) src[i+1]] & 0x0F));
+}
+
+/*!	\fn		int hexa_decode_strict(const char *src, int len, char *dst)
+ * 		\brief	Decode hexa characters of either case into a byte array, validating every character
+ * 		\param	src	the hexa characters to decode
+ * 		\param	len	the number of characters in src, it must be even
+ * 		\param	dst	the output buffer, it must hold len/2 bytes. Its content is undefined on error.
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_HEXBYT if len is odd or src contains a non hexa character
+ */
+int hexa_decode_strict(const char *src, int len, char *dst){
+	int i = 0;
+	unsigned char valid = 0x10;
+	if(len < 0 || len % 2)
+		return ERR_HEXBYT;
+#ifdef HEXA_SIMD
+	{
+		int bad = 0, bad2 = 0;
+		if(len >= 64 && has_avx2())
+			i = decode_avx2(src, len, dst, &bad);
+		if(len - i >= 32)
+			i += decode_sse2(src + i, len - i, dst + i/2, &bad2);
+		if(bad || bad2)
+			return ERR_HEXBYT;
+	}
+#endif
+	for(; i < len; i += 2){
+		unsigned char hi = hexa_table[(unsigned char) src[i]];
+		unsigned char lo = hexa_table[(unsigned char) src[i+1]];
+		valid &= hi & lo;
+		dst[i/2] = (char) ((hi & 0x0F) << 4 | (lo & 0x0F));
+	}
+	return valid? SUCCEEDED : ERR_HEXBYT;
+}
+
+/*!	\fn		int hexa_value(char ch)
+ * 		\brief	Get the value of a hexa character of either case
+ * 		\return	the value (0..15) of ch \n
+ * 					-1 if ch is not a hexa character
+ */
+int hexa_value(char ch){
+	unsigned char v = hexa_table[(unsigned char) ch];
+	return (v & 0x10)? (v & 0x0F) : -1;
+}
@@ -0,0 +1,24 @@
+/*!	\file		hexa.h
+ * 		\brief	Locale-free conversion between byte arrays and hexa character arrays
+ */
+#ifndef HEXA_H_
+#define HEXA_H_
+
+/*!	\brief	The hexa digits used by the encoder, the decoder accepts both cases */
+#define HEXA_DIGITS		"0123456789ABCDEF"
+
+/*!	\brief	Encode len bytes of src into 2*len hexa characters at dst */
+void hexa_encode(const char *src, int len, char *dst);
+
+/*!	\brief	Decode len hexa characters of src into len/2 bytes at dst, without validation */
+void hexa_decode(const char *src, int len, char *dst);
+
+/*!	\brief	Decode len hexa characters of src into len/2 bytes at dst, rejecting any non hexa character. \n
+ * 				Both decoders work in place, dst may be src.
+ */
+int hexa_decode_strict(const char *src, int len, char *dst);
+
+/*!	\brief	Get the value of a hexa character, -1 if it is not a hexa character */
+int hexa_value(char ch);
+
+#endif /*HEXA_H_*/
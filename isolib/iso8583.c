@@ -7,6 +7,7 @@
 #include "iso8583.h"
 #include "utilities.h"
 #include "errors.h"
+#include "hexa.h"
 #include "include/expat.h"
 
 /*!	\func	void init_message(isomsg *m, const isodef *def, const msgprop *prop);
@@ -19,6 +20,9 @@ void init_message(isomsg *m, const isodef *def, const msgprop *prop){
 	int i = 0;
 	/* set isodef */
 		m->def = def;		/* if def is NULL, ok it will be set later */
+		m->plan = NULL;
+		m->arena = NULL;
+		m->err = NULL;
 	/* set properties */
 		m->prop.alphanumeric_pad = prop->alphanumeric_pad;
 		m->prop.numeric_pad = prop->numeric_pad;
@@ -38,6 +42,7 @@ void init_message(isomsg *m, const isodef *def, const msgprop *prop){
  */
 void set_isodef(isomsg *m, isodef *def){
 	m->def = def;
+	m->plan = NULL;
 }
 
 /*! 	\func	set_prop(isomsg *m, msgprop *prop)
@@ -51,532 +56,866 @@ void set_prop(isomsg *m, msgprop *prop){
 
 		if(prop->bmp_flag == BMP_BINARY || prop->bmp_flag == BMP_HEXA)
 			 m->prop.bmp_flag = prop->bmp_flag;
+		m->plan = NULL;
 }
 
+/*! 	\func	void set_arena(isomsg *m, isoarena *arena)
+ * 		\brief	make the fields of m come from an arena. \n
+ * 					The current fields of m are freed. Afterwards ::free_message resets the arena instead of
+ * 					freeing each field, so the arena must hold the fields of m only. Reusing the message and
+ * 					its arena, e.g. one per connection, unpacks and packs without calling malloc.
+ * 		\param	 m		is an ::isomsg struct pointer initialized by ::init_message
+ * 		\param	 arena	is an ::isoarena initialized by ::init_arena that outlives m, NULL to go back to the heap
+ */
+void set_arena(isomsg *m, isoarena *arena){
+	free_message(m);
+	m->arena = arena;
+}
+
+/*! 	\func	void set_errctx(isomsg *m, isoerr *err)
+ * 		\brief	make the failing calls on m fill an error context instead of logging the error. \n
+ * 					The codec then neither formats nor logs anything, the caller decides which errors
+ * 					are worth it with ::format_isoerr and ::log_isoerr.
+ * 		\param	 m		is an ::isomsg struct pointer initialized by ::init_message
+ * 		\param	 err	is the ::isoerr that receives the errors, NULL to log them again
+ */
+void set_errctx(isomsg *m, isoerr *err){
+	m->err = err;
+}
+
+/*!	\func	void init_message_plan(isomsg *m, const isoplan *plan);
+ * 		\brief	Initialize an ISO message struct that is packed with a compiled plan
+ * 		\param	m is an ::isomsg pointer that will be initialized
+ * 		\param	plan is an ::isoplan compiled by ::compile_plan, it must outlive m. \n
+ * 					The definition and the properties of m are taken from it.
+ */
+void init_message_plan(isomsg *m, const isoplan *plan){
+	init_message(m, plan->def, &plan->prop);
+	m->plan = plan;
+}
+
+/*!	\func	static int compile_fields(isoplan *plan, const isodef *def, const msgprop *prop, isoerr *e)
+ * 		\brief	The compiler of ::compile_plan, the errors are recorded into e
+ */
+static int compile_fields(isoplan *plan, const isodef *def, const msgprop *prop, isoerr *e){
+	int i, k, max_len;
+	isocodec *c;
+
+	plan->def = def;
+	plan->prop.alphanumeric_pad = prop->alphanumeric_pad;
+	plan->prop.numeric_pad = prop->numeric_pad;
+	if(prop->bmp_flag != BMP_BINARY && prop->bmp_flag != BMP_HEXA)
+		plan->prop.bmp_flag = BMP_BINARY;
+	else
+		plan->prop.bmp_flag = prop->bmp_flag;
+
+	for(i = 0; i <= 128; i++){
+		c = &plan->fld[i];
+		if(def[i].format < ISO_BITMAP || def[i].format > ISO_ALPHANUMERIC_SPC){
+			return fail_isoerr(e, ERR_IVLFMT, i, -1, -1, -1, def[i].format);
+		}
+		/* the MTI is fixed length, the length header can't be wider than 4 digits */
+		if(def[i].lenflds < 0 || def[i].lenflds > 4 || (i == 0 && def[i].lenflds != 0) \
+		|| def[i].flds <= 0 || def[i].flds > 0xFFFF){
+			return fail_isoerr(e, ERR_IVLLEN, i, -1, -1, -1, def[i].format);
+		}
+		c->format = (unsigned char) def[i].format;
+		c->lenflds = (unsigned char) def[i].lenflds;
+		c->pad = '\0';
+		if(i == 1){
+			c->kind = CODEC_BITMAP;
+			c->min_len = c->max_len = 0;
+		}else if(def[i].lenflds != 0){
+			/* the length has to fit in the LL/LLL header too */
+			for(max_len = 1, k = 0; k < def[i].lenflds; k++)
+				max_len *= 10;
+			c->kind = CODEC_LLVAR;
+			c->min_len = 0;
+			c->max_len = (unsigned short) ((def[i].flds < max_len)? def[i].flds : max_len - 1);
+		}else{
+			if(i == 0 || def[i].format == ISO_BINARY){
+				/* binary data can't be padded */
+				c->kind = CODEC_FIXED;
+				c->min_len = (unsigned short) def[i].flds;
+			}else if(def[i].format == ISO_NUMERIC){
+				c->kind = CODEC_LPAD;
+				c->pad = plan->prop.numeric_pad;
+				c->min_len = 1;
+			}else{
+				c->kind = CODEC_RPAD;
+				c->pad = plan->prop.alphanumeric_pad;
+				c->min_len = 1;
+			}
+			c->max_len = (unsigned short) def[i].flds;
+		}
+	}
+	return SUCCEEDED;
+}
+
+
+/*!	\func	int compile_plan(isoplan *plan, const isodef *def, const msgprop *prop, isoerr *err);
+ * 		\brief	Compile an iso definition and message properties into a codec plan. \n
+ * 					The plan holds, for each field, the encoder/decoder kind, the padding character,
+ * 					the length limits and the width of the length header, so the codec doesn't have to
+ * 					interpret def on every call. Compile a plan once and share it between messages.
+ * 		\param	plan is the ::isoplan to fill
+ * 		\param	def is an array of 129 ::isodef structures (iso87, iso93 or a custom one), it must outlive plan
+ * 		\param	prop is a ::msgprop pointer whose value will be set as the properties of plan
+ * 		\param	err is the error context that receives the error, NULL to log the error
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_IVLFMT if a field has an undefined format \n
+ * 					ERR_IVLLEN if a field has an invalid length definition
+ */
+int compile_plan(isoplan *plan, const isodef *def, const msgprop *prop, isoerr *err){
+	isoerr local, *e = (err != NULL)? err : &local;
+	e->code = SUCCEEDED;
+	return report_isoerr(err, e, compile_fields(plan, def, prop, e));
+}
+
+/*!	\func	void message_bitmap(const isomsg *m, isobitmap *bmp);
+ * 		\brief	Build the bitmap of the fields 2..128 that contain data in m. \n
+ * 					Field 1 is set when one of the fields 65..128 is present.
+ * 		\param	m is an ::isomsg structure pointer
+ * 		\param	bmp receives the bitmap
+ */
+void message_bitmap(const isomsg *m, isobitmap *bmp){
+	uint64_t w[2] = {0, 0};
+	int i;
+	for(i = 2; i <= 128; i++)
+		w[(i-1) >> 6] |= (uint64_t) (m->fld[i].bytes != NULL && m->fld[i].length > 0) << ((i-1) & 63);
+	bmp->w[0] = w[0] | (w[1] != 0);
+	bmp->w[1] = w[1];
+}
 
-/*!	\func 	int pack_message(const isomsg *m, char *buf, int *buf_len);
- *		\brief  Pack the content of the ISO message m into buf. \n
- * 				 NOTE: buf must be large enough to contain the packed message.
- *				   Returns the length of the data written to buf.
+/*!	\func 	int pack_message(isomsg *m, char **buf, int *buf_len);
+ *		\brief  Pack the content of the ISO message m into a newly allocated buffer. \n
+ * 				 The buffer is sized exactly by a first pass of ::pack_fields, the caller must free it.
+ * 				 m->plan is used if it is set, otherwise m->def is compiled once for both passes.
  *
  * 		\param		m is an ::isomsg structure pointer that contains all message elements to be packed
- * 		\param		buf is the iso message buffer that contains the packed iso message.
+ * 		\param		buf receives the address of the buffer that contains the packed iso message.
  * 		\param		buf_len is the pointer that hold the buf's length
  * 		\return		SUCCEEDED(0) if having no error. \n
  * 						error number if having an error
  */
  int pack_message(isomsg* m, char** buf, int* buf_len){
-	bytes buf_bytes;
-	char bitmap[16];
-	int err=0, i = 0;
-	char errmsg[100];
-	bytes tmp_bytes, bin_bytes, hexa_bytes;
-	/* initilize buf_bytes, binary bitmap */
-	empty_bytes(&buf_bytes);
-	memset(bitmap, 16, '\0');
-
-	for( ; i <= 128 ; i++){
-		if ( i == 1) /* this field is the bitmap, it will be built from bitmap after this loop */
-			continue;
-		err = verify_bytes(&m->fld[i]);
-
-		/* this field does not contain data */
-		if(err != HASDATA){
-			if( i == 0 ){ /* this field is the MTI field, can't be empty, report error and return */
-				memset(errmsg, 100, '\0');
-				sprintf(errmsg, "%s:%d:The MTI field does not contain data", __FILE__, __LINE__);
-				handle_err(ERR_IVLFLD, ISO, errmsg);
-				free_bytes(&buf_bytes);
-				return ERR_IVLFLD;
-			}else{ /* this field is not the MTI field */
-				continue;
-			}
-		}
+	isoerr local, *e = (m->err != NULL)? m->err : &local;
+	isoplan tmp_plan;
+	const isoplan *plan = m->plan;
+	isobitmap bmp;
+	int err = 0, len = 0;
 
-		/* this field conatins data, verify its length */
+	*buf = NULL;
+	*buf_len = 0;
+	if(plan == NULL){
+		err = compile_plan(&tmp_plan, m->def, &m->prop, m->err);
+		if(err != SUCCEEDED)
+			return err;
+		plan = &tmp_plan;
+	}
+	message_bitmap(m, &bmp);
+	/* size the message first */
+	err = pack_fields(plan, &bmp, m->fld, NULL, 0, &len, m->err);
+	if(err != ERR_SHTBUF)
+		return err;
+	*buf = (char*) calloc(len + 1, sizeof(char));
+	if(*buf == NULL)
+		return report_isoerr(m->err, e, fail_isoerr(e, ERR_OUTMEM, -1, -1, len + 1, -1, -1));
+	err = pack_fields(plan, &bmp, m->fld, *buf, len, buf_len, m->err);
+	if(err != SUCCEEDED){
+		free(*buf);
+		*buf = NULL;
+	}
+	return err;
+ }
 
-		/* verify format */
-		err = verify_datatype(&m->fld[i], m->def[i].format);
-		if(err != CONFORM ){
-				memset(errmsg, 100, '\0');
-				sprintf(errmsg, "%s:%d:The field #%d does not conform its definition format", __FILE__, __LINE__);
-				handle_err(ERR_IVLFMT, ISO, errmsg);
-				free_bytes(&buf_bytes);
-				return ERR_IVLFMT;
-		}
+/*!	\func	static int check_field(const isocodec *c, const bytes *fld, int idx, int offset, int *packed_len, isoerr *e)
+ * 		\brief	Verify the datatype and the length of a field against its codec and compute its packed length
+ * 		\param	c is the compiled definition of the field
+ * 		\param	fld is the field, it must contain data
+ * 		\param	idx is the index of the field
+ * 		\param	offset is the offset the field is packed at
+ * 		\param	packed_len receives the number of bytes the field takes in the packed message
+ * 		\param	e receives the error
+ * 		\return	SUCCEEDED if the field can be packed \n
+ * 					error number if having an error
+ */
+static int check_field(const isocodec *c, const bytes *fld, int idx, int offset, int *packed_len, isoerr *e){
+	if(verify_datatype((bytes*) fld, c->format) != CONFORM)
+		return fail_isoerr(e, ERR_IVLFMT, idx, offset, -1, -1, c->format);
+	if(fld->length < c->min_len || fld->length > c->max_len)
+		return fail_isoerr(e, (c->kind == CODEC_LLVAR)? ERR_OVRLEN : ERR_IVLLEN, idx, offset,
+				(fld->length > c->max_len)? c->max_len : c->min_len, fld->length, c->format);
+	*packed_len = (c->kind == CODEC_LLVAR)? c->lenflds + fld->length : c->max_len;
+	return SUCCEEDED;
+}
 
-		/* verify data length */
-		if(m->def[i].lenflds != 0){ /* fixed length */
-			if(m->fld[i].length > m->def[i].flds){		/* over its definition's length */
-				memset(errmsg, 100, '\0');
-				sprintf(errmsg, "%s:%d: The field #%d is over its defintion's length", __FILE__, __LINE__ - 3, i);
-				handle_err(ERR_IVLLEN, ISO, errmsg);
-				free_bytes(&buf_bytes);
-				return ERR_IVLLEN;
-			}
-			if(m->fld[i].length < m->def[i].flds){	/* this field's length is smaller than its definition's length */
-				/* pad this field */
-				if(m->def[i].format == ISO_NUMERIC){
-					err = left_pad(&m->fld[i], m->def[i].flds, m->prop.numeric_pad);
-					if(err != SUCCEEDED){
-						memset(errmsg, 100, '\0');
-						sprintf(errmsg, "%s:%d: Can't left pad the field #%d", __FILE__, __LINE__ - 3, i);
-						handle_err(err, SYS, errmsg);
-						free_bytes(&buf_bytes);
-						return err;
-					}
-				}else{
-					right_pad(&m->fld[i], m->def[i].flds, m->prop.alphanumeric_pad);
-					if(err != SUCCEEDED){
-						memset(errmsg, 100, '\0');
-						sprintf(errmsg, "%s:%d: Can't right pad the field #%d", __FILE__, __LINE__ - 3, i);
-						handle_err(err, SYS, errmsg);
-						free_bytes(&buf_bytes);
-						return err;
-					}
-				}
-			}
-			/* copy data to tmp_bytes */
-			empty_bytes(&tmp_bytes);
-			err = import_data(&tmp_bytes, m->fld[i].bytes, m->fld[i].length);
-			if(err != SUCCEEDED){
-				memset(errmsg, 100, '\0');
-				sprintf(errmsg, "%s:%d: Can not import data", __FILE__, __LINE__ - 3);
-				handle_err(err, SYS, errmsg);
-				free_bytes(&buf_bytes);
-				return err;
-			}
-		}else{	/* variable length */
-			char fmt[20], tmp[20];
-			if(m->fld[i].length != m->def[i].flds){ /* this field's length is different from its definition */
-				memset(errmsg, 100, '\0');
-				sprintf(errmsg, "%s:%d: The length of the field #%d  is different from its definition", __FILE__, __LINE__, i);
-				handle_err(ERR_IVLLEN, ISO, errmsg);
-				free_bytes(&buf_bytes);
-				return err;
-			}
-			/* this field has sufficient length, insert its length header, copy to tmp_bytes */
-			empty_bytes(&tmp_bytes);
-			sprintf(fmt, "%%0%dd", m->def[i].lenflds);
-			sscanf(tmp, fmt, m->fld[i].length);
-			err = import_data(&tmp_bytes, tmp, m->def[i].lenflds);
-			if(err != SUCCEEDED){
-				memset(errmsg, 100, '\0');
-				sprintf(errmsg, "%s:%d: Can not import data", __FILE__, __LINE__ - 3);
-				handle_err(err, SYS, errmsg);
-				free_bytes(&buf_bytes);
-				return err;
-			}
-			err = append_bytes(&tmp_bytes, &m->fld[i]);
-			if(err != SUCCEEDED){
-				memset(errmsg, 100, '\0');
-				sprintf(errmsg, "%s:%d: Can not append bytes", __FILE__, __LINE__);
-				handle_err(err, SYS, errmsg);
-				free_bytes(&buf_bytes);
-				return err;
+/*!	\func	static char* write_field(const isocodec *c, const bytes *fld, char *pos)
+ * 		\brief	Write a field, with its length header or its padding, at pos
+ * 		\param	c is the compiled definition of the field
+ * 		\param	fld is the field, it must have been checked by check_field
+ * 		\param	pos is the position in the output buffer
+ * 		\return	the position right after the written field
+ */
+static char* write_field(const isocodec *c, const bytes *fld, char *pos){
+	int len = fld->length, i;
+
+	switch(c->kind){
+		case CODEC_LPAD:
+			memset(pos, c->pad, c->max_len - len);
+			memcpy(pos + c->max_len - len, fld->bytes, len);
+			return pos + c->max_len;
+		case CODEC_RPAD:
+			memcpy(pos, fld->bytes, len);
+			memset(pos + len, c->pad, c->max_len - len);
+			return pos + c->max_len;
+		case CODEC_LLVAR:
+			for(i = c->lenflds - 1; i >= 0; i--){
+				pos[i] = '0' + len % 10;
+				len /= 10;
 			}
-		}
-		/* copy data from tmp_bytes to buf_bytes */
-		err = append_bytes(&buf_bytes, &tmp_bytes);
-		if(err != SUCCEEDED){
-			memset(errmsg, 100, '\0');
-			sprintf(errmsg, "%s:%d: Can not append bytes", __FILE__, __LINE__ - 3);
-			handle_err(err, SYS, errmsg);
-			free_bytes(&tmp_bytes);
-			free_bytes(&buf_bytes);
+			pos += c->lenflds;
+			break;
+		default:
+			break;
+	}
+	memcpy(pos, fld->bytes, fld->length);
+	return pos + fld->length;
+}
+
+/*!	\func 	int pack_message_buf(const isomsg *m, char *buf, int buf_size, int *buf_len);
+ *		\brief  Pack the content of the ISO message m straight into a caller-owned buffer. \n
+ * 				 The MTI, the bitmap and every field are written in one forward pass, without any heap allocation.
+ * 				 m is not modified, fixed length fields are padded while they are written.
+ * 				 m->plan is used if it is set, otherwise m->def is compiled on the stack.
+ *
+ * 		\param		m is an ::isomsg structure pointer that contains all message elements to be packed
+ * 		\param		buf is the caller's buffer, it may be NULL to only compute the packed length
+ * 		\param		buf_size is the number of bytes available in buf
+ * 		\param		buf_len receives the packed length, which is the required size when buf is too small
+ * 		\return		SUCCEEDED(0) if having no error. \n
+ * 						ERR_SHTBUF if buf is too small, *buf_len holds the required size \n
+ * 						error number if having another error
+ */
+int pack_message_buf(const isomsg *m, char *buf, int buf_size, int *buf_len){
+	isoplan tmp_plan;
+	const isoplan *plan = m->plan;
+	isobitmap bmp;
+	int err;
+
+	*buf_len = 0;
+	if(plan == NULL){
+		err = compile_plan(&tmp_plan, m->def, &m->prop, m->err);
+		if(err != SUCCEEDED)
 			return err;
-		}
-		/* update bitmap */
-		if( i > 64 ) bitmap[0] |= 0x80; /* there are more than 64 data element, set the first bit to 1 */
-		bitmap[(i-1)/8] |= 0x80 >> ((i-1)%8); /* set bit ith of bitmap to 0 */
-		/* free tmp_bytes */
-		free_bytes(&tmp_bytes);
+		plan = &tmp_plan;
 	}
+	message_bitmap(m, &bmp);
+	return pack_fields(plan, &bmp, m->fld, buf, buf_size, buf_len, m->err);
+}
 
-	/* convert bitmap to the specified format (BIN, HEX) */
-	empty_bytes(&bin_bytes);
-	empty_bytes(&hexa_bytes);
-	err= import_data(&bin_bytes, bitmap, ( i > 64 )?8:16);
-	if(err != SUCCEEDED){
-		memset(errmsg, 100, '\0');
-		sprintf(errmsg, "%s:%d: Can not import data", __FILE__, __LINE__ - 3);
-		handle_err(err, SYS, errmsg);
-		free_bytes(&buf_bytes);
+/*!	\func 	static int pack_into(const isoplan *plan, const isobitmap *bmp, const bytes *fld, char *buf, int buf_size, int *buf_len, isoerr *e)
+ *		\brief  The packer of ::pack_fields, the errors are recorded into e
+ */
+static int pack_into(const isoplan *plan, const isobitmap *bmp, const bytes *fld, char *buf, int buf_size, int *buf_len, isoerr *e){
+	isobitmap present = *bmp;
+	isofldit it;
+	unsigned char bitmap[16];
+	int err = 0, i, len, total, bmp_len;
+	char *pos;
+
+	*buf_len = 0;
+	/* the MTI field is mandatory */
+	if(verify_bytes((bytes*) &fld[0]) != HASDATA)
+		return fail_isoerr(e, ERR_IVLFLD, 0, 0, plan->fld[0].max_len, 0, plan->fld[0].format);
+	err = check_field(&plan->fld[0], &fld[0], 0, 0, &total, e);
+	if(err != SUCCEEDED)
 		return err;
+	present.w[0] = (present.w[0] & ~(uint64_t) 1) | (present.w[1] != 0);
+	bmp_len = bitmap_test(&present, 1)? 16 : 8;
+	total += (plan->prop.bmp_flag == BMP_HEXA)? 2*bmp_len : bmp_len;
+
+	/* verify the present fields and size the packed message */
+	fldit_init(&it, &present);
+	while((i = fldit_next(&it)) != 0){
+		err = check_field(&plan->fld[i], &fld[i], i, total, &len, e);
+		if(err != SUCCEEDED)
+			return err;
+		total += len;
 	}
-	err = bytes2hexachars(&bin_bytes, &hexa_bytes);
-	if(err != SUCCEEDED){
-		memset(errmsg, 100, '\0');
-		sprintf(errmsg, "%s:%d: Can not convert data from binary format to hexadecimal format", __FILE__, __LINE__ - 3);
-		handle_err(err, SYS, errmsg);
-		free_bytes(&buf_bytes);
-		return err;
+
+	*buf_len = total;
+	if(buf == NULL || buf_size < total)
+		return fail_isoerr(e, ERR_SHTBUF, -1, -1, total, (buf == NULL)? 0 : buf_size, -1);
+
+	/* write the MTI, the bitmap and the fields */
+	pos = write_field(&plan->fld[0], &fld[0], buf);
+	bitmap_to_bytes(&present, bitmap, bmp_len);
+	if(plan->prop.bmp_flag == BMP_HEXA){
+		hexa_encode((const char*) bitmap, bmp_len, pos);
+		pos += 2*bmp_len;
+	}else{
+		memcpy(pos, bitmap, bmp_len);
+		pos += bmp_len;
 	}
-	/* Insert bitmap to buf_bytes */
-	err = insert_bytes(&buf_bytes, &hexa_bytes, 4);
-	if(err != SUCCEEDED){
-		memset(errmsg, 100, '\0');
-		sprintf(errmsg, "%s:%d: Can not insert bytes", __FILE__, __LINE__ - 3);
-		handle_err(err, SYS, errmsg);
-		free_bytes(&buf_bytes);
-		return err;
+	fldit_init(&it, &present);
+	while((i = fldit_next(&it)) != 0)
+		pos = write_field(&plan->fld[i], &fld[i], pos);
+	return SUCCEEDED;
+}
+
+/*!	\func 	int pack_fields(const isoplan *plan, const isobitmap *bmp, const bytes *fld, char *buf, int buf_size, int *buf_len, isoerr *err);
+ *		\brief  Pack an MTI and the fields of a bitmap into a caller-owned buffer. \n
+ * 				 This is the packer behind ::pack_message_buf, for callers that hold their fields in another layout.
+ * 				 Only fld[0] and the entries of the fields present in bmp are read.
+ *
+ * 		\param		plan is an ::isoplan compiled by ::compile_plan
+ * 		\param		bmp is the bitmap of the fields 2..128 to pack, field 1 is derived from it
+ * 		\param		fld is an array of 129 fields indexed by field number
+ * 		\param		buf is the caller's buffer, it may be NULL to only compute the packed length
+ * 		\param		buf_size is the number of bytes available in buf
+ * 		\param		buf_len receives the packed length, which is the required size when buf is too small
+ * 		\param		err is the error context that receives the error, NULL to log the error
+ * 		\return		SUCCEEDED(0) if having no error. \n
+ * 						ERR_SHTBUF if buf is too small, *buf_len holds the required size, it is never logged \n
+ * 						error number if having another error
+ */
+int pack_fields(const isoplan *plan, const isobitmap *bmp, const bytes *fld, char *buf, int buf_size, int *buf_len, isoerr *err){
+	isoerr local, *e = (err != NULL)? err : &local;
+	int ret;
+
+	e->code = SUCCEEDED;
+	ret = pack_into(plan, bmp, fld, buf, buf_size, buf_len, e);
+	return (ret == ERR_SHTBUF)? ret : report_isoerr(err, e, ret);
+}
+
+/*!	\func	void init_view(isoview *v, const isodef *def, const msgprop *prop);
+ * 		\brief	Initialize an ISO message view - i.e. no field is present
+ * 		\param	v is an ::isoview pointer that will be initialized
+ * 		\param	def is an ::isodef pointer that will be set as the iso definition of v
+ * 		\param	prop is a ::msgprop pointer whose value will be set as the properties of v
+ */
+void init_view(isoview *v, const isodef *def, const msgprop *prop){
+	v->def = def;
+	v->plan = NULL;
+	v->prop.alphanumeric_pad = prop->alphanumeric_pad;
+	v->prop.numeric_pad = prop->numeric_pad;
+	if(prop->bmp_flag != BMP_BINARY && prop->bmp_flag != BMP_HEXA)
+		v->prop.bmp_flag = BMP_BINARY;
+	else
+		v->prop.bmp_flag = prop->bmp_flag;
+	v->buf = NULL;
+	v->buf_len = 0;
+	v->msg_len = 0;
+	v->located = 0;
+	v->scan_pos = 0;
+	v->err = NULL;
+	bitmap_clear(&v->bitmap);
+	memset(v->fld, '\0', sizeof(v->fld));
+}
+
+/*!	\func	void init_view_plan(isoview *v, const isoplan *plan);
+ * 		\brief	Initialize an ISO message view that is unpacked with a compiled plan
+ * 		\param	v is an ::isoview pointer that will be initialized
+ * 		\param	plan is an ::isoplan compiled by ::compile_plan, it must outlive v. \n
+ * 					The definition and the properties of v are taken from it.
+ */
+void init_view_plan(isoview *v, const isoplan *plan){
+	init_view(v, plan->def, &plan->prop);
+	v->plan = plan;
+}
+
+/*!	\func	void set_view_errctx(isoview *v, isoerr *err);
+ * 		\brief	Make the failing calls on a view fill an error context instead of logging the error. \n
+ * 					A rejected message then costs no formatting and no write to the log file.
+ * 		\param	v is an ::isoview initialized by ::init_view
+ * 		\param	err is the ::isoerr that receives the errors, NULL to log them again
+ */
+void set_view_errctx(isoview *v, isoerr *err){
+	v->err = err;
+}
+
+/*!	\func	static int open_at(isoview *v, const char *buf, int buf_len, isoerr *e);
+ * 		\brief 	The opening of ::open_view, the errors are recorded into e
+ */
+static int open_at(isoview *v, const char *buf, int buf_len, isoerr *e){
+	isocodec mti;
+	unsigned char bitmap[16];
+	int pos, len, bmp_len;
+
+	v->buf = NULL;
+	v->buf_len = 0;
+	v->msg_len = 0;
+	v->located = 0;
+	v->scan_pos = 0;
+	bitmap_clear(&v->bitmap);
+	memset(v->fld, '\0', sizeof(v->fld));
+
+	/* Field 0 is mandatory and fixed length. */
+	if(v->plan != NULL){
+		mti = v->plan->fld[0];
+	}else{
+		if(v->def[0].lenflds != 0 || v->def[0].flds <= 0)
+			return fail_isoerr(e, ERR_IVLLEN, 0, -1, -1, -1, v->def[0].format);
+		mti.max_len = (unsigned short) v->def[0].flds;
+		mti.format = (unsigned char) v->def[0].format;
 	}
+	if(mti.max_len > buf_len)
+		return fail_isoerr(e, ERR_SHTBUF, 0, 0, mti.max_len, buf_len, mti.format);
+	v->fld[0].offset = 0;
+	v->fld[0].length = mti.max_len;
+	pos = mti.max_len;
 
-	/* copy the iso message to *buf, and its length to buf_len */
-	err = export_data(&buf_bytes, *buf, buf_len);
-	if(err != SUCCEEDED){
-		memset(errmsg, 100, '\0');
-		sprintf(errmsg, "%s:%d: Can not export bytes", __FILE__, __LINE__ - 3);
-		handle_err(err, SYS, errmsg);
-		free_bytes(&buf_bytes);
-		return err;
+	/*
+	 * First bit in the bitmap (field 1) defines if the message is
+	 * extended or not, i.e. if a secondary bitmap follows the primary one.
+	 */
+	len = (v->prop.bmp_flag == BMP_HEXA)? 16 : 8;
+	for(bmp_len = 0; bmp_len < 16; bmp_len += 8){
+		if(pos + len > buf_len)
+			return fail_isoerr(e, ERR_SHTBUF, 1, pos, len, buf_len - pos, ISO_BITMAP);
+		if(v->prop.bmp_flag == BMP_HEXA){
+			if(hexa_decode_strict(buf + pos, len, (char*) bitmap + bmp_len) != SUCCEEDED)
+				return fail_isoerr(e, ERR_HEXBYT, 1, pos, -1, -1, ISO_BITMAP);
+		}else{
+			memcpy(bitmap + bmp_len, buf + pos, len);
+		}
+		pos += len;
+		v->fld[1].length += len;
+		if(!(bitmap[0] & 0x80)){
+			bmp_len += 8;
+			break;
+		}
+	}
+	v->fld[1].offset = pos - v->fld[1].length;
+	bitmap_from_bytes(&v->bitmap, bitmap, bmp_len);
+	v->buf = buf;
+	v->buf_len = buf_len;
+	v->located = 1;
+	v->scan_pos = pos;
+	return SUCCEEDED;
+}
+
+/*!	\func	int open_view(isoview *v, const char *buf, int buf_len);
+ * 		\brief 	Open the packed message in buf as the view v. \n
+ * 					Only the MTI and the bitmap are decoded, so the present fields are known but not located yet.
+ * 					The fields are located in one pass, which ::view_field runs as far as the field it is asked for,
+ * 					and ::index_view runs to the end.
+ * 					buf must outlive v.
+ * 		\param 	v is an ::isoview initialized by ::init_view
+ * 		\param	buf is the iso message buffer that contains the iso message that needs unpacking.
+ * 		\param	buf_len is the length of the iso message buffer
+ * 		\returns	0 in case successful opening \n
+ * 					error number in case an error occured
+ */
+int open_view(isoview *v, const char *buf, int buf_len){
+	isoerr local, *e = (v->err != NULL)? v->err : &local;
+
+	e->code = SUCCEEDED;
+	return report_isoerr(v->err, e, open_at(v, buf, buf_len, e));
+}
+
+/*!	\func	static int scan_fields(isoview *v, int last, isoerr *e);
+ * 		\brief 	Locate the present fields of an opened view up to field last. \n
+ * 					The scan resumes after the fields that are already located, only the length of each
+ * 					field is read, nothing is validated or copied.
+ * 		\returns	0 in case successful locating \n
+ * 					error number in case an error occured, it is recorded into e
+ */
+static int scan_fields(isoview *v, int last, isoerr *e){
+	isoplan tmp_plan;
+	const isoplan *plan = v->plan;
+	const isocodec *c;
+	const char *buf = v->buf;
+	isobitmap rest;
+	isofldit it;
+	int i, k, pos, len, err;
+
+	if(buf == NULL)
+		return fail_isoerr(e, ERR_IVLFLD, last, -1, -1, -1, -1);
+	if(last <= v->located)
+		return SUCCEEDED;
+	if(plan == NULL){
+		err = compile_plan(&tmp_plan, v->def, &v->prop, e);
+		if(err != SUCCEEDED)
+			return err;
+		plan = &tmp_plan;
 	}
 
+	/* only the present fields that are not located yet, up to last */
+	rest = v->bitmap;
+	bitmap_keep_range(&rest, v->located + 1, last);
+	pos = v->scan_pos;
+	fldit_init(&it, &rest);
+	while((i = fldit_next(&it)) != 0){
+		c = &plan->fld[i];
+		if(c->kind == CODEC_LLVAR){
+			/* Variable length, read the LL/LLL header */
+			if(pos + c->lenflds > v->buf_len)
+				return fail_isoerr(e, ERR_SHTBUF, i, pos, c->lenflds, v->buf_len - pos, c->format);
+			for(len = 0, k = 0; k < c->lenflds; k++){
+				if(buf[pos+k] < '0' || buf[pos+k] > '9')
+					return fail_isoerr(e, ERR_IVLLEN, i, pos, -1, -1, c->format);
+				len = len*10 + buf[pos+k] - '0';
+			}
+			/* The length of a field can't be larger than defined by def[i].flds. */
+			if(len > c->max_len)
+				return fail_isoerr(e, ERR_OVRLEN, i, pos, c->max_len, len, c->format);
+			pos += c->lenflds;
+		}else{
+			len = c->max_len;
+		}
+		/* Handle the buffer too short error */
+		if(pos + len > v->buf_len)
+			return fail_isoerr(e, ERR_SHTBUF, i, pos, len, v->buf_len - pos, c->format);
+		v->fld[i].offset = pos;
+		v->fld[i].length = len;
+		pos += len;
+		/* the progress is kept, an error on a later field leaves the located ones usable */
+		v->located = i;
+		v->scan_pos = pos;
+	}
+	v->located = last;
+	if(last == 128)
+		v->msg_len = pos;
 	return SUCCEEDED;
- }
+}
+
+/*!	\func	static int locate_fields(isoview *v, int last);
+ * 		\brief 	Locate the present fields of an opened view up to field last, see ::scan_fields. \n
+ * 					The error is recorded into the error context of the view, or logged if it has none.
+ */
+static int locate_fields(isoview *v, int last){
+	isoerr local, *e = (v->err != NULL)? v->err : &local;
+
+	e->code = SUCCEEDED;
+	return report_isoerr(v->err, e, scan_fields(v, last, e));
+}
+
+/*!	\func	int index_view(isoview *v);
+ * 		\brief 	Locate every present field of a view opened by ::open_view, in one pass over the packed buffer. \n
+ * 					Each field is recorded as an (offset, length) pair into the buffer, nothing is allocated or copied.
+ * 					Only the fields that are not located yet are scanned.
+ * 		\param 	v is an ::isoview opened by ::open_view
+ * 		\returns	0 in case successful indexing, v->msg_len holds the number of bytes used \n
+ * 					error number in case an error occured
+ */
+int index_view(isoview *v){
+	return locate_fields(v, 128);
+}
+
+/*!	\func	int unpack_view(isoview *v, const char *buf, int buf_len);
+ * 		\brief 	Unpack the content of buf into the view v, that is ::open_view then ::index_view. \n
+ * 					buf must outlive v.
+ * 		\param 	v is an ::isoview initialized by ::init_view
+ * 		\param	buf is the iso message buffer that contains the iso message that needs unpacking.
+ * 		\param	buf_len is the length of the iso message buffer
+ * 		\returns	0 in case successful unpacking, v->msg_len holds the number of bytes used \n
+ * 					error number in case an error occured
+ */
+int unpack_view(isoview *v, const char *buf, int buf_len){
+	int err = open_view(v, buf, buf_len);
+	if(err != SUCCEEDED)
+		return err;
+	return index_view(v);
+}
+
+/*!	\func	int unpack_selected(isoview *v, const char *buf, int buf_len, const isobitmap *want);
+ * 		\brief 	Unpack the content of buf into the view v, stopping after the highest field of want. \n
+ * 					The fields before it that are not wanted are skipped over by their length.
+ * 					The fields after it are not parsed, ::view_field still locates them if they are asked for.
+ * 					buf must outlive v.
+ * 		\param 	v is an ::isoview initialized by ::init_view
+ * 		\param	buf is the iso message buffer that contains the iso message that needs unpacking.
+ * 		\param	buf_len is the length of the iso message buffer
+ * 		\param	want is the mask of the fields the caller needs
+ * 		\returns	0 in case successful unpacking \n
+ * 					error number in case an error occured
+ */
+int unpack_selected(isoview *v, const char *buf, int buf_len, const isobitmap *want){
+	isobitmap last;
+	int err = open_view(v, buf, buf_len);
+	if(err != SUCCEEDED)
+		return err;
+	last = v->bitmap;
+	bitmap_and(&last, want);
+	return locate_fields(v, bitmap_last(&last));
+}
 
-//int pack_message(const isomsg *m, char *buf, int *buf_len)
-//{
-//	char *start = buf;
-//	int flds;
-//	int i, sys_err_code;
-//	char *bitmap;
-//	int len;
-//	char tmp[20];
-//	bytes byte_tmp, hexa_tmp;
-//	int flderr[129];
-//
-//	if(verify_bytes(&m->fld[0])){
-//		handle_err(ERR_IVLFMT, ISO, "Field 0 --> This field does not exist");
-//		return ERR_IVLFMT;
-//	}
-//
-//	if (m->fld[0].length != d[0].flds || d[0].lenflds != 0) {
-//		/* FIXME: error */
-//		/*This error is the length of field is not correct*/
-//		handle_err(ERR_IVLLEN, ISO, "Field 0 --> Length is not the same as its iso8583 definition length");
-//		return ERR_IVLLEN;
-//	}
-//	memcpy(buf, m->fld[0], d[0].flds);
-//	buf += d[0].flds;
-//
-//	/*
-//	 * The bitmap contains either 64 or 128 fields - flds is the
-//	 * number of allowed fields, i.e. either 64 or 128.
-//	 */
-//	flds = 64;
-//	for (i = 65; i <= 128; i++) {
-//		if (m->fld[i] != NULL) {
-//			flds = 128;
-//			break;
-//		}
-//	}
-//
-//	bitmap = (char *) calloc(flds/8 + 1, sizeof(char));
-//	if (!bitmap)
-//	{
-//		char err_msg[100];
-//		sprintf("%s:%d --> Can't allocate memory for the bitmap buffer", __FILE__, __LINE__);
-//		handle_err(ERR_OUTMEM, SYS, err_msg);
-//		return ERR_OUTMEM;
-//	}
-//	/*
-//	 * First bit in the bitmap (field 1) defines if the message is
-//	 * extended or not.
-//	 * 0: not exteded - i.e. only (some of) the fields 0 to 64 are
-//	 *    used
-//	 * 1: extended - i.e. (some of) the fields 0 to 128 are used
-//	 * I.e. if one or more of the fields 65 to 128 is used, the
-//	 * bit is 1.
-//	 */
-//	if (flds == 128) {
-//		bitmap[0] |= 0x80;
-//	}
-//
-//	/*
-//	 * The bits 2 to 64/128 defines if the corresponding field is
-//	 * present (1) or not (0).
-//	 */
-//	for (i = 2; i <= flds; i++) {
-//		if (m->fld[i] != NULL) {
-//			/* Set the i'th bit to 1 */
-//			bitmap[(i-1)/8] |= 0x80 >> ((i-1)%8);
-//		}
-//	}
-//
-//	if(m->bmp_flag == BMP_BINARY){
-//		memcpy(buf, bitmap, flds/8);
-//		buf += flds/8;
-//	}else{
-//		byte_tmp.length = flds;
-//		byte_tmp.bytes = (char*) calloc(byte_tmp.length, sizeof(char));
-//		if(!byte_tmp.bytes){
-//			char err_msg[100];
-//			sprintf("%s:%d --> Can't allocate memory", __FILE__, __LINE__);
-//			handle_err(ERR_OUTMEM, SYS, err_msg);
-//			free(bitmap);
-//			return ERR_OUTMEM;
-//		}
-//		memcpy(byte_tmp.bytes, bitmap, byte_tmp.length/8);
-//		if( bytes2hexachars(&byte_tmp, &hexa_tmp) < 0){
-//			char err_msg[100];
-//			sprintf("%s:%d --> Can't convert bytes to a hexacharacter array", __FILE__, __LINE__);
-//			handle_err(ERR_BYTHEX, SYS, err_msg);
-//			free(bitmap);
-//			free(byte_tmp.bytes);
-//			return ERR_BYTHEX;
-//		};
-//		memcpy(buf, hexa_tmp.bytes, hexa_tmp.length);
-//		buf += hexa_tmp.length;
-//		free(byte_tmp.bytes);
-//		free(hexa_tmp.bytes);
-//	}
-//
-//	for (i = 2; i <= flds; i++) {
-//		if ((bitmap[(i-1)/8] << ((i-1)%8)) & 0x80) { /* i'th bit != 0 */
-//			if (d[i].lenflds) { /* Variable length */
-//				switch (d[i].format) {
-//				case ISO_NUMERIC: /* Fallthrough */
-//				case ISO_ALPHANUMERIC:
-//					len = strlen(m->fld[i]);
-//					sprintf(tmp, "%%0%dd", d[i].lenflds);
-//					sprintf(buf, tmp, len);
-//					if (len > d[i].flds) {
-//						/*The length of this field is too long*/
-//						char err_msg[100];
-//						sprintf(err_msg, "Field %d --> The length of this field is too long", i);
-//						handle_err(ERR_OVRLEN, ISO, err_msg);
-//						return ERR_OVRLEN;
-//					}
-//					buf += d[i].lenflds;
-//					break;
-//				case ISO_BINARY:
-//					sprintf(tmp, "%%0%dd", d[i].lenflds);
-//					sscanf(m->fld[i], tmp, &len);
-//					if (len > d[i].flds) {
-//						char err_msg[100];
-//						sprintf(err_msg, "Field %d --> The length of this field is too long", i);
-//						handle_err(ERR_OVRLEN, ISO, err_msg);
-//						return ERR_OVRLEN;
-//					}
-//					/* Copy length bytes from m->fld[i] */
-//					len += d[i].lenflds;
-//					break;
-//				default:{
-//						/* FIXME: error */
-//						/*The format error of this field*/
-//						/*Format out of range*/
-//						char err_msg[100];
-//						sprintf(err_msg, "Field %d --> Format out of range", i);
-//						handle_err(ERR_OUTRAG, ISO, err_msg);
-//						return ERR_OUTRAG;
-//					}
-//					break;
-//				}
-//			} else { /* Fixed length */
-//				len = d[i].flds;
-//
-//				/* FIXME: How can we check ISO_BINARY? */
-//				if (d[i].format != ISO_BINARY &&
-//				    strlen(m->fld[i]) != len) {
-//					/* FIXME: error */
-//					/*The lengthe is not correct*/
-//					char err_msg[100];
-//					sprintf(err_msg, "Field %d --> The length is not correct", i);
-//					handle_err(ERR_IVLLEN, ISO, err_msg);
-//					return ERR_IVLLEN;
-//				}
-//			}
-//
-//			memcpy(buf, m->fld[i], len);
-//
-//			buf += len;
-//                }
-//	}
-//	*buf_len = buf-start;
-//	return 0;
-//}
+/*!	\func	int view_field(isoview *v, int idx, const char **fld, int *fld_len);
+ * 		\brief	Get the location of a field of an opened view, the data is not copied. \n
+ * 					The MTI and the bitmap are always available. Accessing a field that is not located yet
+ * 					resumes the scan of the view up to it, the located fields take constant time.
+ * 		\param	v is an ::isoview opened by ::open_view or unpacked by ::unpack_view
+ * 		\param	idx is index of the field to be retrieved
+ * 		\param	fld receives a pointer to the field data inside the packed buffer
+ * 		\param	fld_len receives the length of the field data, which may be 0 for a variable length field
+ * 		\return	SUCCEEDED if the field is present \n
+ * 					ERR_IVLFLD if idx is out of range or the field is not present \n
+ * 					the error of ::index_view if the fields can't be located
+ */
+int view_field(isoview *v, int idx, const char **fld, int *fld_len){
+	int err;
+	if(idx < 0 || idx > 128 || v->buf == NULL)
+		return ERR_IVLFLD;
+	if(idx > 1){
+		if(!bitmap_test(&v->bitmap, idx))
+			return ERR_IVLFLD;
+		if(idx > v->located && (err = locate_fields(v, idx)) != SUCCEEDED)
+			return err;
+	}
+	*fld = v->buf + v->fld[idx].offset;
+	*fld_len = v->fld[idx].length;
+	return SUCCEEDED;
+}
 
+/*!	\func	int copy_field(isoview *v, int idx, bytes *fld);
+ * 		\brief	Copy a field of an opened view into a bytes struct that owns its data
+ * 		\param	v is an ::isoview opened by ::open_view or unpacked by ::unpack_view
+ * 		\param	idx is index of the field to be copied
+ * 		\param	fld is an empty bytes struct that receives the copy, it must be freed by ::free_bytes
+ * 		\return	SUCCEEDED if the field is copied \n
+ * 					error number if having an error
+ */
+int copy_field(isoview *v, int idx, bytes *fld){
+	const char *data;
+	int len, err;
+	err = view_field(v, idx, &data, &len);
+	if(err != SUCCEEDED)
+		return err;
+	return import_data(fld, data, len);
+}
 
 /*!	\func	int unpack_message(isomsg *m, const char *buf, int buf_len);
- * 		\brief 	Unpack the content of buf into the ISO message struct m.
- * 		\param 	m is an ::isomsg structure pointer that contains all message elements which are unpacked
+ * 		\brief 	Unpack the content of buf into the ISO message struct m. \n
+ * 					The message is unpacked by ::unpack_view, then each present field is copied into m.
+ * 					Use ::unpack_view directly when the fields don't need to outlive buf.
+ * 		\param 	m is an ::isomsg structure pointer initialized by ::init_message, its previous content is freed
+ * 		\param	buf is the iso message buffer that contains the iso message that needs unpacking.
+ * 		\param	buf_len is the length of the iso message buffer
+ * 		\returns	0 in case successful unpacking \n
+ * 					error number in case an error occured
+ */
+int unpack_message(isomsg *m, const char *buf, int buf_len){
+	return unpack_message_selected(m, buf, buf_len, NULL);
+}
+
+/*!	\func	int unpack_message_selected(isomsg *m, const char *buf, int buf_len, const isobitmap *want);
+ * 		\brief 	Unpack the MTI, the bitmap and the fields of want from buf into the ISO message struct m. \n
+ * 					The message is unpacked by ::unpack_selected, the fields after the highest one of want
+ * 					are neither parsed nor checked, the other fields before it are skipped over.
+ * 		\param 	m is an ::isomsg structure pointer initialized by ::init_message, its previous content is freed
  * 		\param	buf is the iso message buffer that contains the iso message that needs unpacking.
  * 		\param	buf_len is the length of the iso message buffer
+ * 		\param	want is the mask of the fields to unpack, NULL to unpack every field
  * 		\returns	0 in case successful unpacking \n
  * 					error number in case an error occured
  */
-//int unpack_message(isomsg *m, const char *buf, int buf_len)
-//{
-//	int flds;
-//	int i;
-//	int len;
-//    char tmp[20];
-//    Bytes byte_tmp, hexa_tmp;
-//    const char* buf_start = buf;
-//
-//	/* Field 0 is mandatory and fixed length. */
-//	if (d[0].lenflds != 0) {
-//		/*The length define is not correct*/
-//		handle_err(ERR_IVLLEN, ISO, "Definition 0 --> The length define is not correct");
-//		return ERR_IVLLEN;
-//	}
-//
-//	if(d[0].flds > buf_len){
-//		char err_msg[100];
-//		sprintf(err_msg, "The ISO message buffer's length(%d) is shorter than the length definition of field 0 (%d) ", buf_len, d[0].lenflds);
-//		handle_err(ERR_SHTBUF, ISO, err_msg);
-//		return ERR_SHTBUF;
-//	}
-//
-//	m->fld[0] = (char *) malloc((d[0].flds + 1) * sizeof(char));
-//	if(!m->fld[0])
-//	{
-//		char err_msg[100];
-//		sprintf(err_msg, "%s:%d --> Can't allocate memory for field 0", __FILE__, __LINE__);
-//		handle_err(ERR_OUTMEM, SYS, err_msg);
-//		return ERR_OUTMEM;
-//	}
-//	memcpy(m->fld[0], buf, d[0].flds);
-//	m->fld[0][d[0].flds] = 0;
-//	buf += d[0].flds;
-//
-//	/*
-//	 * First bit in the bitmap (field 1) defines if the message is
-//	 * extended or not.
-//	 * 0: not exteded - i.e. only (some of) the fields 0 to 64 are
-//	 *    used
-//	 * 1: extended - i.e. (some of) the fields 0 to 128 are used
-//	 * I.e. if one or more of the fields 65 to 128 is used, the
-//	 * bit is 1.
-//	 */
-//	if(m->bmp_flag == BMP_BINARY){
-//		if(buf[0] & 0x80) {
-//			flds = 128;
-//		} else {
-//			flds = 64;
-//		}
-//		m->fld[1] = (char *) calloc(flds/8 + 1, sizeof(char));
-//		if (!m->fld[1]){
-//			char err_msg[100];
-//			sprintf(err_msg, "%s:%d --> Can't allocate memory for field 1", __FILE__, __LINE__);
-//			handle_err(ERR_OUTMEM, SYS, err_msg);
-//			return ERR_OUTMEM;
-//		}
-//		if( (buf - buf_start + flds/8) > buf_len){
-//			memcpy(m->fld[1], buf, flds/8);
-//			buf += flds/8;
-//		}else{
-//			char err_msg[100];
-//			sprintf(err_msg, "The ISO message buffer's length(%d) is too short, stoped at field 1", buf_len);
-//			handle_err(ERR_SHTBUF, ISO, err_msg);
-//			return ERR_SHTBUF;
-//		}
-//	}else{
-//		if(hexachar2int(buf[0]) & 0x08){
-//			flds = 128;
-//		} else {
-//			flds = 64;
-//		}
-//		/* Handle buffer too short error	*/
-//		if((buf - buf_start + flds/4) > buf_len){
-//			char err_msg[100];
-//			sprintf(err_msg, "The ISO message buffer's length(%d) is too short, stoped at field 1", buf_len);
-//			handle_err(ERR_SHTBUF, ISO, err_msg);
-//			return ERR_SHTBUF;
-//		}
-//		hexa_tmp.length = flds/4;
-//		hexa_tmp.bytes = (char *) calloc(hexa_tmp.length, sizeof(char));
-//		memcpy(hexa_tmp.bytes, buf, flds/4);
-//		if( hexachars2bytes(&hexa_tmp, &byte_tmp) < 0){
-//			handle_err(ERR_HEXBYT, SYS, "Can't convert the bitmap hexachar array to binary");
-//			free(hexa_tmp.bytes);
-//			free(m->fld[0]);
-//			return ERR_OUTMEM;
-//		}
-//
-//		m->fld[1] = (char*) calloc(byte_tmp.length/8 + 1, sizeof(char));
-//		if (!m->fld[1])
-//		{
-//			char err_msg[100];
-//			sprintf(err_msg, "%s:%d --> Can't allocate memory for field 1", __FILE__, __LINE__);
-//			handle_err(ERR_OUTMEM, SYS, err_msg);
-//			free(m->fld[0]);
-//			free(hexa_tmp.bytes);
-//			free(byte_tmp.bytes);
-//			return ERR_OUTMEM;
-//		}
-//		memcpy(m->fld[1], byte_tmp.bytes, byte_tmp.length/8);
-//		buf += flds/4;
-//		free(hexa_tmp.bytes);
-//		free(byte_tmp.bytes);
-//	}
-//
-//	for (i = 2; i <= flds; i++) {
-//		if ((m->fld[1][(i-1)/8] << ((i-1)%8)) & 0x80) { /* i'th bit != 0 */
-//			if (d[i].lenflds) { /* Variable length */
-//				sprintf(tmp, "%%0%dd", d[i].lenflds);
-//				sscanf(buf, tmp, &len);
-//				/*
-//				 * The length of a field can't be
-//				 * larger than defined by d[i].flds.
-//				 */
-//				if (len > d[i].flds) {
-//					/* FIXME: warning/error */
-//					/*The length of this field is too long*/
-//					char err_msg[100];
-//					sprintf(err_msg, "Field %d --> The length of this field is too long", i);
-//					handle_err(ERR_OVRLEN, ISO, err_msg);
-//					return ERR_OVRLEN;
-//				}
-//			} else { /* Fixed length */
-//				len = d[i].flds;
-//			}
-//
-//			/* Handle the buffer too short error */
-//			if(buf - buf_start + len + d[i].lenflds > buf_len){
-//				char err_msg[100];
-//				sprintf(err_msg, "The ISO message buffer's length(%d) is too short, stoped at field %d", buf_len, i);
-//				handle_err(ERR_SHTBUF, ISO, err_msg);
-//				return ERR_SHTBUF;
-//			}
-//
-//			switch (d[i].format) {
-//			case ISO_NUMERIC: /* Fallthrough */
-//			case ISO_ALPHANUMERIC:
-//				/* Don't copy lenght bytes */
-//				buf += d[i].lenflds;
-//				break;
-//			case ISO_BINARY:
-//				/* Copy length bytes */
-//				len += d[i].lenflds;
-//				break;
-//			default:{
-//					/* FIXME: error */
-//					/*The format of this field is not defined*/
-//					char err_msg[100];
-//					sprintf(err_msg, "Field %d --> The format of this field is not defined", i);
-//					handle_err(ERR_IVLFMT, ISO, err_msg);
-//					return ERR_IVLFMT;
-//					break;
-//				}
-//			}
-//			m->fld[i] = (char *) malloc((len + 1) * sizeof(char));
-//			if (!m->fld[i])
-//			{
-//				char err_msg[100];
-//				sprintf(err_msg, "%s:%d --> Can't allocate memory for field %d", __FILE__, __LINE__, i);
-//				handle_err(ERR_OUTMEM, SYS, err_msg);
-//				return ERR_OUTMEM;
-//			}
-//			memcpy(m->fld[i], buf, len);
-//			m->fld[i][len] = 0;
-//			buf += len;
-//		}
-//	}
-//	return 0;
-//}
+int unpack_message_selected(isomsg *m, const char *buf, int buf_len, const isobitmap *want){
+	isoview v;
+	isobitmap copied;
+	isofldit it;
+	isoerr local, *e = (m->err != NULL)? m->err : &local;
+	int i, err;
+
+	free_message(m);
+	init_view(&v, m->def, &m->prop);
+	v.plan = m->plan;
+	v.err = m->err;
+	if(want == NULL)
+		err = unpack_view(&v, buf, buf_len);
+	else
+		err = unpack_selected(&v, buf, buf_len, want);
+	if(err != SUCCEEDED)
+		return err;
+	copied = v.bitmap;
+	if(want != NULL)
+		bitmap_and(&copied, want);
+	/* the MTI and the bitmap, then the present fields */
+	fldit_init(&it, &copied);
+	i = 0;
+	do{
+		/* an empty variable length field can't be held by a bytes struct */
+		if(v.fld[i].length == 0)
+			continue;
+		if(m->arena != NULL)
+			err = import_data_arena(m->arena, &m->fld[i], v.buf + v.fld[i].offset, v.fld[i].length);
+		else
+			err = copy_field(&v, i, &m->fld[i]);
+		if(err != SUCCEEDED){
+			free_message(m);
+			return report_isoerr(m->err, e, fail_isoerr(e, err, i, v.fld[i].offset, -1, v.fld[i].length, -1));
+		}
+	}while((i = (i == 0)? 1 : fldit_next(&it)) != 0);
+	return SUCCEEDED;
+}
 
+/*!	\func	static int write_json_fields(isowriter *w, const isodef *def, const isobitmap *bmp, bytes *fld, int fmt_flag)
+ * 		\brief 	Write the MTI and the present fields as a json object, {"mti":"...","fields":{"2":"...",...}}. \n
+ * 					The binary fields are hexa or base64 encoded as fmt_flag tells, the others are escaped.
+ * 		\return	SUCCEEDED if having no error \n
+ * 					the error of the writer
+ */
+static int write_json_fields(isowriter *w, const isodef *def, const isobitmap *bmp, bytes *fld, int fmt_flag)
+{
+	int i, first = 1;
+	isofldit it;
+
+	writer_char(w, '{');
+	if(verify_bytes(&fld[0]) == HASDATA){
+		writer_string(w, "\"" JSON_MTI_KEY "\":\"");
+		writer_json(w, fld[0].bytes, fld[0].length);
+		writer_string(w, "\",");
+	}
+	writer_string(w, "\"" JSON_FIELDS_KEY "\":{");
+	fldit_init(&it, bmp);
+	while((i = fldit_next(&it)) != 0){
+		if (verify_bytes(&fld[i]) != HASDATA || def[i].format < ISO_NUMERIC || def[i].format > ISO_ALPHANUMERIC_SPC)
+			continue;
+		writer_string(w, first? "\"" : ",\"");
+		first = 0;
+		writer_int(w, i);
+		writer_string(w, "\":\"");
+		if(def[i].format != ISO_BINARY)
+			writer_json(w, fld[i].bytes, fld[i].length);
+		else if(fmt_flag == FMT_JSON_BASE64)
+			writer_base64(w, fld[i].bytes, fld[i].length);
+		else
+			writer_hexa(w, fld[i].bytes, fld[i].length);
+		writer_char(w, '"');
+	}
+	writer_string(w, "}}");
+	return w->err;
+}
+
+/*!	\func	static int write_fields(isowriter *w, const isodef *def, const isobitmap *bmp, bytes *fld, int fmt_flag, isoerr *e)
+ * 		\brief 	Write the MTI and the present fields in a text format, the fields without data are skipped
+ * 		\param	e receives the error
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_NODFMT if fmt_flag is not a format \n
+ * 					the error of the writer
+ */
+static int write_fields(isowriter *w, const isodef *def, const isobitmap *bmp, bytes *fld, int fmt_flag, isoerr *e)
+{
+	int i;
+	isofldit it;
+
+	if(fmt_flag == FMT_JSON || fmt_flag == FMT_JSON_BASE64){
+		if(write_json_fields(w, def, bmp, fld, fmt_flag) != SUCCEEDED)
+			return fail_isoerr(e, w->err, -1, -1, -1, -1, -1);
+		return SUCCEEDED;
+	}
+	if(fmt_flag != FMT_PLAIN && fmt_flag != FMT_XML)
+		return fail_isoerr(e, ERR_NODFMT, -1, -1, -1, -1, -1);
+	if(fmt_flag == FMT_PLAIN){
+		writer_string(w, "Field list: ");
+		fldit_init(&it, bmp);
+		i = 0;
+		do{
+			if (verify_bytes(&fld[i]) == HASDATA) {
+				writer_int(w, i);
+				writer_string(w, " \t ");
+			}
+		}while((i = fldit_next(&it)) != 0);
+		writer_string(w, "\n ");
+	}else{
+		writer_string(w, "<?xml\tversion=\"1.0\"?>\n<" XML_ROOT_TAG ">\n");
+	}
+	fldit_init(&it, bmp);
+	i = 0;
+	do{
+		if (verify_bytes(&fld[i]) != HASDATA || def[i].format < ISO_NUMERIC || def[i].format > ISO_ALPHANUMERIC_SPC)
+			continue;
+		if(fmt_flag == FMT_PLAIN){
+			writer_string(w, "field #");
+			writer_int(w, i);
+			writer_string(w, " = ");
+			/* print binary data as a hexa char array */
+			if(def[i].format == ISO_BINARY){
+				writer_hexa(w, fld[i].bytes, fld[i].length);
+				writer_string(w, " (hexa)\n");
+			}else{
+				writer_write(w, fld[i].bytes, fld[i].length);
+				writer_char(w, '\n');
+			}
+		}else{
+			writer_string(w, "\t<" XML_CHILD_TAG "\t" XML_FIELD_INDEX "=\"");
+			writer_int(w, i);
+			writer_string(w, "\"\t" XML_FIELD_VALUE "=\"");
+			if(def[i].format == ISO_BINARY)
+				writer_hexa(w, fld[i].bytes, fld[i].length);
+			else
+				writer_xml(w, fld[i].bytes, fld[i].length);
+			writer_string(w, "\"/>\n");
+		}
+	}while((i = fldit_next(&it)) != 0);
+	if(fmt_flag == FMT_XML)
+		writer_string(w, "</" XML_ROOT_TAG ">");
+	if(w->err != SUCCEEDED)
+		return fail_isoerr(e, w->err, -1, -1, -1, -1, -1);
+	return SUCCEEDED;
+}
+
+/*!	\func	int write_message(isowriter *w, isomsg *m, int fmt_flag);
+ * 		\brief 	Write the content of the ISO message m in a text format. \n
+ * 					The output has no length limit, binary fields are written as hexa characters, or base64
+ * 					ones for FMT_JSON_BASE64, and the values of the xml and json formats are escaped.
+ * 		\param 	w is the ::isowriter that receives the text
+ * 		\param	m is an ::isomsg structure pointer that contains all message elements which needs dumping
+ * 		\param	fmt_flag is FMT_PLAIN, FMT_XML, FMT_JSON or FMT_JSON_BASE64
+ * 		\return	SUCCEEDED if having no error, the error is recorded into the context of m \n
+ * 					ERR_NODFMT if fmt_flag is not a format \n
+ * 					the error of the writer
+ */
+int write_message(isowriter *w, isomsg *m, int fmt_flag)
+{
+	isoerr local, *e = (m->err != NULL)? m->err : &local;
+	isobitmap bmp;
+
+	e->code = SUCCEEDED;
+	/* only the present fields are visited */
+	message_bitmap(m, &bmp);
+	return report_isoerr(m->err, e, write_fields(w, m->def, &bmp, m->fld, fmt_flag, e));
+}
+
+/*!	\func	int write_view(isowriter *w, isoview *v, int fmt_flag);
+ * 		\brief 	Write the content of a packed message in a text format, straight from its buffer. \n
+ * 					The fields are located in one pass, then each one is written from the buffer: binary
+ * 					fields are hexa encoded into the output and nothing is copied or allocated per field.
+ * 					The output is the one of ::write_message for the same message. Nothing is written if the
+ * 					message can't be indexed.
+ * 		\param 	w is the ::isowriter that receives the text
+ * 		\param	v is an ::isoview opened by ::open_view
+ * 		\param	fmt_flag is FMT_PLAIN, FMT_XML, FMT_JSON or FMT_JSON_BASE64
+ * 		\return	SUCCEEDED if having no error, the error is recorded into the context of v \n
+ * 					the error of ::index_view \n
+ * 					ERR_NODFMT if fmt_flag is not a format \n
+ * 					the error of the writer
+ */
+int write_view(isowriter *w, isoview *v, int fmt_flag)
+{
+	isoerr local, *e = (v->err != NULL)? v->err : &local;
+	bytes fld[129];
+	isofldit it;
+	int i, err;
+
+	/* index_view reports its own error */
+	err = index_view(v);
+	if(err != SUCCEEDED)
+		return err;
+	e->code = SUCCEEDED;
+	/* the fields refer to the buffer of the view, the secondary bitmap is not a field to write */
+	empty_bytes(&fld[1]);
+	fldit_init(&it, &v->bitmap);
+	i = 0;
+	do{
+		if(i == 1)
+			continue;
+		fld[i].bytes = (char*) v->buf + v->fld[i].offset;
+		fld[i].length = v->fld[i].length;
+	}while((i = fldit_next(&it)) != 0);
+	return report_isoerr(v->err, e, write_fields(w, v->def, &v->bitmap, fld, fmt_flag, e));
+}
 
 /*!	\func	void dump_message(FILE *fp, isomsg *m, int fmt_flag);
  * 		\brief 	Dump the content of the ISO message m into a file
@@ -587,404 +926,72 @@ void set_prop(isomsg *m, msgprop *prop){
 
 void dump_message(FILE *fp, isomsg *m, int fmt_flag)
 {
-	int i;
-	char* plain_str, *xml_str, *tail; // xml string buffer
-	char	tmp[FIELD_MAX_LENGTH];
-	switch(fmt_flag){
-		case FMT_PLAIN:{
-			plain_str = (char*) calloc(PLAIN_MAX_LENGTH, sizeof(char));
-			tail = plain_str;
-			sprintf(tail, "Field list: ");
-			tail = plain_str + strlen(plain_str);
-			/* print bitmap */
-			for (i =0; i <= 128; i++){
-				if (verify_bytes(&m->fld[i]) == HASDATA) {
-						memset(tmp, '\0', sizeof(tmp));
-						sprintf(tmp, "%d \t ", i);
-						if(strlen(tmp) + strlen(plain_str) < PLAIN_MAX_LENGTH){
-							strcpy(tail, tmp);
-							tail = plain_str + strlen(plain_str);
-						}else{
-							char err_msg[100];
-							sprintf(err_msg, "The dumping string's length(%d) will exceed the defined maximum value (%d)", strlen(tmp) + strlen(plain_str), PLAIN_MAX_LENGTH);
-							handle_err(ERR_OVRLEN, SYS, err_msg);
-							free(plain_str);
-							return;
-						}
-				}
-			}
-			memset(tmp, '\0', sizeof(tmp));
-			sprintf(tmp, "\n ");
-			if(strlen(tmp) + strlen(plain_str) < PLAIN_MAX_LENGTH){
-				strcpy(tail, tmp);
-				tail = plain_str + strlen(plain_str);
-			}else{
-				char err_msg[100];
-				sprintf(err_msg, "The dumping string's length(%d) exceeds the defined maximum value (%d)", strlen(tmp) + strlen(plain_str), PLAIN_MAX_LENGTH);
-				handle_err(ERR_OVRLEN, SYS, err_msg);
-				free(plain_str);
-				return;
-			}
-			for (i = 0; i <= 128; i++) {
-				if(i==1) continue;
-				if (verify_bytes(&m->fld[i]) == HASDATA) {
-					memset(tmp, '\0', sizeof(tmp));
-					/* up to the data of field i, convert it to text */
-					switch(m->def[i].format){
-						case ISO_ALPHABETIC:
-						case ISO_ALPHANUMERIC_PAD:
-						case ISO_ALPHANUMERIC:
-						case ISO_ALPHASPECIAL:
-						case ISO_ALPHANUMERIC_SPC:
-						case ISO_NUMERIC:
-						case ISO_NUMERICSPECIAL:
-						case ISO_XNUMERIC:
-						case ISO_Z:
-							snprintf(tmp, m->fld[i].length, "field #%d = %s\n", i, m->fld[i].bytes);
-							break;
-						case ISO_BINARY:{
-							/* convert m->fld[i].bytes to a hexa char array */
-							bytes tmp_bytes;
-							empty_bytes(&tmp_bytes);
-							bytes2hexachars(&m->fld[i], &tmp_bytes);
-							/* copy this hexa char array to tmp string */
-							snprintf(tmp, tmp_bytes.length, "field #%d = %s\n(hexa)", i, tmp_bytes.bytes);
-							free_bytes(&tmp_bytes);
-						}
-							break;
-						default:
-							break;
-					}
-					if(strlen(tmp) + strlen(plain_str) < PLAIN_MAX_LENGTH){
-						strcpy(tail, tmp);
-						tail = plain_str + strlen(plain_str);
-					}else{
-						char err_msg[100];
-						sprintf(err_msg, "The dumping string's length(%d) exceeds the defined maximum value (%d)", strlen(tmp) + strlen(plain_str), PLAIN_MAX_LENGTH);
-						handle_err(ERR_OVRLEN, SYS, err_msg);
-						free(plain_str);
-						return;
-					}
-				}
-			}
-			/* print buffer to file */
-			fprintf(fp, plain_str);
-			/* free buffer */
-			free(plain_str);
-		}
-			break;
-		case FMT_XML:{
-			xml_str = (char*) calloc(XML_MAX_LENGTH, sizeof(char));
-			tail = xml_str;
-			sprintf(tail, "<?xml	version=\"1.0\"	 ?>\n<%s>\n", XML_ROOT_TAG);
-			tail = xml_str + strlen(xml_str);
-			for(i = 0; i <= 128; i++){
-				if (i == 1) continue;
-				if (verify_bytes(&m->fld[i]) == HASDATA){
-					memset(tmp, '\0', sizeof(tmp));
-					switch(m->def[i].format){
-						case ISO_ALPHABETIC:
-						case ISO_ALPHANUMERIC_PAD:
-						case ISO_ALPHANUMERIC:
-						case ISO_ALPHASPECIAL:
-						case ISO_ALPHANUMERIC_SPC:
-						case ISO_NUMERIC:
-						case ISO_NUMERICSPECIAL:
-						case ISO_XNUMERIC:
-						case ISO_Z:
-							snprintf(tmp, m->fld[i].length, "\t<%s\tid=\"%d\"\tvalue=\"%s\"/>\n", XML_CHILD_TAG, i, m->fld[i].bytes);
-							break;
-						case ISO_BINARY:{
-							/* convert m->fld[i].bytes to a hexa char array */
-							bytes tmp_bytes;
-							empty_bytes(&tmp_bytes);
-							bytes2hexachars(&m->fld[i], &tmp_bytes);
-							/* copy this hexa char array to tmp string */
-							snprintf(tmp, tmp_bytes.length, "\t<%s\tid=\"%d\"\tvalue=\"%s\"/>\n", XML_CHILD_TAG, i, tmp_bytes.bytes);
-							free_bytes(&tmp_bytes);
-						}
-							break;
-						default:
-							break;
-					}
-					if((strlen(tmp) + strlen(xml_str)) < XML_MAX_LENGTH){
-						sprintf(tail, "%s", tmp);
-						tail = xml_str + strlen(xml_str);
-					}else{
-						char err_msg[100];
-						sprintf(err_msg, "The dumping xml string's length(%d) exceeds the defined maximum value (%d)", strlen(tmp) + strlen(xml_str), XML_MAX_LENGTH);
-						handle_err(ERR_OVRLEN, SYS, err_msg);
-						free(xml_str);
-						return;
-					}
-				}
-			}
-			memset(tmp, '\0', sizeof(tmp));
-			sprintf(tmp, "</%s>", XML_ROOT_TAG);
-			if(strlen(tmp) + strlen(xml_str) < XML_MAX_LENGTH){
-				sprintf(tail, "%s", tmp);
-				/* print buffer to file */
-				fprintf(fp, xml_str);
-				/* free buffer */
-				free(xml_str);
-			}else{
-				char err_msg[100];
-				sprintf(err_msg, "The dumping xml string's length(%d) exceeds the defined maximum value (%d)", strlen(tmp) + strlen(xml_str), XML_MAX_LENGTH);
-				handle_err(ERR_OVRLEN, SYS, err_msg);
-				free(xml_str);
-				return;
-			}
+	isowriter w;
+	int err;
 
-		}
-			break;
-		default:{
-			char err_msg[100];
-			sprintf(err_msg, "The format type is %d", fmt_flag);
-			handle_err(ERR_NODFMT, ISO, err_msg);
-		}
-		break;
+	init_writer_file(&w, fp);
+	/* the errors of write_message are reported by it */
+	if(write_message(&w, m, fmt_flag) == SUCCEEDED){
+		err = flush_writer(&w);
+		if(err != SUCCEEDED)
+			handle_err(err, SYS, "Can not dump the message");
 	}
+	free_writer(&w);
 }
 
 
 /*!	\func			void free_message(isomsg *m)
- *  	\brief		Free memory used by the ISO message struct m.
+ *  	\brief		Free memory used by the ISO message struct m. \n
+ * 					The fields of a message set by ::set_arena go back with a reset of its arena.
  */
 void free_message(isomsg *m)
 {
 	int i;
+	if(m->arena != NULL){
+		for (i = 0; i <= 128; i++)
+			empty_bytes(&m->fld[i]);
+		reset_arena(m->arena);
+		return;
+	}
 	for (i = 0; i <= 128; i++) {
 		free_bytes(&m->fld[i]);
 	}
 }
 /*!	\func	int set_field(isomsg* m, int idx, const char *fld, int fld_len);
- *  \brief	set data to a field of iso msg.
+ *  \brief	set data to a field of iso msg. \n
+ * 				The data is copied, into the arena of m if it has one. The previous data of the field is freed,
+ * 				or left in the arena until the next ::free_message. The data is checked against the
+ * 				definition when m is packed.
  * 	\param	m is an ::isomsg
- * 	\param	fld	is char string
+ * 	\param	idx is index of the field to be set, 0 or 2..128
+ * 	\param	fld	is the data of the field
  * 	\param  fld_len is the length of fld
+ * 	\return	SUCCEEDED if having no error \n
+ * 				ERR_IVLFLD if idx is not a data field \n
+ * 				ERR_IVLLEN if fld_len is not positive \n
+ * 				ERR_OUTMEM if the data can't be copied
  */
+int set_field(isomsg* m, int idx, const char *fld, int fld_len)
+{
+	isoerr local, *e = (m->err != NULL)? m->err : &local;
+	int err;
 
-//int set_field(isomsg* m, int idx, const char *fld, int fld_len)
-//{
-//	char err_msg[100];
-//
-//	if ((idx > 128) || (idx < 0)) {
-//		/*
-//		 * The value of idx must be between 0 and 128
-//		 */
-//		sprintf(err_msg, "%s:%d --> Invalid field %d", __FILE__, __LINE__, idx);
-//		handle_err(ERR_IVLFLD, ISO, err_msg);
-//		return ERR_IVLFLD; /*Invalid field*/
-//	}
-//
-//	isodef *def = m->iso_def;
-//
-//	if ((def[idx].format == ISO_BINARY && m->bmp_flag == BMP_HEXA && fld_len > 2*def[idx].flds)
-//		|| (def[idx].format != ISO_BINARY && fld_len > def[idx].flds)) {
-//		/*
-//		 * The length of this field is too long
-//		 */
-//		sprintf(err_msg, "%s:%d --> The length of field %d is too long", __FILE__, __LINE__, idx);
-//		handle_err(ERR_OVRLEN, ISO, err_msg);
-//		return ERR_OVRLEN;
-//	}
-//
-//	int err_code = check_fld(fld, fld_len, idx, def);
-//	if (err_code) {
-//		/*
-//		 * The value of this field is invalid
-//		 */
-//		sprintf(err_msg, "%s:%d --> The value of field %d is invalid", __FILE__, __LINE__, idx);
-//		handle_err(err_code, ISO, err_msg);
-//		return err_code;
-//	}
-//
-//	char *field = (char *)malloc((fld_len + 1)*sizeof(char));
-//	if (field == NULL) {
-//		sprintf(err_msg, "%s:%d --> Can't allocate memory for field %d", __FILE__, __LINE__,idx);
-//		handle_err(ERR_OUTMEM, SYS, err_msg);
-//		return ERR_OUTMEM;
-//	}
-//
-//	switch (def[idx].format) {
-//		case ISO_BITMAP:
-//			break;
-//		case ISO_NUMERIC:
-//			if (IS_FIXED_LEN(def,idx)) {
-//				lpad(field, def[idx].flds, '0');
-//			}
-//			break;
-//		case ISO_ALPHANUMERIC:
-//			if (IS_FIXED_LEN(def,idx)) {
-//				rpad(field, def[idx].flds, ' ');
-//			}
-//			break;
-//		case ISO_BINARY:
-//			break;
-//		default:
-//			sprintf(err_msg, "Field %d --> Format out of range", idx);
-//			handle_err(ERR_IVLFMT, ISO, err_msg);
-//			return ERR_IVLFMT; /*invalid format*/
-//	}
-//
-//	// set data to the idxth field
-//	m->fld[idx].bytes = field;
-//	m->fld[idx].length = fld_len;
-//
-//	return 0;
-//}
-
-/*!	\func	int get_field(char* buf, const isodef *def, int bmp_flag, int idx, char *fld, int *fld_len);
- * 	\brief	get data of a field from the msg buff.
- * 	\param	buf is iso message byte string
- * 	\param	def is an ::isodef
- * 	\param  bmp_flag
- * 	\param	idx is index of the field to be retrieved
- * 	\param	fld	is char string
- * 	\param  fld_len is the length of fld
- */
+	if ((idx > 128) || (idx < 0) || idx == 1) {
+		/*
+		 * The value of idx must be between 0 and 128, the bitmap is built when packing
+		 */
+		return report_isoerr(m->err, e, fail_isoerr(e, ERR_IVLFLD, idx, -1, -1, -1, -1)); /*Invalid field*/
+	}
+	if (fld == NULL || fld_len <= 0)
+		return report_isoerr(m->err, e, fail_isoerr(e, ERR_IVLLEN, idx, -1, -1, fld_len, -1));
 
-//int get_field(char* buf, const isodef *def, int bmp_flag, int idx, char *fld, int *fld_len)
-//{
-//	char *pos = &buf[0];
-//	int bmp_len;
-//
-//	char err_msg[100];
-//
-//	if ((idx > 128) || (idx < 0)) {
-//		/*
-//		 * The value of idx must be between 0 and 128
-//		 */
-//		sprintf(err_msg, "%s:%d --> Invalid field %d", __FILE__, __LINE__, idx);
-//		handle_err(ERR_IVLFLD, ISO, err_msg);
-//		return ERR_IVLFLD; /*Invalid field*/
-//	}
-//
-//	/* Field 0 is mandatory and fixed length. */
-//	if (def[0].lenflds != 0) {
-//		/*The length define is not correct*/
-//		handle_err(ERR_IVLLEN, ISO, "Definition 0 --> The length define is not correct");
-//		return 0;
-//	}
-//
-//	if (idx == 0) {
-//		/* the field is mti */
-//		memcpy(fld,pos,def[0].flds);
-//		*fld_len =  def[0].flds;
-//		return 0;
-//	}
-//
-//	pos += def[0].flds;
-//	/* get the bitmap to determine a field exist in the msg */
-//	/*
-//	 * First bit in the bitmap (field 1) defines if the message is
-//	 * extended or not.
-//	 * 0: not exteded - i.e. only (some of) the fields 0 to 64 are
-//	 *    used
-//	 * 1: extended - i.e. (some of) the fields 0 to 128 are used
-//	 * I.e. if one or more of the fields 65 to 128 is used, the
-//	 * bit is 1.
-//	 */
-//	int flds = 64;
-//	char bitmap[100];
-//
-//	if(bmp_flag == BMP_BINARY){
-//		if(*pos & 0x80) {
-//			flds = 128;
-//		} else {
-//			flds = 64;
-//		}
-//		bmp_len = flds/8;
-//		memcpy(bitmap, pos, bmp_len);
-//		bitmap[bmp_len] = 0;
-//		pos += bmp_len;
-//	}else{
-//		if(hexachar2int(*pos) & 0x08) {
-//			flds = 128;
-//		} else {
-//			flds = 64;
-//		}
-//		Bytes byte_tmp, hexa_tmp;
-//		hexa_tmp.length = flds/4;
-//		hexa_tmp.bytes = (char *) calloc(hexa_tmp.length, sizeof(char));
-//		if (hexa_tmp.bytes == NULL) {
-//			sprintf(err_msg, "%s:%d --> Can't allocate memory", __FILE__, __LINE__);
-//			handle_err(ERR_OUTMEM, SYS, err_msg);
-//			return ERR_OUTMEM;
-//		}
-//		memcpy(hexa_tmp.bytes, pos, flds/4);
-//		if( hexachars2bytes(&hexa_tmp, &byte_tmp) < 0){
-//			handle_err(ERR_HEXBYT, SYS, "Can't convert the bitmap hexachar array to binary");
-//			free(hexa_tmp.bytes);
-//			return ERR_HEXBYT;
-//		}
-//		bmp_len = byte_tmp.length/8;
-//		memcpy(bitmap, byte_tmp.bytes, bmp_len);
-//		free(hexa_tmp.bytes);
-//		free(byte_tmp.bytes);
-//		pos += flds/4;
-//	}
-//
-//	if (idx == 1) {
-//		/* the field is bitmap */
-//		*fld_len = bmp_len;
-//		memcpy(fld,bitmap,bmp_len);
-//		return 0;
-//	}
-//
-//	if (idx <= flds && ((bitmap[(idx-1)/8] << ((idx-1)%8)) & 0x80)) { /* idx'th bit != 0 */
-//		int i;
-//		int len;
-//		char tmp[20];
-//		for (i = 2; i <= idx; i++) {
-//			if ((bitmap[(i-1)/8] << ((i-1)%8)) & 0x80) { /* i'th bit != 0 */
-//				if (!IS_FIXED_LEN(def,i)) { /* Variable length */
-//					sprintf(tmp, "%%0%dd", (bmp_flag == BMP_HEXA && def[idx].format == ISO_BINARY) ? 2*def[i].lenflds : def[i].lenflds);
-//					sscanf(pos, tmp, &len);
-//					/*
-//					 * The length of a field can't be
-//					 * larger than defined by def[i].flds.
-//					 */
-//					if (len > (bmp_flag == BMP_HEXA && def[idx].format == ISO_BINARY) ? 2*def[i].lenflds : def[i].lenflds) {
-//						sprintf(err_msg, "%s:%d --> The length of field %d is too long", __FILE__, __LINE__, idx);
-//						handle_err(ERR_OVRLEN, ISO, err_msg);
-//						return ERR_OVRLEN;
-//					}
-//				}
-//				else { /* Fixed length */
-//					len = (bmp_flag == BMP_HEXA && def[idx].format == ISO_BINARY) ? 2*def[i].lenflds : def[i].lenflds;
-//				}
-//				switch (def[i].format) {
-//					case ISO_NUMERIC: /* Fallthrough */
-//					case ISO_ALPHANUMERIC:
-//						/* Don't copy lenght bytes */
-//						pos += def[i].lenflds;
-//						break;
-//					case ISO_BINARY:
-//						/* Copy length bytes */
-//						len += (bmp_flag == BMP_HEXA) ? 2*def[i].lenflds : def[i].lenflds;
-//						break;
-//					default:
-//						sprintf(err_msg, "Field %d --> Format out of range", idx);
-//						handle_err(ERR_IVLFMT, ISO, err_msg);
-//						return ERR_IVLFMT; /*invalid format*/
-//				}
-//
-//				if (i == idx) {
-//					*fld_len = len;
-//					memcpy(fld, pos, len);
-//					fld[len] = '\0';
-//				}
-//				pos += len;
-//			}
-//		}
-//	}
-//	else {
-//		/* the field not exist */
-//		sprintf(err_msg, "The fied %d is not exist", idx);
-//		handle_err(ERR_IVLFLD, ISO, err_msg);
-//		return ERR_IVLFLD; /*invalid format*/
-//	}
-//	return 0;
-//}
-//
+	if (m->arena != NULL) {
+		err = import_data_arena(m->arena, &m->fld[idx], fld, fld_len);
+	} else {
+		free_bytes(&m->fld[idx]);
+		err = import_data(&m->fld[idx], fld, fld_len);
+	}
+	if (err != SUCCEEDED)
+		return report_isoerr(m->err, e, fail_isoerr(e, ERR_OUTMEM, idx, -1, -1, fld_len, -1));
+	return SUCCEEDED;
+}
@@ -7,6 +7,8 @@
 #include <stdio.h>
 #include <time.h>
 #include "utilities.h"
+#include "bitmap.h"
+#include "writer.h"
 
 #define ISO_BITMAP       					0			/*!	\brief	Bitmap	datatype */
 #define ISO_NUMERIC      					1			/*!	\brief 	N datatype */
@@ -34,6 +36,8 @@
 
 #define FMT_PLAIN		0
 #define FMT_XML		1
+#define FMT_JSON		2		/*!	\brief	Json, the binary fields are hexa character arrays */
+#define FMT_JSON_BASE64	3		/*!	\brief	Json, the binary fields are base64 character arrays */
 
 #define ISO_VER87	0
 #define ISO_VER93	1
@@ -43,6 +47,9 @@
 #define XML_FIELD_INDEX		"id"
 #define XML_FIELD_VALUE	"value"
 
+#define JSON_MTI_KEY		"mti"
+#define JSON_FIELDS_KEY		"fields"
+
 
 /*!	\struct		isodef
  * 		\brief		The structure holds all data delement definitions of an iso8583 version.
@@ -74,6 +81,102 @@ typedef struct {
 	char numeric_pad;
 } msgprop;
 
+#define CODEC_FIXED		0		/*!	\brief	Fixed length field that must have its exact length (MTI, binary) */
+#define CODEC_LPAD		1		/*!	\brief	Fixed length field, left padded when shorter (numeric) */
+#define CODEC_RPAD		2		/*!	\brief	Fixed length field, right padded when shorter */
+#define CODEC_LLVAR		3		/*!	\brief	Variable length field preceded by its LL/LLL header */
+#define CODEC_BITMAP	4		/*!	\brief	The bitmap field, it is built by the codec */
+
+/*!	\struct		isocodec
+ * 		\brief		The compiled form of an ::isodef entry, only what the codec needs in 8 bytes
+ */
+typedef struct {
+	/*! \brief The encoder/decoder kind, one of the CODEC_ constants */
+	unsigned char kind;
+	/*! \brief The datatype of the field, one of the ISO_ constants */
+	unsigned char format;
+	/*! \brief The width of the LL/LLL header, 0 for fixed length fields */
+	unsigned char lenflds;
+	/*! \brief The padding character of CODEC_LPAD and CODEC_RPAD fields */
+	char pad;
+	/*! \brief The shortest data accepted for this field */
+	unsigned short min_len;
+	/*! \brief The longest data accepted for this field, the packed length of fixed length fields */
+	unsigned short max_len;
+} isocodec;
+
+/*!	\struct		isoplan
+ * 		\brief		A codec plan compiled once from an ::isodef array and a ::msgprop by ::compile_plan
+ */
+typedef struct {
+	/*! \brief Properties of the messages packed or unpacked with this plan */
+	msgprop prop;
+	/*! \brief The source definition, only used for the field descriptions */
+	const isodef *def;
+	/*! \brief The 129 compiled field descriptors */
+	isocodec fld[129];
+} isoplan;
+
+/*!	\struct		fldview
+ * 		\brief		The location of a field inside a packed iso message
+ */
+typedef struct {
+	/*! \brief The offset of the field data from the start of the packed message, the LL/LLL header excluded */
+	int offset;
+	/*! \brief The length of the field data, 0 if the field is not present */
+	int length;
+} fldview;
+
+/*!	\struct		isoerr
+ * 		\brief		The context of an error of the codec, filled by a failing call instead of logging the error. \n
+ * 					A caller that gives a context to a message or a view with ::set_errctx or ::set_view_errctx
+ * 					decides itself which errors to format or log, with ::format_isoerr and ::log_isoerr.
+ * 					A call that takes the context resets its code, the other values are only written when it
+ * 					fails, those that don't apply to the error are -1.
+ */
+typedef struct {
+	/*! \brief The error number, as returned by the call */
+	int code;
+	/*! \brief The index of the field in error, -1 if the error is not about a field */
+	int field;
+	/*! \brief The offset of the field in the packed message, -1 if it is unknown */
+	int offset;
+	/*! \brief The expected length, the longest accepted for a variable length field or the bytes a buffer needs */
+	int expected;
+	/*! \brief The actual length of the field, or of the buffer */
+	int actual;
+	/*! \brief The datatype of the field, one of the ISO_ constants */
+	int format;
+} isoerr;
+
+/*!	\struct		isoview
+ * 		\brief		An unpacked ISO message whose fields refer to the packed buffer instead of owning a copy of it
+ */
+typedef struct {
+	/*! \brief Properties of the packed message */
+	msgprop prop;
+	/*! \brief The iso definition that the fields of the packed message conform to */
+	const isodef *def;
+	/*! \brief The compiled plan of def and prop, NULL if it has to be compiled on each call */
+	const isoplan *plan;
+	/*! \brief The packed message, it must outlive the view */
+	const char *buf;
+	/*! \brief The length of the packed buffer */
+	int buf_len;
+	/*! \brief The length of the unpacked message, which may be shorter than the buffer, 0 until the view is indexed */
+	int msg_len;
+	/*! \brief The present fields up to this one are located, 1 once opened and 128 once indexed, see ::open_view */
+	int located;
+	/*! \brief The offset of the first field that is not located yet */
+	int scan_pos;
+	/*! \brief The present fields, field 1 is set if the message has a secondary bitmap */
+	isobitmap bitmap;
+	/*! \brief The error context of the calls on this view, NULL to have their errors logged */
+	isoerr *err;
+	/*! \brief The location of the 129 fields, fld[1] is the bitmap as it is packed */
+	fldview fld[129];
+} isoview;
+
 /*!	\struct		isomsg
  * 		\brief		The ISO message structure
  */
@@ -82,6 +185,12 @@ typedef struct {
 	msgprop prop;
 	/*! \brief The iso definition that the fields of this iso message conform to */
 	const isodef *def;
+	/*! \brief The compiled plan of def and prop, NULL if it has to be compiled on each call */
+	const isoplan *plan;
+	/*! \brief The arena the field data comes from, NULL if each field is allocated on the heap */
+	isoarena *arena;
+	/*! \brief The error context of the calls on this message, NULL to have their errors logged */
+	isoerr *err;
 	/*! \brief The 129 field pointer array, each memeber cotains a byte array and its length */
 	bytes fld[129];
 } isomsg;
@@ -89,14 +198,67 @@ typedef struct {
  /*! 		\brief	Initialize an ISO message struct - i.e. set all entries to NULL */
 void init_message(isomsg *m, const isodef *def, const msgprop *prop);
 
-/*!	\brief  pack the content of an ISO message  into a buffer. \n
- * 				 NOTE: the buffer must be large enough to contain the packed message.
- */
+ /*! 		\brief	Initialize an ISO message struct that is packed with a compiled plan */
+void init_message_plan(isomsg *m, const isoplan *plan);
+
+/*!	\brief	Compile an iso definition and message properties into a codec plan */
+int compile_plan(isoplan *plan, const isodef *def, const msgprop *prop, isoerr *err);
+
+/*!	\brief  build the bitmap of the fields that contain data in an ISO message */
+void message_bitmap(const isomsg *m, isobitmap *bmp);
+
+/*!	\brief  pack the content of an ISO message into a newly allocated buffer. */
 int pack_message(isomsg *m, char **buf, int *buf_len);
 
- /*! 		\brief 		Using the definition d, unpack the content of buf into the ISO message struct m. */
+/*!	\brief  pack the content of an ISO message into a caller-owned buffer, without heap allocation. \n
+ * 				 Returns ERR_SHTBUF and the required size in *buf_len when the buffer is too small.
+ */
+int pack_message_buf(const isomsg *m, char *buf, int buf_size, int *buf_len);
+
+/*!	\brief  pack an MTI and the fields of a bitmap, held in an array of 129 fields, into a caller-owned buffer. */
+int pack_fields(const isoplan *plan, const isobitmap *bmp, const bytes *fld, char *buf, int buf_size, int *buf_len, isoerr *err);
+
+ /*! 		\brief 		Unpack the content of buf into the ISO message struct m, each field gets its own copy. */
 int unpack_message(isomsg *m, const char *buf, int buf_len);
 
+ /*! 		\brief 		Unpack the MTI and the fields of want from buf into m, the fields after the highest one of want are not parsed. */
+int unpack_message_selected(isomsg *m, const char *buf, int buf_len, const isobitmap *want);
+
+/*!		\brief 		Initialize an ISO message view with an iso definition and message properties */
+void init_view(isoview *v, const isodef *def, const msgprop *prop);
+
+/*!		\brief 		Initialize an ISO message view that is unpacked with a compiled plan */
+void init_view_plan(isoview *v, const isoplan *plan);
+
+/*!		\brief 		Give a view an error context that its failing calls fill instead of logging the error */
+void set_view_errctx(isoview *v, isoerr *err);
+
+/*!		\brief 		Open buf as the view v, only the MTI and the bitmap are decoded, the fields are located on first access */
+int open_view(isoview *v, const char *buf, int buf_len);
+
+/*!		\brief 		Locate every present field of an opened view in one pass */
+int index_view(isoview *v);
+
+/*!		\brief 		Unpack buf into the view v, recording each field as an (offset, length) pair, without copying */
+int unpack_view(isoview *v, const char *buf, int buf_len);
+
+/*!		\brief 		Unpack buf into the view v up to the highest field of want, the other fields are skipped over */
+int unpack_selected(isoview *v, const char *buf, int buf_len, const isobitmap *want);
+
+/*!		\brief 		Get the location of a field of an opened view, the data is not copied. \n
+ * 						It replaces get_field: the fields are located once, then each one is found in constant time */
+int view_field(isoview *v, int idx, const char **fld, int *fld_len);
+
+/*!		\brief 		Copy a field of an opened view into a bytes struct that owns its data */
+int copy_field(isoview *v, int idx, bytes *fld);
+
+/*!	\brief	Write the content of an iso message as plain text, xml or json */
+int write_message(isowriter *w, isomsg *m, int fmt_flag);
+
+/*!	\brief	Write the content of a packed message as plain text, xml or json, straight from a view of it */
+int write_view(isowriter *w, isoview *v, int fmt_flag);
+
+/*!	\brief	Dump the content of an iso message into a file */
 void dump_message(FILE *fp, isomsg *m, int fmt_flag);
 
 /*!  	\brief		Free memory used by the ISO message struct m. */
@@ -108,15 +270,22 @@ void set_isodef(isomsg *m, isodef *def);
 /*! 	\brief	assign an msgprop to m */
 void set_prop(isomsg *m, msgprop *prop);
 
+/*! 	\brief	make the fields of m come from an arena, or from the heap if arena is NULL */
+void set_arena(isomsg *m, isoarena *arena);
+
+/*! 	\brief	give m an error context that its failing calls fill instead of logging the error */
+void set_errctx(isomsg *m, isoerr *err);
+
 /*!	\brief	convert an iso message to xml format		*/
 char* iso_to_xml(char* iso_msg, int iso_len, const isodef* def ,msgprop* prop);
 
-/*!	\brief	convert an xml string to iso message		*/
+/*!	\brief	write a packed iso message in xml format without unpacking it		*/
+int write_iso_xml(isowriter *w, const isoplan *plan, const char *iso_msg, int iso_len, isoerr *err);
+
+/*!	\brief	convert an xml string to iso message, the caller frees it		*/
 char* xml_to_iso(char* xml_str, const isodef *def, msgprop* prop, int* iso_len);
 
 /*!	\func	set data to a field of iso msg	*/
 int set_field(isomsg* m, int idx, const char *fld, int fld_len);
-/*!	\func	get data from a field of iso msg	*/
-int get_field(char* buf, const isodef *def, const msgprop *prop, int idx, char *fld, int *fld_len);
 
 #endif /* iso8583.h */
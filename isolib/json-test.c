@@ -0,0 +1,465 @@
+/*
+ * Test of the json conversion: the sample messages of iso8583-test.c go through json and back with
+ * both binary encodings, and faster than through xml. Malformed and truncated documents must be
+ * rejected with the right error, then random mutations of valid documents must either be rejected
+ * or give a message that converts back to the same document.
+ *
+ * 	usage: json-test [count [seed]]		100000 mutations by default
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "iso8583.h"
+#include "iso8583_std.h"
+#include "errors.h"
+#include "writer.h"
+#include "convert.h"
+#include "json.h"
+
+#define ROUNDS	20000
+
+static int failed;
+
+#define CHECK(cond)	do{ if(!(cond)){ printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); failed++; } }while(0)
+
+/* the authorisation request of iso8583-test.c */
+static const char authreq[] = {
+0x31,0x31,0x30,0x30,0x70,0x14,0x05,0xC2,0x00,0xE2,0x80,0x00,0x31,0x31,0x31,0x32,
+0x33,0x34,0x30,0x34,0x32,0x35,0x37,0x34,0x38,0x30,0x30,0x30,0x30,0x30,0x30,0x30,
+0x30,0x30,0x30,0x30,0x30,0x30,0x30,0x31,0x32,0x30,0x30,0x39,0x39,0x30,0x32,0x31,
+0x39,0x31,0x34,0x32,0x32,0x30,0x30,0x30,0x39,0x31,0x31,0x4B,0x30,0x30,0x35,0x30,
+0x30,0x4B,0x30,0x30,0x31,0x33,0x30,0x31,0x30,0x30,0x30,0x30,0x30,0x30,0x35,0x39,
+0x36,0x34,0x30,0x31,0x38,0x37,0x37,0x37,0x20,0x20,0x20,0x20,0x20,0x31,0x39,0x37,
+0x38,0x35,0x35,0x31,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x34,0x34,0x50,0x42,
+0x53,0x20,0x49,0x4E,0x54,0x45,0x52,0x4E,0x41,0x4C,0x20,0x54,0x45,0x53,0x54,0x5C,
+0x5C,0x42,0x61,0x6C,0x6C,0x65,0x72,0x75,0x70,0x5C,0x32,0x37,0x35,0x30,0x20,0x20,
+0x20,0x20,0x20,0x20,0x44,0x4B,0x20,0x44,0x4E,0x4B,0x30,0x30,0x33,0x20,0x20,0x20,
+0x44,0x4B,0x4B
+};
+
+/* the authorisation response of iso8583-test.c, with its binary fields */
+static const char authresp[] = {
+0x31,0x31,0x31,0x30,0x70,0x10,0x00,0x02,0x06,0xC0,0x81,0x00,0x31,0x36,0x35,0x30,
+0x31,0x39,0x31,0x32,0x33,0x34,0x30,0x34,0x32,0x35,0x37,0x34,0x38,0x33,0x30,0x30,
+0x30,0x30,0x30,0x30,0x30,0x30,0x30,0x30,0x30,0x30,0x30,0x30,0x31,0x32,0x30,0x30,
+0x39,0x39,0x30,0x32,0x31,0x39,0x31,0x34,0x32,0x32,0x30,0x30,0x30,0x31,0x38,0x31,
+0x34,0x32,0x36,0x32,0x38,0x30,0x30,0x30,0x37,0x37,0x37,0x20,0x20,0x20,0x20,0x20,
+0x31,0x39,0x37,0x38,0x35,0x35,0x31,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x44,
+0x4B,0x4B,0x30,0x39,0x30,0x30,0x38,0x73,0x6F,0x66,0x74,0x77,0x61,0x72,0x65,0x57,
+0x34,0x70,0x68,0xC2,0x0C,0x68,0x15,0x92,0xAC,0x32,0x60,0x20,0x5D,0x26,0xD2,0xDA,
+0xC9,0xD4,0xBB,0x12,0xBB,0xAB,0x75,0x54,0xF3,0x56,0xCB,0x15,0x86,0x2F,0x2D,0x85,
+0xEA,0x8A,0x40,0xE7,0xA6,0x22,0xB1,0x88,0xA2,0xCF,0xCF,0x55,0x46,0x4B,0x7A,0xB8,
+0xEE,0x6D,0xAD,0xA6,0xDE,0x61,0xBF,0xFB,0x51,0x75,0x34,0xF8,0x10,0xD6,0xBB,0xB3,
+0xE4,0x98,0x9C,0x2A,0xF8,0x74,0x72,0xE7,0xAC,0xDA,0x95,0xB3,0xE0,0xD4,0xEE,0x00,
+0x00,0x00,0x00,0x00,0x00,0x00
+};
+
+/* the capture request of iso8583-test.c */
+static const char capreq[] = {
+0x31,0x32,0x32,0x30,0x70,0x14,
+0x05,0x42,0x06,0xE2,0x81,0x00,0x31,0x36,0x35,0x30,0x31,0x39,0x31,0x32,0x33,0x34,
+0x30,0x34,0x32,0x35,0x37,0x34,0x38,0x33,0x30,0x30,0x30,0x30,0x30,0x30,0x30,0x30,
+0x30,0x30,0x30,0x30,0x30,0x30,0x31,0x32,0x30,0x30,0x39,0x39,0x30,0x32,0x31,0x39,
+0x31,0x34,0x32,0x32,0x34,0x35,0x30,0x39,0x31,0x31,0x4B,0x30,0x30,0x35,0x30,0x30,
+0x4B,0x30,0x30,0x31,0x33,0x30,0x32,0x30,0x31,0x35,0x39,0x36,0x34,0x30,0x31,0x38,
+0x31,0x34,0x32,0x36,0x32,0x38,0x30,0x30,0x30,0x37,0x37,0x37,0x20,0x20,0x20,0x20,
+0x20,0x31,0x39,0x37,0x38,0x35,0x35,0x31,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,
+0x34,0x34,0x50,0x42,0x53,0x20,0x49,0x4E,0x54,0x45,0x52,0x4E,0x41,0x4C,0x20,0x54,
+0x45,0x53,0x54,0x5C,0x5C,0x42,0x61,0x6C,0x6C,0x65,0x72,0x75,0x70,0x5C,0x32,0x37,
+0x35,0x30,0x20,0x20,0x20,0x20,0x20,0x20,0x44,0x4B,0x20,0x44,0x4E,0x4B,0x30,0x32,
+0x37,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,
+0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x44,0x4B,0x4B,0x30,
+0x39,0x30,0x30,0x38,0x73,0x6F,0x66,0x74,0x77,0x61,0x72,0x65,0x57,0x34,0x70,0x68,
+0xC2,0x0C,0x68,0x15,0x92,0xAC,0x32,0x60,0x20,0x5D,0x26,0xD2,0xDA,0xC9,0xD4,0xBB,
+0x12,0xBB,0xAB,0x75,0x54,0xF3,0x56,0xCB,0x15,0x86,0x2F,0x2D,0x85,0xEA,0x8A,0x40,
+0xE7,0xA6,0x22,0xB1,0x88,0xA2,0xCF,0xCF,0x55,0x46,0x4B,0x7A,0xB8,0xEE,0x6D,0xAD,
+0xA6,0xDE,0x61,0xBF,0xFB,0x51,0x75,0x34,0xF8,0x10,0xD6,0xBB,0xB3,0xE4,0x98,0x9C,
+0x2A,0xF8,0x74,0x72,0xE7,0xAC,0xDA,0x95,0xB3,0xE0,0xD4,0xEE,0x00,0x00,0x00,0x00
+};
+
+/* the capture response of iso8583-test.c */
+static const char capresp[] = {
+0x31,0x32,0x33,0x30,0x70,0x10,
+0x00,0x02,0x02,0xC0,0x81,0x00,0x31,0x36,0x35,0x30,0x31,0x39,0x31,0x32,0x33,0x34,
+0x30,0x34,0x32,0x35,0x37,0x34,0x38,0x33,0x30,0x30,0x30,0x30,0x30,0x30,0x30,0x30,
+0x30,0x30,0x30,0x30,0x30,0x30,0x31,0x32,0x30,0x30,0x39,0x39,0x30,0x32,0x31,0x39,
+0x31,0x34,0x32,0x32,0x34,0x35,0x30,0x31,0x38,0x30,0x30,0x30,0x37,0x37,0x37,0x20,
+0x20,0x20,0x20,0x20,0x31,0x39,0x37,0x38,0x35,0x35,0x31,0x20,0x20,0x20,0x20,0x20,
+0x20,0x20,0x20,0x44,0x4B,0x4B,0x30,0x39,0x30,0x30,0x38,0x73,0x6F,0x66,0x74,0x77,
+0x61,0x72,0x65,0x57,0x34,0x70,0x68,0xC2,0x0C,0x68,0x15,0x92,0xAC,0x32,0x60,0x20,
+0x5D,0x26,0xD2,0xDA,0xC9,0xD4,0xBB,0x12,0xBB,0xAB,0x75,0x54,0xF3,0x56,0xCB,0x15,
+0x86,0x2F,0x2D,0x85,0xEA,0x8A,0x40,0xE7,0xA6,0x22,0xB1,0x3E,0x6D,0x18,0xC6,0x2C,
+0x73,0x46,0x8C,0xC0,0x6E,0xCE,0xD2,0x0D,0x64,0xD2,0xD3,0x66,0x97,0x7B,0xAF,0xDA,
+0x52,0x50,0x0A,0x6F,0x85,0xBC,0x8A,0xAB,0x6A,0xEF,0x65,0x72,0x44,0x88,0xE5,0xC9,
+0x15,0x98,0x19,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00
+};
+
+static const struct {
+	const char *name;
+	const char *msg;
+	int size;
+} samples[] = {
+	{"authorisation request", authreq, sizeof(authreq)},
+	{"authorisation response", authresp, sizeof(authresp)},
+	{"capture request", capreq, sizeof(capreq)},
+	{"capture response", capresp, sizeof(capresp)},
+};
+
+#define SAMPLES	((int) (sizeof(samples)/sizeof(samples[0])))
+
+static unsigned long seed = 8583;
+
+/* a small generator so that a seed gives the same mutations everywhere */
+static int rnd(int n)
+{
+	seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+	return (int) ((seed >> 33) % (unsigned long) n);
+}
+
+/* the length of a sample, without the bytes after its last field */
+static int sample_len(const isoplan *plan, int i)
+{
+	isoview v;
+
+	init_view_plan(&v, plan);
+	if(unpack_view(&v, samples[i].msg, samples[i].size) != SUCCEEDED)
+		return -1;
+	return v.msg_len;
+}
+
+/* write a packed message as a json document, the caller frees it */
+static char* to_json(const isoplan *plan, const char *msg, int len, int fmt_flag, int *json_len, isoerr *e)
+{
+	isowriter w;
+
+	init_writer_buffer(&w);
+	if(write_iso_json(&w, plan, msg, len, fmt_flag, e) != SUCCEEDED){
+		free_writer(&w);
+		return NULL;
+	}
+	return writer_detach(&w, json_len);
+}
+
+/* each sample goes to json and back to the same bytes, with both binary encodings */
+static void test_samples(const isoplan *plan, int fmt_flag)
+{
+	char iso[ISO_MAX_LENGTH], *json;
+	int i, len, json_len, iso_len;
+	isoerr e;
+
+	for(i = 0; i < SAMPLES; i++){
+		len = sample_len(plan, i);
+		CHECK(len > 0);
+		json = to_json(plan, samples[i].msg, len, fmt_flag, &json_len, &e);
+		CHECK(json != NULL);
+		if(json == NULL)
+			continue;
+		CHECK(json_to_iso_buf(plan, json, json_len, fmt_flag, iso, sizeof(iso), &iso_len, &e) == SUCCEEDED);
+		CHECK(iso_len == len && memcmp(iso, samples[i].msg, len) == 0);
+		/* a buffer that is too small gives the required size */
+		CHECK(json_to_iso_buf(plan, json, json_len, fmt_flag, iso, len - 1, &iso_len, &e) == ERR_SHTBUF);
+		CHECK(iso_len == len);
+		free(json);
+	}
+}
+
+/* the documents that must be rejected, and their error */
+static const struct {
+	const char *doc;
+	int fmt_flag;
+	int err;
+} bad[] = {
+	{"", FMT_JSON, ERR_JSNPAS},
+	{"[]", FMT_JSON, ERR_JSNPAS},
+	{"{\"mti\":\"0800\",\"fields\":{\"11\":\"000001\"}} x", FMT_JSON, ERR_JSNPAS},
+	{"{\"mti\":\"0800\" \"fields\":{}}", FMT_JSON, ERR_JSNPAS},
+	{"{\"mti\":\"0800\",\"fields\":{\"11\":\"000001\",}}", FMT_JSON, ERR_JSNPAS},
+	{"{\"mti\":0800,\"fields\":{}}", FMT_JSON, ERR_JSNSYT},
+	{"{\"mti\":\"0800\",\"fields\":[]}", FMT_JSON, ERR_JSNPAS},
+	{"{\"mti\":\"0800\",\"fields\":{\"11\":true}}", FMT_JSON, ERR_JSNSYT},
+	{"{\"mti\":\"0800\",\"other\":\"x\",\"fields\":{}}", FMT_JSON, ERR_JSNSYT},
+	/* the keys of the fields */
+	{"{\"mti\":\"0800\",\"fields\":{\"x\":\"1\"}}", FMT_JSON, ERR_JSNSYT},
+	{"{\"mti\":\"0800\",\"fields\":{\"011\":\"000001\"}}", FMT_JSON, ERR_JSNSYT},
+	{"{\"mti\":\"0800\",\"fields\":{\"\":\"1\"}}", FMT_JSON, ERR_JSNSYT},
+	{"{\"mti\":\"0800\",\"fields\":{\"1\":\"1\"}}", FMT_JSON, ERR_IVLFLD},
+	{"{\"mti\":\"0800\",\"fields\":{\"129\":\"1\"}}", FMT_JSON, ERR_IVLFLD},
+	/* the strings */
+	{"{\"mti\":\"08\\x00\",\"fields\":{}}", FMT_JSON, ERR_JSNPAS},
+	{"{\"mti\":\"08\\u00\",\"fields\":{}}", FMT_JSON, ERR_JSNPAS},
+	{"{\"mti\":\"08\\u00G0\",\"fields\":{}}", FMT_JSON, ERR_JSNPAS},
+	{"{\"mti\":\"08\\uDC00\",\"fields\":{}}", FMT_JSON, ERR_JSNPAS},
+	{"{\"mti\":\"08\\uD800\",\"fields\":{}}", FMT_JSON, ERR_JSNPAS},
+	{"{\"mti\":\"08\\uD800\\u0041\",\"fields\":{}}", FMT_JSON, ERR_JSNPAS},
+	{"{\"mti\":\"08\n0\",\"fields\":{}}", FMT_JSON, ERR_JSNPAS},
+	/* the values are validated against the definition */
+	{"{\"mti\":\"08A0\",\"fields\":{}}", FMT_JSON, ERR_IVLFMT},
+	{"{\"mti\":\"0800\",\"fields\":{\"11\":\"0000001\"}}", FMT_JSON, ERR_IVLLEN},
+	/* the binary fields, field 52 is 8 bytes */
+	{"{\"mti\":\"0800\",\"fields\":{\"52\":\"0123456789ABCDE\"}}", FMT_JSON, ERR_HEXBYT},
+	{"{\"mti\":\"0800\",\"fields\":{\"52\":\"0123456789ABCDEG\"}}", FMT_JSON, ERR_HEXBYT},
+	{"{\"mti\":\"0800\",\"fields\":{\"52\":\"0123456789ABCD\"}}", FMT_JSON, ERR_IVLLEN},
+	{"{\"mti\":\"0800\",\"fields\":{\"52\":\"ASNFZ4mrze8\"}}", FMT_JSON_BASE64, ERR_B64BYT},
+	{"{\"mti\":\"0800\",\"fields\":{\"52\":\"ASNFZ4mrze8*\"}}", FMT_JSON_BASE64, ERR_B64BYT},
+	{"{\"mti\":\"0800\",\"fields\":{\"52\":\"ASNFZ4mrzQ==\"}}", FMT_JSON_BASE64, ERR_IVLLEN},
+	{"{\"mti\":\"0800\",\"fields\":{}}", FMT_PLAIN, ERR_NODFMT},
+};
+
+/* the documents that must be accepted, and the message they give */
+static const struct {
+	const char *doc;
+	int fmt_flag;
+	const char *fields;		/* the fields 0, 11 and 52 of the message, as hexa */
+} good[] = {
+	{" {\"fields\" : { } , \"mti\" : \"0800\" } ", FMT_JSON, "30383030"},
+	{"{\"mti\":\"0800\",\"fields\":{\"11\":\"000001\",\"11\":\"000002\"}}", FMT_JSON, "30383030 303030303032"},
+	{"{\"mti\":\"0800\",\"fields\":{\"11\":\"\"}}", FMT_JSON, "30383030"},
+	{"{\"mti\":\"\\u0030\\u00380\\u0030\",\"fields\":{\"11\":\"00000\\u0031\"}}", FMT_JSON, "30383030 303030303031"},
+	{"{\"mti\":\"0800\",\"fields\":{\"52\":\"0123456789abcdef\"}}", FMT_JSON, "30383030 0123456789ABCDEF"},
+	{"{\"mti\":\"0800\",\"fields\":{\"52\":\"0123456789\\u0041BCDEF\"}}", FMT_JSON, "30383030 0123456789ABCDEF"},
+	{"{\"mti\":\"0800\",\"fields\":{\"52\":\"ASNFZ4mrze8=\"}}", FMT_JSON_BASE64, "30383030 0123456789ABCDEF"},
+};
+
+/* the hexa of the fields 0, 11 and 52 of a message, separated by a space */
+static void fields_hexa(const isoplan *plan, const char *msg, int len, char *out)
+{
+	static const char digits[] = "0123456789ABCDEF";
+	static const int idx[] = {0, 11, 52};
+	const char *data;
+	isoview v;
+	int i, j, n;
+
+	char *p = out;
+
+	*p = '\0';
+	init_view_plan(&v, plan);
+	if(unpack_view(&v, msg, len) != SUCCEEDED)
+		return;
+	for(i = 0; i < 3; i++){
+		if(view_field(&v, idx[i], &data, &n) != SUCCEEDED)
+			continue;
+		if(p != out)
+			*p++ = ' ';
+		for(j = 0; j < n; j++){
+			*p++ = digits[(data[j] >> 4) & 0x0F];
+			*p++ = digits[data[j] & 0x0F];
+		}
+		*p = '\0';
+	}
+}
+
+static void test_documents(const isoplan *plan)
+{
+	char iso[ISO_MAX_LENGTH], hexa[256];
+	int i, n, iso_len, err;
+	isoerr e;
+
+	for(i = 0; i < (int) (sizeof(bad)/sizeof(bad[0])); i++){
+		n = strlen(bad[i].doc);
+		err = json_to_iso_buf(plan, bad[i].doc, n, bad[i].fmt_flag, iso, sizeof(iso), &iso_len, &e);
+		if(err != bad[i].err || e.code != err)
+			printf("%s: %d instead of %d\n", bad[i].doc, err, bad[i].err);
+		CHECK(err == bad[i].err && e.code == err);
+		/* the errors of the document are located in it, the binary ones at their field */
+		if(err == ERR_JSNPAS || err == ERR_JSNSYT)
+			CHECK(e.offset >= 0 && e.offset <= n);
+		if(err == ERR_HEXBYT || err == ERR_B64BYT)
+			CHECK(e.field == 52);
+	}
+	for(i = 0; i < (int) (sizeof(good)/sizeof(good[0])); i++){
+		err = json_to_iso_buf(plan, good[i].doc, strlen(good[i].doc), good[i].fmt_flag, iso, sizeof(iso), &iso_len, &e);
+		CHECK(err == SUCCEEDED);
+		if(err != SUCCEEDED){
+			printf("%s: %d\n", good[i].doc, err);
+			continue;
+		}
+		fields_hexa(plan, iso, iso_len, hexa);
+		if(strcmp(hexa, good[i].fields) != 0)
+			printf("%s: %s instead of %s\n", good[i].doc, hexa, good[i].fields);
+		CHECK(strcmp(hexa, good[i].fields) == 0);
+	}
+}
+
+/* every document cut short is rejected as not well formed */
+static void test_truncated(const isoplan *plan, int fmt_flag)
+{
+	char iso[ISO_MAX_LENGTH], *json;
+	int i, n, json_len, iso_len, len = sample_len(plan, 2);
+	isoerr e;
+
+	json = to_json(plan, capreq, len, fmt_flag, &json_len, &e);
+	CHECK(json != NULL);
+	if(json == NULL)
+		return;
+	for(n = 0; n < json_len; n++){
+		i = json_to_iso_buf(plan, json, n, fmt_flag, iso, sizeof(iso), &iso_len, &e);
+		if(i != ERR_JSNPAS){
+			printf("the document cut at %d of %d gives %d\n", n, json_len, i);
+			failed++;
+			break;
+		}
+	}
+	free(json);
+}
+
+/*
+ * Random mutations of the sample documents: a byte is replaced, inserted or removed. A mutated
+ * document is either rejected with its error recorded, or converted into a message whose document
+ * is well formed. That document converts again into the same message, unless a fixed length value
+ * was shortened: it is padded when packed, and the padding may not be of the format of the field.
+ */
+static long test_mutations(const isoplan *plan, long count, long *packed)
+{
+	static const char chars[] = "{}[]\":,\\/ \t\nu0123456789abcdefABCDEF+=xG";
+	char doc[8192], iso1[ISO_MAX_LENGTH], iso2[ISO_MAX_LENGTH], *json, *back;
+	int i, j, n, fmt_flag, len1, len2, back_len, err;
+	long k, bad_count = 0;
+	isoerr e;
+
+	for(k = 0; k < count && bad_count < 10; k++){
+		i = rnd(SAMPLES);
+		fmt_flag = rnd(2)? FMT_JSON : FMT_JSON_BASE64;
+		json = to_json(plan, samples[i].msg, sample_len(plan, i), fmt_flag, &n, &e);
+		if(json == NULL || n + 8 > (int) sizeof(doc)){
+			free(json);
+			failed++;
+			break;
+		}
+		memcpy(doc, json, n);
+		free(json);
+		for(j = rnd(3); j >= 0; j--){
+			i = rnd(n);
+			switch(rnd(3)){
+				case 0:
+					doc[i] = (rnd(4) == 0)? (char) rnd(256) : chars[rnd(sizeof(chars) - 1)];
+					break;
+				case 1:
+					memmove(doc + i + 1, doc + i, n - i);
+					doc[i] = chars[rnd(sizeof(chars) - 1)];
+					n++;
+					break;
+				default:
+					memmove(doc + i, doc + i + 1, n - i - 1);
+					n--;
+					break;
+			}
+		}
+		err = json_to_iso_buf(plan, doc, n, fmt_flag, iso1, sizeof(iso1), &len1, &e);
+		if(err != SUCCEEDED){
+			CHECK(e.code == err);
+			continue;
+		}
+		(*packed)++;
+		back = to_json(plan, iso1, len1, fmt_flag, &back_len, &e);
+		err = (back == NULL)? e.code : json_to_iso_buf(plan, back, back_len, fmt_flag, iso2, sizeof(iso2), &len2, &e);
+		if(err == SUCCEEDED? (len1 != len2 || memcmp(iso1, iso2, len1) != 0) : err != ERR_IVLFMT){
+			printf("mutation %ld does not convert back: %d\n%.*s\n", k, err, n, doc);
+			bad_count++;
+		}
+		free(back);
+	}
+	failed += bad_count;
+	return k;
+}
+
+/* the time of ROUNDS conversions of every document, by conv */
+static double time_docs(int (*conv)(void *ctx, const char *doc, int len), void *ctx, char **docs, int *lens)
+{
+	clock_t start = clock();
+	int i, r;
+
+	for(r = 0; r < ROUNDS; r++){
+		for(i = 0; i < SAMPLES; i++){
+			if(conv(ctx, docs[i], lens[i]) != SUCCEEDED){
+				failed++;
+				return 0;
+			}
+		}
+	}
+	return (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+static int xml_conv(void *ctx, const char *doc, int len)
+{
+	msgprop prop = {BMP_BINARY, ' ', '0'};
+	char iso[ISO_MAX_LENGTH];
+	int iso_len;
+
+	return xmlctx_to_iso((xmlctx*) ctx, doc, len, iso93, &prop, iso, sizeof(iso), &iso_len);
+}
+
+static int json_conv(void *ctx, const char *doc, int len)
+{
+	char iso[ISO_MAX_LENGTH];
+	int iso_len;
+
+	return json_to_iso_buf((const isoplan*) ctx, doc, len, FMT_JSON, iso, sizeof(iso), &iso_len, NULL);
+}
+
+/*
+ * The samples are converted from json and from xml, which is read either without the parser or, with
+ * a comment after its root, by Expat. json must be the faster. Most of the time of the first two
+ * routes is the validation and the packing of the fields, which they share.
+ */
+static void test_speed(const isoplan *plan)
+{
+	char *xml[SAMPLES], *expat[SAMPLES], *json[SAMPLES];
+	int i, xml_len[SAMPLES], expat_len[SAMPLES], json_len[SAMPLES];
+	double xml_time, expat_time, json_time;
+	isowriter w;
+	xmlctx x;
+	isoerr e;
+
+	if(init_xmlctx(&x) != SUCCEEDED){
+		failed++;
+		return;
+	}
+	set_xml_errctx(&x, &e);
+	for(i = 0; i < SAMPLES; i++){
+		init_writer_buffer(&w);
+		CHECK(write_iso_xml(&w, plan, samples[i].msg, sample_len(plan, i), &e) == SUCCEEDED);
+		xml[i] = writer_detach(&w, &xml_len[i]);
+		json[i] = to_json(plan, samples[i].msg, sample_len(plan, i), FMT_JSON, &json_len[i], &e);
+		CHECK(xml[i] != NULL && json[i] != NULL);
+		if(xml[i] == NULL || json[i] == NULL)
+			return;
+		expat_len[i] = xml_len[i] + 7;
+		expat[i] = (char*) malloc(expat_len[i]);
+		memcpy(expat[i], xml[i], xml_len[i]);
+		memcpy(expat[i] + xml_len[i], "<!---->", 7);
+	}
+	expat_time = time_docs(xml_conv, &x, expat, expat_len);
+	xml_time = time_docs(xml_conv, &x, xml, xml_len);
+	json_time = time_docs(json_conv, (void*) plan, json, json_len);
+	printf("json-test: %d conversions of the samples, %.0f ms from xml by expat, %.0f ms from xml, %.0f ms from json\n",
+			ROUNDS * SAMPLES, expat_time, xml_time, json_time);
+	CHECK(json_time < xml_time && json_time < expat_time);
+	for(i = 0; i < SAMPLES; i++){
+		free(xml[i]);
+		free(expat[i]);
+		free(json[i]);
+	}
+	free_xmlctx(&x);
+}
+
+int main(int argc, char **argv)
+{
+	msgprop prop = {BMP_BINARY, ' ', '0'};
+	isoplan plan;
+	long count = (argc > 1)? atol(argv[1]) : 100000, done, packed = 0;
+
+	if(argc > 2)
+		seed = strtoul(argv[2], NULL, 10);
+	if(compile_plan(&plan, iso93, &prop, NULL) != SUCCEEDED)
+		return 1;
+	test_samples(&plan, FMT_JSON);
+	test_samples(&plan, FMT_JSON_BASE64);
+	test_documents(&plan);
+	test_truncated(&plan, FMT_JSON);
+	test_truncated(&plan, FMT_JSON_BASE64);
+	done = test_mutations(&plan, count, &packed);
+	test_speed(&plan);
+	printf("json-test: %ld mutations, %ld packed, %s\n", done, packed, failed? "FAILED" : "passed");
+	return failed? 1 : 0;
+}
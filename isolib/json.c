@@ -0,0 +1,562 @@
+/*!	\file		json.c
+ * 		\brief	This file converts iso messages to json documents and back. \n
+ * 					The documents have a fixed form, {"mti":"...","fields":{"2":"...",...}}, so they are
+ * 					read by a small parser written for it instead of a generic one. The values are found in
+ * 					place and packed from the document itself: only the escaped strings and the binary
+ * 					fields are decoded, into a buffer on the stack. Nothing is allocated per field. \n
+ * 					The binary fields are hexa character arrays for FMT_JSON and base64 ones for
+ * 					FMT_JSON_BASE64, the other fields are json strings whose \\u escapes below 0x80 are
+ * 					single bytes and the others UTF-8 sequences.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "json.h"
+#include "errors.h"
+#include "hexa.h"
+#include "base64.h"
+
+/*!	\brief	The white spaces of json */
+#define JSON_SPACE(c)		((c) == ' ' || (c) == '\t' || (c) == '\n' || (c) == '\r')
+
+/*!	\brief	The size of the buffer that receives the decoded values of a document */
+#define JSON_SCRATCH		ISO_MAX_LENGTH
+
+/*!	\struct		jsonin
+ * 		\brief		The state of the parser of a document
+ */
+typedef struct {
+	/*! \brief The document, the next character to read and the end of the document */
+	const char *start;
+	const char *p;
+	const char *end;
+	/*! \brief The buffer of the decoded values and the number of its bytes in use */
+	char *scratch;
+	int used;
+	/*! \brief Whether the last string read is decoded into scratch, it refers to the document otherwise */
+	int decoded;
+	/*! \brief The error context that receives the errors of the document */
+	isoerr *e;
+} jsonin;
+
+/*!	\func	static int check_format(int fmt_flag, isoerr *e)
+ * 		\brief	Check that a format is a json one, the error is recorded into e
+ * 		\return	SUCCEEDED if fmt_flag is FMT_JSON or FMT_JSON_BASE64 \n
+ * 					ERR_NODFMT otherwise
+ */
+static int check_format(int fmt_flag, isoerr *e){
+	if(fmt_flag == FMT_JSON || fmt_flag == FMT_JSON_BASE64)
+		return SUCCEEDED;
+	return fail_isoerr(e, ERR_NODFMT, -1, -1, -1, -1, -1);
+}
+
+/*!	\func	int write_iso_json(isowriter *w, const isoplan *plan, const char *iso_msg, int iso_len, int fmt_flag, isoerr *err);
+ * 		\brief	Write a packed iso message as a json document, straight from its buffer. \n
+ * 					The fields are located by a view of the message and written from its buffer, the binary
+ * 					ones encoded on the fly. Nothing is allocated per field or per message.
+ * 		\param	w is the ::isowriter that receives the json
+ * 		\param	plan is an ::isoplan compiled by ::compile_plan
+ * 		\param	iso_msg is the packed message
+ * 		\param	iso_len is the length of iso_msg
+ * 		\param	fmt_flag is FMT_JSON or FMT_JSON_BASE64
+ * 		\param	err is the error context that receives the error, NULL to log the error
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_NODFMT if fmt_flag is not a json format \n
+ * 					the error of ::unpack_view, nothing is written then \n
+ * 					the error of the writer
+ */
+int write_iso_json(isowriter *w, const isoplan *plan, const char *iso_msg, int iso_len, int fmt_flag, isoerr *err){
+	isoerr local, *e = (err != NULL)? err : &local;
+	isoview v;
+	int ret;
+
+	e->code = SUCCEEDED;
+	ret = check_format(fmt_flag, e);
+	if(ret != SUCCEEDED)
+		return report_isoerr(err, e, ret);
+	init_view_plan(&v, plan);
+	set_view_errctx(&v, err);
+	ret = open_view(&v, iso_msg, iso_len);
+	if(ret != SUCCEEDED)
+		return ret;
+	return write_view(w, &v, fmt_flag);
+}
+
+/*!	\func		char* iso_to_json(const char *iso_msg, int iso_len, const isodef *def, const msgprop *prop, int fmt_flag);
+ * 		\brief		convert a message in iso format to a json document
+ * 		\param		iso_msg	a character pointer that points to this message
+ * 		\param		iso_len		the length of the iso message
+ * 		\param 	def is an array of ::isodef structures which refers to all data element definitions of  an iso standard
+ * 		\param		prop  the properties of the iso message (bitmap format, padding characters)
+ * 		\param		fmt_flag is FMT_JSON or FMT_JSON_BASE64
+ * 		\return		a json string if successfully convert the message, the caller frees it	\n
+ * 						NULL in case having an error
+ */
+char* iso_to_json(const char *iso_msg, int iso_len, const isodef *def, const msgprop *prop, int fmt_flag){
+	char *json_str;
+	isoplan plan;
+	isowriter w;
+	int err;
+	err = compile_plan(&plan, def, prop, NULL);
+	/* the callees log their own errors */
+	if(err != SUCCEEDED)
+		return NULL;
+	init_writer_buffer(&w);
+	err = write_iso_json(&w, &plan, iso_msg, iso_len, fmt_flag, NULL);
+	if(err != SUCCEEDED){
+		free_writer(&w);
+		return NULL;
+	}
+	json_str = writer_detach(&w, NULL);
+	if(json_str == NULL)
+		handle_err(ERR_OUTMEM, SYS, "Can not allocate the json string");
+	return json_str;
+}
+
+/*!	\func	static int json_error(jsonin *in, int err)
+ * 		\brief	Record an error of the document at the current position
+ * 		\return	err
+ */
+static int json_error(jsonin *in, int err){
+	return fail_isoerr(in->e, err, -1, (int) (in->p - in->start), -1, -1, -1);
+}
+
+/*!	\func	static void skip_space(jsonin *in)
+ * 		\brief	Skip the white spaces
+ */
+static void skip_space(jsonin *in){
+	while(in->p < in->end && JSON_SPACE(*in->p))
+		in->p++;
+}
+
+/*!	\func	static int expect(jsonin *in, char ch)
+ * 		\brief	Skip the white spaces, then a character that must be ch
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_JSNPAS if the next character is not ch
+ */
+static int expect(jsonin *in, char ch){
+	skip_space(in);
+	if(in->p < in->end && *in->p == ch){
+		in->p++;
+		return SUCCEEDED;
+	}
+	return json_error(in, ERR_JSNPAS);
+}
+
+/*!	\func	static int read_hex4(const char *p, const char *end, unsigned long *cp)
+ * 		\brief	Read the four hexa characters of a \\u escape
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_JSNPAS if they are not four hexa characters
+ */
+static int read_hex4(const char *p, const char *end, unsigned long *cp){
+	int i, v;
+	if(end - p < 4)
+		return ERR_JSNPAS;
+	for(*cp = 0, i = 0; i < 4; i++){
+		v = hexa_value(p[i]);
+		if(v < 0)
+			return ERR_JSNPAS;
+		*cp = (*cp << 4) | (unsigned long) v;
+	}
+	return SUCCEEDED;
+}
+
+/*!	\func	static int put_code(unsigned long cp, char *dst)
+ * 		\brief	Store the character of a \\u escape, as a byte below 0x80 and as UTF-8 above
+ * 		\return	the number of bytes stored, 1 to 4
+ */
+static int put_code(unsigned long cp, char *dst){
+	if(cp < 0x80){
+		dst[0] = (char) cp;
+		return 1;
+	}
+	if(cp < 0x800){
+		dst[0] = (char) (0xC0 | (cp >> 6));
+		dst[1] = (char) (0x80 | (cp & 0x3F));
+		return 2;
+	}
+	if(cp < 0x10000){
+		dst[0] = (char) (0xE0 | (cp >> 12));
+		dst[1] = (char) (0x80 | ((cp >> 6) & 0x3F));
+		dst[2] = (char) (0x80 | (cp & 0x3F));
+		return 3;
+	}
+	dst[0] = (char) (0xF0 | (cp >> 18));
+	dst[1] = (char) (0x80 | ((cp >> 12) & 0x3F));
+	dst[2] = (char) (0x80 | ((cp >> 6) & 0x3F));
+	dst[3] = (char) (0x80 | (cp & 0x3F));
+	return 4;
+}
+
+/*!	\func	static int read_string(jsonin *in, bytes *out)
+ * 		\brief	Read a string, the current character is its opening quote. \n
+ * 					A string without escapes refers to the document, an escaped one is decoded into the
+ * 					scratch buffer of in.
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_JSNPAS if the string is not valid \n
+ * 					ERR_OVRLEN if the scratch buffer is full
+ */
+static int read_string(jsonin *in, bytes *out){
+	const char *p = in->p + 1, *run = p;
+	unsigned long cp, lo;
+	char *dst, ch;
+	int n, room;
+
+	while(p < in->end && *p != '"' && *p != '\\' && (unsigned char) *p >= 0x20)
+		p++;
+	if(p < in->end && *p == '"'){
+		out->bytes = (char*) run;
+		out->length = (int) (p - run);
+		in->decoded = 0;
+		in->p = p + 1;
+		return SUCCEEDED;
+	}
+
+	/* the string is escaped, it is decoded into the scratch buffer */
+	dst = in->scratch + in->used;
+	room = JSON_SCRATCH - in->used;
+	n = (int) (p - run);
+	if(n > room - 4){
+		in->p = p;
+		return json_error(in, ERR_OVRLEN);
+	}
+	memcpy(dst, run, n);
+	for(;;){
+		in->p = p;
+		if(p == in->end)
+			return json_error(in, ERR_JSNPAS);
+		if(*p == '"')
+			break;
+		if((unsigned char) *p < 0x20)
+			return json_error(in, ERR_JSNPAS);
+		if(n > room - 4)
+			return json_error(in, ERR_OVRLEN);
+		if(*p != '\\'){
+			dst[n++] = *p++;
+			continue;
+		}
+		if(++p == in->end)
+			return json_error(in, ERR_JSNPAS);
+		switch(*p++){
+			case '"':	ch = '"'; break;
+			case '\\':	ch = '\\'; break;
+			case '/':	ch = '/'; break;
+			case 'b':	ch = '\b'; break;
+			case 'f':	ch = '\f'; break;
+			case 'n':	ch = '\n'; break;
+			case 'r':	ch = '\r'; break;
+			case 't':	ch = '\t'; break;
+			case 'u':
+				if(read_hex4(p, in->end, &cp) != SUCCEEDED)
+					return json_error(in, ERR_JSNPAS);
+				p += 4;
+				/* a character above 0xFFFF is escaped as a pair of surrogates */
+				if(cp >= 0xDC00 && cp <= 0xDFFF)
+					return json_error(in, ERR_JSNPAS);
+				if(cp >= 0xD800 && cp <= 0xDBFF){
+					if(in->end - p < 6 || p[0] != '\\' || p[1] != 'u' || read_hex4(p + 2, in->end, &lo) != SUCCEEDED
+							|| lo < 0xDC00 || lo > 0xDFFF)
+						return json_error(in, ERR_JSNPAS);
+					p += 6;
+					cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+				}
+				n += put_code(cp, dst + n);
+				continue;
+			default:
+				return json_error(in, ERR_JSNPAS);
+		}
+		dst[n++] = ch;
+	}
+	out->bytes = dst;
+	out->length = n;
+	in->used += n;
+	in->decoded = 1;
+	in->p = p + 1;
+	return SUCCEEDED;
+}
+
+/*!	\func	static int read_key(jsonin *in, bytes *key)
+ * 		\brief	Read the key of a member and the colon after it
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_JSNPAS if there is no key \n
+ * 					the error of ::read_string
+ */
+static int read_key(jsonin *in, bytes *key){
+	int err;
+	skip_space(in);
+	if(in->p == in->end || *in->p != '"')
+		return json_error(in, ERR_JSNPAS);
+	err = read_string(in, key);
+	if(err != SUCCEEDED)
+		return err;
+	return expect(in, ':');
+}
+
+/*!	\func	static int read_value(jsonin *in, bytes *val)
+ * 		\brief	Read the value of a member, it must be a string
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_JSNSYT if the value is of another json type \n
+ * 					ERR_JSNPAS if there is no value \n
+ * 					the error of ::read_string
+ */
+static int read_value(jsonin *in, bytes *val){
+	skip_space(in);
+	if(in->p < in->end && *in->p == '"')
+		return read_string(in, val);
+	if(in->p < in->end && strchr("{[-0123456789tfn", *in->p) != NULL)
+		return json_error(in, ERR_JSNSYT);
+	return json_error(in, ERR_JSNPAS);
+}
+
+/*!	\func	static int next_member(jsonin *in, int *more)
+ * 		\brief	Read the comma before the next member of an object or the brace that closes it
+ * 		\param	more receives 1 if a member follows, 0 if the object is closed
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_JSNPAS if it is neither
+ */
+static int next_member(jsonin *in, int *more){
+	skip_space(in);
+	if(in->p < in->end && (*in->p == ',' || *in->p == '}')){
+		*more = (*in->p == ',');
+		in->p++;
+		return SUCCEEDED;
+	}
+	return json_error(in, ERR_JSNPAS);
+}
+
+/*!	\func	static int open_object(jsonin *in, int *more)
+ * 		\brief	Read the brace that opens an object
+ * 		\param	more receives 1 if the object has a member, 0 if it is empty
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_JSNPAS if there is no object
+ */
+static int open_object(jsonin *in, int *more){
+	int err = expect(in, '{');
+	if(err != SUCCEEDED)
+		return err;
+	skip_space(in);
+	*more = (in->p == in->end || *in->p != '}');
+	if(!*more)
+		in->p++;
+	return SUCCEEDED;
+}
+
+/*!	\func	static int is_key(const bytes *key, const char *name)
+ * 		\brief	Check whether a key is a name
+ */
+static int is_key(const bytes *key, const char *name){
+	return key->length == (int) strlen(name) && memcmp(key->bytes, name, key->length) == 0;
+}
+
+/*!	\func	static int field_index(jsonin *in, const bytes *key, int *idx)
+ * 		\brief	Get the field number of a key of the fields object
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_JSNSYT if the key is not a number \n
+ * 					ERR_IVLFLD if the number is not a field that can be set
+ */
+static int field_index(jsonin *in, const bytes *key, int *idx){
+	int i;
+	if(key->length < 1 || key->length > 3 || (key->length > 1 && key->bytes[0] == '0'))
+		return json_error(in, ERR_JSNSYT);
+	for(*idx = 0, i = 0; i < key->length; i++){
+		if(key->bytes[i] < '0' || key->bytes[i] > '9')
+			return json_error(in, ERR_JSNSYT);
+		*idx = *idx*10 + key->bytes[i] - '0';
+	}
+	/* the bitmap is built when packing */
+	if(*idx == 1 || *idx > 128)
+		return json_error(in, ERR_IVLFLD);
+	return SUCCEEDED;
+}
+
+/*!	\func	static int set_json_field(jsonin *in, const isoplan *plan, int idx, bytes *val, int fmt_flag, bytes *fld, isobitmap *bmp)
+ * 		\brief	Stage the value of a field, a binary one is decoded into the scratch buffer. \n
+ * 					An empty value leaves the field as it is, a field given twice takes its last value.
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_HEXBYT or ERR_B64BYT if a binary value is not encoded as fmt_flag tells \n
+ * 					ERR_OVRLEN if the scratch buffer is full
+ */
+static int set_json_field(jsonin *in, const isoplan *plan, int idx, bytes *val, int fmt_flag, bytes *fld, isobitmap *bmp){
+	char *dst;
+	int n, err;
+
+	if(val->length == 0)
+		return SUCCEEDED;
+	if(plan->def[idx].format == ISO_BINARY){
+		/* an escaped value is already in the scratch buffer, it is decoded in place */
+		if(in->decoded){
+			dst = val->bytes;
+		}else{
+			n = (fmt_flag == FMT_JSON_BASE64)? val->length/4*3 : val->length/2;
+			if(n > JSON_SCRATCH - in->used)
+				return json_error(in, ERR_OVRLEN);
+			dst = in->scratch + in->used;
+		}
+		if(fmt_flag == FMT_JSON_BASE64){
+			err = base64_decode_strict(val->bytes, val->length, dst, &n);
+		}else{
+			err = hexa_decode_strict(val->bytes, val->length, dst);
+			n = val->length/2;
+		}
+		if(err != SUCCEEDED)
+			return fail_isoerr(in->e, err, idx, -1, -1, val->length, ISO_BINARY);
+		if(!in->decoded)
+			in->used += n;
+		val->bytes = dst;
+		val->length = n;
+	}
+	fld[idx] = *val;
+	if(idx != 0)
+		bitmap_set(bmp, idx);
+	return SUCCEEDED;
+}
+
+/*!	\func	static int parse_fields(jsonin *in, const isoplan *plan, int fmt_flag, bytes *fld, isobitmap *bmp)
+ * 		\brief	Read the fields object of a document
+ * 		\return	SUCCEEDED if having no error \n
+ * 					the first error met in the object
+ */
+static int parse_fields(jsonin *in, const isoplan *plan, int fmt_flag, bytes *fld, isobitmap *bmp){
+	bytes key, val;
+	int idx = 0, more, err;
+
+	err = open_object(in, &more);
+	while(err == SUCCEEDED && more){
+		err = read_key(in, &key);
+		if(err == SUCCEEDED)
+			err = field_index(in, &key, &idx);
+		if(err == SUCCEEDED)
+			err = read_value(in, &val);
+		if(err == SUCCEEDED)
+			err = set_json_field(in, plan, idx, &val, fmt_flag, fld, bmp);
+		if(err == SUCCEEDED)
+			err = next_member(in, &more);
+	}
+	return err;
+}
+
+/*!	\func	static int parse_json(jsonin *in, const isoplan *plan, int fmt_flag, bytes *fld, isobitmap *bmp)
+ * 		\brief	Read a document into an array of fields and the bitmap of the present ones. \n
+ * 					The members are the MTI and the fields object, in any order, any other member is an error.
+ * 		\param	fld receives the fields, fld[0] and the entries of the fields in bmp are set
+ * 		\param	bmp receives the present fields 2..128
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_JSNPAS if the document is not well formed \n
+ * 					ERR_JSNSYT if it is not of the form of an iso message \n
+ * 					the first error met in the fields
+ */
+static int parse_json(jsonin *in, const isoplan *plan, int fmt_flag, bytes *fld, isobitmap *bmp){
+	bytes key, val;
+	int more, err;
+
+	empty_bytes(&fld[0]);
+	bitmap_clear(bmp);
+	err = open_object(in, &more);
+	while(err == SUCCEEDED && more){
+		err = read_key(in, &key);
+		if(err != SUCCEEDED)
+			return err;
+		if(is_key(&key, JSON_MTI_KEY)){
+			err = read_value(in, &val);
+			if(err == SUCCEEDED)
+				err = set_json_field(in, plan, 0, &val, fmt_flag, fld, bmp);
+		}else if(is_key(&key, JSON_FIELDS_KEY)){
+			err = parse_fields(in, plan, fmt_flag, fld, bmp);
+		}else{
+			err = json_error(in, ERR_JSNSYT);
+		}
+		if(err == SUCCEEDED)
+			err = next_member(in, &more);
+	}
+	if(err != SUCCEEDED)
+		return err;
+	skip_space(in);
+	if(in->p != in->end)
+		return json_error(in, ERR_JSNPAS);
+	return SUCCEEDED;
+}
+
+/*!	\func	int json_to_iso_buf(const isoplan *plan, const char *json, int json_len, int fmt_flag, char *buf, int size, int *iso_len, isoerr *err);
+ * 		\brief	Convert a json document to an iso message. \n
+ * 					The fields are staged as references into the document and packed by ::pack_fields,
+ * 					which validates them against the definition of plan. The escaped and the binary values
+ * 					are decoded into a buffer on the stack, nothing is allocated.
+ * 		\param	plan is an ::isoplan compiled by ::compile_plan
+ * 		\param	json is the json document
+ * 		\param	json_len is the length of json
+ * 		\param	fmt_flag is FMT_JSON or FMT_JSON_BASE64, it tells how the binary fields are encoded
+ * 		\param	buf is the caller buffer that receives the message
+ * 		\param	size is the number of bytes available in buf
+ * 		\param	iso_len receives the length of the message, the required size if buf is too small
+ * 		\param	err is the error context that receives the error, NULL to log the error. The offset of
+ * 					an error of the document is its offset in json.
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_NODFMT if fmt_flag is not a json format \n
+ * 					ERR_JSNPAS if the document is not well formed \n
+ * 					ERR_JSNSYT if it is not of the form of an iso message \n
+ * 					the first error met in the fields of the document \n
+ * 					the error of ::pack_fields
+ */
+int json_to_iso_buf(const isoplan *plan, const char *json, int json_len, int fmt_flag, char *buf, int size, int *iso_len, isoerr *err){
+	isoerr local, *e = (err != NULL)? err : &local;
+	char scratch[JSON_SCRATCH];
+	bytes fld[129];
+	isobitmap bmp;
+	jsonin in;
+	int ret;
+
+	*iso_len = 0;
+	e->code = SUCCEEDED;
+	ret = check_format(fmt_flag, e);
+	if(ret != SUCCEEDED)
+		return report_isoerr(err, e, ret);
+	in.start = json;
+	in.p = json;
+	in.end = json + json_len;
+	in.scratch = scratch;
+	in.used = 0;
+	in.decoded = 0;
+	in.e = e;
+	ret = parse_json(&in, plan, fmt_flag, fld, &bmp);
+	if(ret == SUCCEEDED)
+		ret = pack_fields(plan, &bmp, fld, buf, size, iso_len, e);
+	/* as ::pack_fields, a buffer that is too small is never logged */
+	return (ret == ERR_SHTBUF)? ret : report_isoerr(err, e, ret);
+}
+
+/*!	\func		char* json_to_iso(const char *json, int json_len, const isodef *def, const msgprop *prop, int fmt_flag, int *iso_len);
+ * 		\brief		convert a json document to an iso message
+ * 		\param		json is the json document
+ * 		\param		json_len is the length of json
+ * 		\param 	def is an array of ::isodef structures which refers to all data element definitions of  an iso standard
+ * 		\param		prop  the properties of the iso message (bitmap format, padding characters)
+ * 		\param		fmt_flag is FMT_JSON or FMT_JSON_BASE64, it tells how the binary fields are encoded
+ * 		\param		iso_len receives the length of the message
+ * 		\return		the iso message, the caller frees it \n
+ * 						NULL in case having an error
+ */
+char* json_to_iso(const char *json, int json_len, const isodef *def, const msgprop *prop, int fmt_flag, int *iso_len){
+	char buf[ISO_MAX_LENGTH];
+	char *iso;
+	isoplan plan;
+	int err;
+
+	*iso_len = 0;
+	err = compile_plan(&plan, def, prop, NULL);
+	/* the callees log their own errors */
+	if(err != SUCCEEDED)
+		return NULL;
+	err = json_to_iso_buf(&plan, json, json_len, fmt_flag, buf, sizeof(buf), iso_len, NULL);
+	if(err != SUCCEEDED){
+		*iso_len = 0;
+		return NULL;
+	}
+	iso = (char*) malloc(*iso_len);
+	if(iso == NULL){
+		handle_err(ERR_OUTMEM, SYS, "Can not allocate the iso message");
+		*iso_len = 0;
+		return NULL;
+	}
+	memcpy(iso, buf, *iso_len);
+	return iso;
+}
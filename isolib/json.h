@@ -0,0 +1,22 @@
+/*!	\file		json.h
+ * 		\brief	Conversion between iso messages and json documents of the form
+ * 				{"mti":"...","fields":{"2":"...",...}}, without any json library
+ */
+#ifndef JSON_H_
+#define JSON_H_
+
+#include "iso8583.h"
+
+/*!	\brief	Write a packed iso message as a json document without unpacking it */
+int write_iso_json(isowriter *w, const isoplan *plan, const char *iso_msg, int iso_len, int fmt_flag, isoerr *err);
+
+/*!	\brief	Convert an iso message to a json document, the caller frees it */
+char* iso_to_json(const char *iso_msg, int iso_len, const isodef *def, const msgprop *prop, int fmt_flag);
+
+/*!	\brief	Convert a json document to an iso message written into a caller buffer */
+int json_to_iso_buf(const isoplan *plan, const char *json, int json_len, int fmt_flag, char *buf, int size, int *iso_len, isoerr *err);
+
+/*!	\brief	Convert a json document to an iso message, the caller frees it */
+char* json_to_iso(const char *json, int json_len, const isodef *def, const msgprop *prop, int fmt_flag, int *iso_len);
+
+#endif /*JSON_H_*/
@@ -0,0 +1,174 @@
+/*!	\file		msgpool.c
+ * 		\brief	This file implements the message pool. \n
+ * 					Each thread keeps a free list of messages, so acquiring and releasing takes no lock.
+ * 					A message keeps its arena while it is free, so a recycled message fills its fields
+ * 					without calling malloc. The messages a thread has too many of go to a shared list,
+ * 					bounded and protected by a mutex, that the other threads take from before allocating.
+ */
+#include <stdlib.h>
+#include <pthread.h>
+#include "msgpool.h"
+#include "errors.h"
+
+/*!	\struct		poollist
+ * 		\brief		A list of free messages
+ */
+typedef struct {
+	poolmsg *head;
+	int count;
+} poollist;
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static pthread_key_t pool_key;
+static pthread_mutex_t global_lock = PTHREAD_MUTEX_INITIALIZER;
+static poollist global_pool = {NULL, 0};
+
+/*!	\func	static void give_back(poolmsg *p)
+ * 		\brief	Put a free message on the shared list, or free it if the list is full
+ */
+static void give_back(poolmsg *p){
+	pthread_mutex_lock(&global_lock);
+	if(global_pool.count < POOL_GLOBAL_MAX){
+		p->next = global_pool.head;
+		global_pool.head = p;
+		global_pool.count++;
+		p = NULL;
+	}
+	pthread_mutex_unlock(&global_lock);
+	if(p != NULL){
+		free_arena(&p->arena);
+		free(p);
+	}
+}
+
+/*!	\func	static void free_local(void *data)
+ * 		\brief	Hand the free messages of an exiting thread over to the shared list
+ */
+static void free_local(void *data){
+	poollist *local = (poollist*) data;
+	poolmsg *p, *next;
+	for(p = local->head; p != NULL; p = next){
+		next = p->next;
+		give_back(p);
+	}
+	free(local);
+}
+
+static void create_key(void){
+	pthread_key_create(&pool_key, free_local);
+}
+
+/*!	\func	static poollist* local_pool(void)
+ * 		\brief	Get the free list of the calling thread, it is created on first use
+ * 		\return	the list, NULL if it can't be allocated
+ */
+static poollist* local_pool(void){
+	poollist *local;
+	pthread_once(&pool_once, create_key);
+	local = (poollist*) pthread_getspecific(pool_key);
+	if(local == NULL){
+		local = (poollist*) calloc(1, sizeof(poollist));
+		if(local == NULL)
+			return NULL;
+		if(pthread_setspecific(pool_key, local) != 0){
+			free(local);
+			return NULL;
+		}
+	}
+	return local;
+}
+
+/*!	\func	isomsg* acquire_message(const isoplan *plan);
+ * 		\brief	Take an empty message from the pool. \n
+ * 					The free list of the calling thread is tried first, then the shared list, then a new
+ * 					message is allocated. The message is in arena mode, see ::set_arena, so its fields
+ * 					come from storage that is kept when it is released.
+ * 		\param	plan is an ::isoplan compiled by ::compile_plan, it must outlive the message
+ * 		\return	the message, initialized as by ::init_message_plan \n
+ * 					NULL if no memory is available
+ */
+isomsg* acquire_message(const isoplan *plan){
+	poollist *local = local_pool();
+	poolmsg *p = NULL;
+
+	if(local != NULL && local->head != NULL){
+		p = local->head;
+		local->head = p->next;
+		local->count--;
+	}else{
+		pthread_mutex_lock(&global_lock);
+		if(global_pool.head != NULL){
+			p = global_pool.head;
+			global_pool.head = p->next;
+			global_pool.count--;
+		}
+		pthread_mutex_unlock(&global_lock);
+	}
+	if(p == NULL){
+		p = (poolmsg*) malloc(sizeof(poolmsg));
+		if(p == NULL){
+			handle_err(ERR_OUTMEM, SYS, "Can't allocate memory for a pooled message");
+			return NULL;
+		}
+		init_arena(&p->arena, 0);
+	}
+	p->next = NULL;
+	init_message_plan(&p->msg, plan);
+	p->msg.arena = &p->arena;
+	return &p->msg;
+}
+
+/*!	\func	void release_message(isomsg *m);
+ * 		\brief	Give a message back to the pool. \n
+ * 					Its fields are dropped by resetting its arena, the arena keeps its chunks.
+ * 					Any thread can release a message, it joins the free list of the releasing thread.
+ * 		\param	m is a message taken by ::acquire_message, it must not be used afterwards
+ */
+void release_message(isomsg *m){
+	poolmsg *p = (poolmsg*) m;
+	poollist *local;
+
+	if(m == NULL)
+		return;
+	/* the fields may have been moved to the heap by set_arena */
+	free_message(m);
+	m->arena = &p->arena;
+	reset_arena(&p->arena);
+	local = local_pool();
+	if(local != NULL && local->count < POOL_LOCAL_MAX){
+		p->next = local->head;
+		local->head = p;
+		local->count++;
+	}else{
+		give_back(p);
+	}
+}
+
+/*!	\func	void drain_message_pool(void);
+ * 		\brief	Free the free messages of the calling thread and of the shared list. \n
+ * 					The messages that are acquired are not affected.
+ */
+void drain_message_pool(void){
+	poollist *local = local_pool();
+	poolmsg *p, *next, *shared;
+
+	if(local != NULL){
+		for(p = local->head; p != NULL; p = next){
+			next = p->next;
+			free_arena(&p->arena);
+			free(p);
+		}
+		local->head = NULL;
+		local->count = 0;
+	}
+	pthread_mutex_lock(&global_lock);
+	shared = global_pool.head;
+	global_pool.head = NULL;
+	global_pool.count = 0;
+	pthread_mutex_unlock(&global_lock);
+	for(p = shared; p != NULL; p = next){
+		next = p->next;
+		free_arena(&p->arena);
+		free(p);
+	}
+}
@@ -0,0 +1,34 @@
+/*!	\file		msgpool.h
+ * 		\brief	A pool of ISO messages whose field storage is recycled
+ */
+#ifndef MSGPOOL_H_
+#define MSGPOOL_H_
+
+#include "iso8583.h"
+#include "arena.h"
+
+#define POOL_LOCAL_MAX		64		/*!	\brief	The number of free messages a thread keeps for itself */
+#define POOL_GLOBAL_MAX		1024	/*!	\brief	The number of free messages the threads share, the others are freed */
+
+/*!	\struct		poolmsg
+ * 		\brief		A pooled message and the arena that holds its fields
+ */
+typedef struct poolmsg {
+	/*! \brief The message, it is the first member so a message pointer is a ::poolmsg pointer */
+	isomsg msg;
+	/*! \brief The storage of the fields, its chunks are kept while the message is in the pool */
+	isoarena arena;
+	/*! \brief The next free message */
+	struct poolmsg *next;
+} poolmsg;
+
+/*!	\brief	Take an empty message from the pool of the calling thread, it is packed with plan */
+isomsg* acquire_message(const isoplan *plan);
+
+/*!	\brief	Give a message taken by ::acquire_message back to the pool of the calling thread */
+void release_message(isomsg *m);
+
+/*!	\brief	Free the messages of the pool of the calling thread and of the shared pool */
+void drain_message_pool(void);
+
+#endif /*MSGPOOL_H_*/
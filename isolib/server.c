@@ -0,0 +1,518 @@
+/*!	\file		server.c
+ * 		\brief	This file implements the ISO 8583 server. \n
+ * 					The sockets are non-blocking and registered once, edge-triggered, for input and output,
+ * 					so a connection is read and written until the kernel has nothing more to give or take.
+ * 					The bytes read are fed to the ::isostream of the connection, a decoder is taken from
+ * 					a pool when a message starts and given back when it is complete, so the idle
+ * 					connections only hold their socket. A response is written straight to the socket, only
+ * 					what the socket does not take is copied into the output buffer of the connection.
+ */
+#define _GNU_SOURCE		/* accept4 */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "server.h"
+#include "errors.h"
+
+#define SERVER_MAX_CONNS		65536		/*!	\brief	The number of connections a server accepts by default */
+#define SERVER_WAIT_MS			1000		/*!	\brief	How long ::run_server waits for events before it checks whether it is stopped */
+
+/*!	\func	static isostream* take_stream(isoserver *srv)
+ * 		\brief	Take an idle decoder from the pool of a server, or allocate one
+ * 		\return	the decoder \n
+ * 					NULL if it can't be allocated
+ */
+static isostream* take_stream(isoserver *srv){
+	isostream *s;
+	if(srv->nfree > 0)
+		return srv->free_streams[--srv->nfree];
+	s = (isostream*) malloc(sizeof(isostream));
+	if(s == NULL)
+		return NULL;
+	init_stream_plan(s, srv->plan, srv->hdr_type, srv->hdr_len, srv->err);
+	return s;
+}
+
+/*!	\func	static void give_stream(isoserver *srv, isostream *s)
+ * 		\brief	Give a decoder back to the pool of a server, it is freed if the pool is full
+ */
+static void give_stream(isoserver *srv, isostream *s){
+	if(srv->nfree < SERVER_FREE_STREAMS){
+		reset_stream(s);
+		srv->free_streams[srv->nfree++] = s;
+	}else{
+		free(s);
+	}
+}
+
+/*!	\func	static int make_header(const isoserver *srv, int len, char *hdr)
+ * 		\brief	Write the length header of a message of len bytes
+ * 		\return	the length of the header \n
+ * 					-1 if len doesn't fit the header
+ */
+static int make_header(const isoserver *srv, int len, char *hdr){
+	int i, n = len;
+
+	if(srv->hdr_type == STREAM_HDR_NONE)
+		return 0;
+	for(i = srv->hdr_len - 1; i >= 0; i--){
+		if(srv->hdr_type == STREAM_HDR_BINARY){
+			hdr[i] = (char) (n & 0xFF);
+			n >>= 8;
+		}else{
+			hdr[i] = '0' + n % 10;
+			n /= 10;
+		}
+	}
+	return (n == 0)? srv->hdr_len : -1;
+}
+
+/*!	\func	static int queue_output(isoconn *c, const char *data, int len)
+ * 		\brief	Keep the output that the socket has not taken, the connection is no longer read if it is too much
+ * 		\return	SUCCEEDED if having no error \n
+ * 					the error of ::bytebuf_append
+ */
+static int queue_output(isoconn *c, const char *data, int len){
+	int err = bytebuf_append(&c->out, data, len);
+	if(err == SUCCEEDED && c->out.data.length > SERVER_MAX_PENDING)
+		c->blocked = 1;
+	return err;
+}
+
+/*!	\func	static int send_framed(isoconn *c, const char *msg, int len)
+ * 		\brief	Send a message with its length header, straight to the socket if no output is pending
+ * 		\return	SUCCEEDED if the message is sent or queued \n
+ * 					ERR_OVRLEN if the message is too long for the length header \n
+ * 					ERR_IOWRIT if the socket fails \n
+ * 					ERR_OUTMEM if the output can't be queued
+ */
+static int send_framed(isoconn *c, const char *msg, int len){
+	char hdr[STREAM_MAX_HDR];
+	struct iovec iov[2];
+	struct msghdr mh;
+	ssize_t n = 0;
+	int hlen, err;
+
+	hlen = make_header(c->srv, len, hdr);
+	if(hlen < 0)
+		return ERR_OVRLEN;
+	if(c->out.data.length == 0){
+		iov[0].iov_base = hdr;
+		iov[0].iov_len = hlen;
+		iov[1].iov_base = (char*) msg;
+		iov[1].iov_len = len;
+		memset(&mh, 0, sizeof(mh));
+		mh.msg_iov = iov;
+		mh.msg_iovlen = 2;
+		do{
+			n = sendmsg(c->fd, &mh, MSG_NOSIGNAL);
+		}while(n < 0 && errno == EINTR);
+		if(n < 0){
+			if(errno != EAGAIN && errno != EWOULDBLOCK)
+				return ERR_IOWRIT;
+			n = 0;
+		}
+		if(n == hlen + len)
+			return SUCCEEDED;
+	}
+	/* the socket is full, keep the rest for the next output event */
+	if(n < hlen){
+		err = queue_output(c, hdr + n, hlen - n);
+		if(err != SUCCEEDED)
+			return err;
+		n = hlen;
+	}
+	return queue_output(c, msg + (n - hlen), len - (int) (n - hlen));
+}
+
+/*!	\func	static int flush_output(isoconn *c)
+ * 		\brief	Write the pending output of a connection until the socket is full
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_IOWRIT if the socket fails
+ */
+static int flush_output(isoconn *c){
+	ssize_t n;
+
+	while(c->out.data.length > 0){
+		n = send(c->fd, c->out.data.bytes, c->out.data.length, MSG_NOSIGNAL);
+		if(n < 0){
+			if(errno == EINTR)
+				continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+				return SUCCEEDED;
+			return ERR_IOWRIT;
+		}
+		c->out.data.bytes += n;
+		c->out.data.length -= n;
+	}
+	/* an idle connection keeps no memory */
+	free_bytebuf(&c->out);
+	c->blocked = 0;
+	return SUCCEEDED;
+}
+
+/*!	\func	static int dispatch(isoconn *c, isoview *req)
+ * 		\brief	Give a message to the handler of the server and send its response
+ * 		\return	SUCCEEDED if having no error \n
+ * 					the error of ::send_framed
+ */
+static int dispatch(isoconn *c, isoview *req){
+	isoserver *srv = c->srv;
+	int resp_len = 0, ret, err = SUCCEEDED;
+
+	ret = srv->handler(c, req, srv->wbuf, sizeof(srv->wbuf), &resp_len, srv->arg);
+	if(resp_len > 0)
+		err = send_framed(c, srv->wbuf, resp_len);
+	if(ret == SERVER_CLOSE)
+		c->closing = 1;
+	return err;
+}
+
+/*!	\func	static int read_input(isoconn *c)
+ * 		\brief	Read a connection until the socket is empty, and handle each message received
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_CONCLS if the peer has closed the connection \n
+ * 					ERR_IOREAD if the socket fails \n
+ * 					the error of ::stream_feed if the stream is out of frame
+ */
+static int read_input(isoconn *c){
+	isoserver *srv = c->srv;
+	ssize_t n;
+	int off, used, ret, err;
+
+	while(!c->blocked && !c->closing){
+		n = recv(c->fd, srv->rbuf, sizeof(srv->rbuf), 0);
+		if(n < 0){
+			if(errno == EINTR)
+				continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+				return SUCCEEDED;
+			return ERR_IOREAD;
+		}
+		if(n == 0)
+			return ERR_CONCLS;
+		for(off = 0; off < n && !c->closing; off += used){
+			if(c->stream == NULL && (c->stream = take_stream(srv)) == NULL)
+				return ERR_OUTMEM;
+			ret = stream_feed(c->stream, srv->rbuf + off, (int) n - off, &used);
+			if(ret == STREAM_MSG){
+				err = dispatch(c, &c->stream->view);
+				if(err != SUCCEEDED)
+					return err;
+			}else if(ret != STREAM_MORE){
+				return ret;
+			}
+			/* the decoder is kept only while a message is partially received */
+			if(!stream_pending(c->stream)){
+				give_stream(srv, c->stream);
+				c->stream = NULL;
+			}
+		}
+	}
+	return SUCCEEDED;
+}
+
+/*!	\func	static void serve(isoconn *c, unsigned int events)
+ * 		\brief	Process the events of a connection
+ */
+static void serve(isoconn *c, unsigned int events){
+	int err = SUCCEEDED, resumed = 0;
+
+	if(events & EPOLLERR){
+		close_connection(c);
+		return;
+	}
+	if((events & EPOLLOUT) && c->out.data.length > 0){
+		resumed = c->blocked;
+		err = flush_output(c);
+		resumed = resumed && !c->blocked;
+	}
+	/* a connection that was blocked may have input that no event will tell about */
+	if(err == SUCCEEDED && (resumed || (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))))
+		err = read_input(c);
+	if(err != SUCCEEDED || (c->closing && c->out.data.length == 0))
+		close_connection(c);
+}
+
+/*!	\func	static void accept_connections(isoserver *srv)
+ * 		\brief	Accept the connections waiting on the listening socket
+ */
+static void accept_connections(isoserver *srv){
+	char errmsg[100];
+	int fd;
+
+	for(;;){
+		fd = accept4(srv->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if(fd < 0){
+			if(errno == EINTR || errno == ECONNABORTED)
+				continue;
+			if(errno != EAGAIN && errno != EWOULDBLOCK){
+				/* e.g. out of descriptors, the waiting connections are accepted with the next one */
+				sprintf(errmsg, "Can not accept a connection, errno %d", errno);
+				handle_err(ERR_SOCKET, SYS, errmsg);
+			}
+			return;
+		}
+		if(srv->nconns >= srv->max_conns || add_connection(srv, fd, NULL) != SUCCEEDED)
+			close(fd);
+	}
+}
+
+/*!	\func	int init_server(isoserver *srv, const isoplan *plan, int hdr_type, int hdr_len, isohandler handler, void *arg, isoerr *err);
+ * 		\brief	Initialize a server. Its messages are decoded with plan and framed by a length header, the
+ * 					responses are framed by the same header. It accepts SERVER_MAX_CONNS connections, the
+ * 					caller may change srv->max_conns.
+ * 		\param	srv is the ::isoserver to initialize
+ * 		\param	plan is an ::isoplan compiled by ::compile_plan, it must outlive srv
+ * 		\param	hdr_type is STREAM_HDR_NONE, STREAM_HDR_ASCII or STREAM_HDR_BINARY
+ * 		\param	hdr_len is the length of the header, 1 to STREAM_MAX_HDR, ignored for STREAM_HDR_NONE
+ * 		\param	handler is called for each message received
+ * 		\param	arg is given to handler
+ * 		\param	err is the error context of the streams of the connections and of the messages given to
+ * 					handler, NULL to log their errors. With a context, the frames rejected from the peers
+ * 					are neither formatted nor logged, the connections that send them are closed.
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_IVLFLG if the header is not valid \n
+ * 					ERR_SOCKET if the epoll instance can't be created
+ */
+int init_server(isoserver *srv, const isoplan *plan, int hdr_type, int hdr_len, isohandler handler, void *arg, isoerr *err){
+	isoerr local, *e = (err != NULL)? err : &local;
+
+	e->code = SUCCEEDED;
+	if(hdr_type == STREAM_HDR_NONE){
+		hdr_len = 0;
+	}else if((hdr_type != STREAM_HDR_ASCII && hdr_type != STREAM_HDR_BINARY) || hdr_len < 1 || hdr_len > STREAM_MAX_HDR){
+		return report_isoerr(err, e, fail_isoerr(e, ERR_IVLFLG, -1, -1, STREAM_MAX_HDR, hdr_len, -1));
+	}
+	srv->plan = plan;
+	srv->err = err;
+	srv->hdr_type = hdr_type;
+	srv->hdr_len = hdr_len;
+	srv->handler = handler;
+	srv->arg = arg;
+	srv->nconns = 0;
+	srv->max_conns = SERVER_MAX_CONNS;
+	srv->running = 0;
+	srv->conns = NULL;
+	srv->nfree = 0;
+	srv->listen_fd = -1;
+	srv->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if(srv->epfd < 0){
+		handle_err(ERR_SOCKET, SYS, "Can not create the epoll instance of the server");
+		return ERR_SOCKET;
+	}
+	return SUCCEEDED;
+}
+
+/*!	\func	int listen_server(isoserver *srv, const char *host, int port, int backlog);
+ * 		\brief	Make a server listen on a TCP port, a server has one listening socket
+ * 		\param	srv is an ::isoserver initialized by ::init_server
+ * 		\param	host is the IPv4 address to listen on, NULL for every address
+ * 		\param	port is the TCP port
+ * 		\param	backlog is the length of the queue of the connections not accepted yet, 0 for the system maximum
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_IVLFLG if the server is already listening \n
+ * 					ERR_SOCKET if the socket can't be set up
+ */
+int listen_server(isoserver *srv, const char *host, int port, int backlog){
+	struct sockaddr_in addr;
+	struct epoll_event ev;
+	char errmsg[100];
+	int fd, on = 1;
+
+	if(srv->listen_fd >= 0)
+		return ERR_IVLFLG;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((unsigned short) port);
+	if(host == NULL){
+		addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	}else if(inet_pton(AF_INET, host, &addr.sin_addr) != 1){
+		sprintf(errmsg, "The address %.64s is not an IPv4 address", host);
+		handle_err(ERR_SOCKET, SYS, errmsg);
+		return ERR_SOCKET;
+	}
+	fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if(fd < 0
+			|| setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0
+			|| bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0
+			|| listen(fd, (backlog > 0)? backlog : SOMAXCONN) < 0){
+		sprintf(errmsg, "Can not listen on port %d, errno %d", port, errno);
+		handle_err(ERR_SOCKET, SYS, errmsg);
+		if(fd >= 0)
+			close(fd);
+		return ERR_SOCKET;
+	}
+	/* the listening socket is the event without a connection */
+	ev.events = EPOLLIN | EPOLLET;
+	ev.data.ptr = NULL;
+	if(epoll_ctl(srv->epfd, EPOLL_CTL_ADD, fd, &ev) < 0){
+		handle_err(ERR_SOCKET, SYS, "Can not register the listening socket");
+		close(fd);
+		return ERR_SOCKET;
+	}
+	srv->listen_fd = fd;
+	return SUCCEEDED;
+}
+
+/*!	\func	int add_connection(isoserver *srv, int fd, isoconn **conn);
+ * 		\brief	Serve a socket that is already connected. It is made non-blocking, the server closes it
+ * 					when the connection ends.
+ * 		\param	srv is an ::isoserver initialized by ::init_server
+ * 		\param	fd is the connected socket
+ * 		\param	conn receives the connection, it may be NULL
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_OUTRAG if the server has srv->max_conns connections \n
+ * 					ERR_OUTMEM if the connection can't be allocated \n
+ * 					ERR_SOCKET if the socket can't be registered
+ */
+int add_connection(isoserver *srv, int fd, isoconn **conn){
+	struct epoll_event ev;
+	isoconn *c;
+	int on = 1, flags;
+
+	if(srv->nconns >= srv->max_conns)
+		return ERR_OUTRAG;
+	flags = fcntl(fd, F_GETFL, 0);
+	if(flags < 0 || (!(flags & O_NONBLOCK) && fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0))
+		return ERR_SOCKET;
+	/* the messages are small requests and responses, they must not wait for Nagle's algorithm */
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	c = (isoconn*) malloc(sizeof(isoconn));
+	if(c == NULL)
+		return ERR_OUTMEM;
+	c->fd = fd;
+	c->stream = NULL;
+	init_bytebuf(&c->out);
+	c->blocked = 0;
+	c->closing = 0;
+	c->user = NULL;
+	c->srv = srv;
+	ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	ev.data.ptr = c;
+	if(epoll_ctl(srv->epfd, EPOLL_CTL_ADD, fd, &ev) < 0){
+		free(c);
+		return ERR_SOCKET;
+	}
+	c->prev = NULL;
+	c->next = srv->conns;
+	if(srv->conns != NULL)
+		srv->conns->prev = c;
+	srv->conns = c;
+	srv->nconns++;
+	if(conn != NULL)
+		*conn = c;
+	return SUCCEEDED;
+}
+
+/*!	\func	int poll_server(isoserver *srv, int timeout_ms);
+ * 		\brief	Wait for the events of the sockets of a server and process them: the connections are
+ * 					accepted, read, handled and written until their sockets are empty or full.
+ * 		\param	srv is an ::isoserver initialized by ::init_server
+ * 		\param	timeout_ms is the longest wait in milliseconds, -1 to wait for an event
+ * 		\return	SUCCEEDED if having no error, or if the wait is interrupted by a signal \n
+ * 					ERR_SOCKET if the epoll instance fails
+ */
+int poll_server(isoserver *srv, int timeout_ms){
+	struct epoll_event ev[SERVER_MAX_EVENTS];
+	int i, n;
+
+	n = epoll_wait(srv->epfd, ev, SERVER_MAX_EVENTS, timeout_ms);
+	if(n < 0)
+		return (errno == EINTR)? SUCCEEDED : ERR_SOCKET;
+	/* a connection is in the list once, so the one closed by an event has no later event */
+	for(i = 0; i < n; i++){
+		if(ev[i].data.ptr == NULL)
+			accept_connections(srv);
+		else
+			serve((isoconn*) ev[i].data.ptr, ev[i].events);
+	}
+	return SUCCEEDED;
+}
+
+/*!	\func	int run_server(isoserver *srv);
+ * 		\brief	Process the events of the sockets of a server until ::stop_server is called
+ * 		\param	srv is an ::isoserver initialized by ::init_server
+ * 		\return	SUCCEEDED once stopped \n
+ * 					ERR_SOCKET if the epoll instance fails
+ */
+int run_server(isoserver *srv){
+	int err = SUCCEEDED;
+	srv->running = 1;
+	while(srv->running && err == SUCCEEDED)
+		err = poll_server(srv, SERVER_WAIT_MS);
+	return err;
+}
+
+/*!	\func	void stop_server(isoserver *srv);
+ * 		\brief	Make ::run_server return after the events it is processing, it may be called by a handler
+ * 					or by a signal handler
+ * 		\param	srv is an ::isoserver run by ::run_server
+ */
+void stop_server(isoserver *srv){
+	srv->running = 0;
+}
+
+/*!	\func	int server_send(isoconn *c, const char *msg, int len);
+ * 		\brief	Send a packed message that is not a response, e.g. a network management request or an
+ * 					advice. It is framed by the length header of the server.
+ * 		\param	c is a connection of a server
+ * 		\param	msg is the packed message
+ * 		\param	len is the length of msg
+ * 		\return	SUCCEEDED if the message is sent, or queued until the socket takes it \n
+ * 					the error of ::send_framed, the connection should then be closed
+ */
+int server_send(isoconn *c, const char *msg, int len){
+	return send_framed(c, msg, len);
+}
+
+/*!	\func	void close_connection(isoconn *c);
+ * 		\brief	Close a connection and free it, its output that is not sent is dropped. \n
+ * 					A handler doesn't close the connection of its message, it returns SERVER_CLOSE.
+ * 		\param	c is a connection of a server
+ */
+void close_connection(isoconn *c){
+	isoserver *srv = c->srv;
+
+	epoll_ctl(srv->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+	close(c->fd);
+	if(c->stream != NULL)
+		give_stream(srv, c->stream);
+	free_bytebuf(&c->out);
+	if(c->prev != NULL)
+		c->prev->next = c->next;
+	else
+		srv->conns = c->next;
+	if(c->next != NULL)
+		c->next->prev = c->prev;
+	srv->nconns--;
+	free(c);
+}
+
+/*!	\func	void close_server(isoserver *srv);
+ * 		\brief	Close the connections, the listening socket and the epoll instance of a server and free
+ * 					its decoders
+ * 		\param	srv is an ::isoserver initialized by ::init_server
+ */
+void close_server(isoserver *srv){
+	while(srv->conns != NULL)
+		close_connection(srv->conns);
+	while(srv->nfree > 0)
+		free(srv->free_streams[--srv->nfree]);
+	if(srv->listen_fd >= 0)
+		close(srv->listen_fd);
+	srv->listen_fd = -1;
+	if(srv->epfd >= 0)
+		close(srv->epfd);
+	srv->epfd = -1;
+}
@@ -0,0 +1,115 @@
+/*!	\file		server.h
+ * 		\brief	A single threaded ISO 8583 server, an edge-triggered epoll reactor over non-blocking sockets. \n
+ * 				Each connection is decoded by an ::isostream, the messages are framed by a length header
+ * 				as the streams are. A handler receives each message as a view and packs its response.
+ */
+#ifndef SERVER_H_
+#define SERVER_H_
+
+#include "iso8583.h"
+#include "bytebuf.h"
+#include "stream.h"
+
+#define SERVER_MAX_EVENTS		256			/*!	\brief	The number of events taken by one epoll_wait */
+#define SERVER_READ_SIZE		16384		/*!	\brief	The size of the read buffer shared by the connections */
+#define SERVER_FREE_STREAMS		64			/*!	\brief	The number of idle stream decoders kept for reuse */
+#define SERVER_MAX_PENDING		65536		/*!	\brief	The output a connection may have pending before it is no longer read */
+
+#define SERVER_CLOSE			(-1)		/*!	\brief	A handler returns it to close the connection */
+
+typedef struct isoconn isoconn;
+typedef struct isoserver isoserver;
+
+/*!	\brief	The handler of the messages of a server. \n
+ * 			req is the message received, it is valid during the call only. The handler packs the response
+ * 			into resp, of resp_size bytes, and sets *resp_len, which it leaves to 0 to send nothing.
+ * 			It returns SUCCEEDED, or SERVER_CLOSE to close the connection once the response is sent.
+ */
+typedef int (*isohandler)(isoconn *c, isoview *req, char *resp, int resp_size, int *resp_len, void *arg);
+
+/*!	\struct		isoconn
+ * 		\brief		A connection of a server
+ */
+struct isoconn {
+	/*! \brief The socket of the connection */
+	int fd;
+	/*! \brief The decoder of the message being received, NULL between two messages */
+	isostream *stream;
+	/*! \brief The output that the socket has not taken yet */
+	bytebuf out;
+	/*! \brief Whether the connection is no longer read until its output is sent */
+	int blocked;
+	/*! \brief Whether the connection is closed once its output is sent */
+	int closing;
+	/*! \brief The data of the caller */
+	void *user;
+	/*! \brief The server of the connection */
+	isoserver *srv;
+	/*! \brief The other connections of the server */
+	isoconn *prev;
+	isoconn *next;
+};
+
+/*!	\struct		isoserver
+ * 		\brief		The state of a server
+ */
+struct isoserver {
+	/*! \brief The epoll instance and the listening socket, -1 if there is none */
+	int epfd;
+	int listen_fd;
+	/*! \brief The compiled plan of the messages */
+	const isoplan *plan;
+	/*! \brief The kind and the length of the length header, as ::init_stream takes them */
+	int hdr_type;
+	int hdr_len;
+	/*! \brief The error context of the streams and of the messages, NULL to have their errors logged */
+	isoerr *err;
+	/*! \brief The handler of the messages and its argument */
+	isohandler handler;
+	void *arg;
+	/*! \brief The number of connections, and the most it accepts */
+	int nconns;
+	int max_conns;
+	/*! \brief Cleared by ::stop_server to end ::run_server */
+	volatile int running;
+	/*! \brief The connections */
+	isoconn *conns;
+	/*! \brief The idle stream decoders */
+	isostream *free_streams[SERVER_FREE_STREAMS];
+	int nfree;
+	/*! \brief The buffer the connections are read into */
+	char rbuf[SERVER_READ_SIZE];
+	/*! \brief The buffer the responses are packed into */
+	char wbuf[ISO_MAX_LENGTH];
+};
+
+/*!	\brief	Initialize a server, its messages are decoded with plan and framed by a length header. \n
+ * 			An ::isoserver holds its buffers, it is rather allocated statically or on the heap.
+ */
+int init_server(isoserver *srv, const isoplan *plan, int hdr_type, int hdr_len, isohandler handler, void *arg, isoerr *err);
+
+/*!	\brief	Listen on a port, host is an IPv4 address or NULL for every address */
+int listen_server(isoserver *srv, const char *host, int port, int backlog);
+
+/*!	\brief	Serve a socket that is already connected, e.g. accepted by the caller */
+int add_connection(isoserver *srv, int fd, isoconn **conn);
+
+/*!	\brief	Wait for the events of the sockets at most timeout_ms milliseconds and process them */
+int poll_server(isoserver *srv, int timeout_ms);
+
+/*!	\brief	Process the events of the sockets until ::stop_server is called */
+int run_server(isoserver *srv);
+
+/*!	\brief	Make ::run_server return, it may be called by a signal handler */
+void stop_server(isoserver *srv);
+
+/*!	\brief	Send a message that is not a response, e.g. a network management request */
+int server_send(isoconn *c, const char *msg, int len);
+
+/*!	\brief	Close a connection, its output that is not sent is dropped */
+void close_connection(isoconn *c);
+
+/*!	\brief	Close the connections and the sockets of a server */
+void close_server(isoserver *srv);
+
+#endif /*SERVER_H_*/
@@ -0,0 +1,92 @@
+/*
+ * Test of the snapshots: a message is written as a record, read back as a view, stored into a
+ * compact message and packed again, which gives the original message.
+ *
+ * 	usage: snapshot-test		it prints the failed checks and returns 1 if there is one
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "iso8583.h"
+#include "iso8583_std.h"
+#include "errors.h"
+#include "writer.h"
+#include "compact.h"
+#include "snapshot.h"
+
+static int failed;
+
+#define CHECK(cond)	do{ if(!(cond)){ printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); failed++; } }while(0)
+
+/* read the single record of a snapshot back and pack it from a compact message */
+static void check_record(const isoplan *plan, const char *snap, int snap_len, const char *msg, int msg_len)
+{
+	snapreg reg;
+	snapfile s;
+	isoview v;
+	isocompact c;
+	char buf[ISO_MAX_LENGTH];
+	const char *mti;
+	int len;
+
+	init_snapreg(&reg);
+	CHECK(snapreg_add(&reg, 87, plan) == SUCCEEDED);
+	CHECK(open_snapshot_buffer(&s, snap, snap_len, &reg) == SUCCEEDED);
+	init_view_plan(&v, plan);
+	CHECK(next_snapshot(&s, &v) == SNAP_MSG);
+	init_compact(&c);
+	CHECK(compact_view(&c, &v) == SUCCEEDED);
+	CHECK(compact_field(&c, 0, &mti, &len) == SUCCEEDED);
+	CHECK(len == 4 && memcmp(mti, "0200", 4) == 0);
+	CHECK(pack_compact(&c, buf, sizeof(buf), &len, NULL) == SUCCEEDED);
+	CHECK(len == msg_len && memcmp(buf, msg, msg_len) == 0);
+	CHECK(next_snapshot(&s, &v) == SNAP_END);
+	free_compact(&c);
+	close_snapshot(&s);
+}
+
+int main(void)
+{
+	msgprop prop = {BMP_BINARY, ' ', '0'};
+	isoplan plan;
+	isomsg m;
+	isoview v;
+	isowriter w;
+	char msg[ISO_MAX_LENGTH], *snap;
+	int msg_len, snap_len;
+
+	if(compile_plan(&plan, iso87, &prop, NULL) != SUCCEEDED)
+		return 1;
+	init_message_plan(&m, &plan);
+	CHECK(set_field(&m, 0, "0200", 4) == SUCCEEDED);
+	CHECK(set_field(&m, 2, "4000001234567899", 16) == SUCCEEDED);
+	CHECK(set_field(&m, 3, "000000", 6) == SUCCEEDED);
+	CHECK(set_field(&m, 4, "000000001000", 12) == SUCCEEDED);
+	CHECK(set_field(&m, 11, "000001", 6) == SUCCEEDED);
+	CHECK(set_field(&m, 41, "TERM0001", 8) == SUCCEEDED);
+	CHECK(set_field(&m, 43, "PBS INTERNAL TEST\\\\Ballerup\\2750      DK", 40) == SUCCEEDED);
+	CHECK(set_field(&m, 70, "301", 3) == SUCCEEDED);
+	CHECK(pack_message_buf(&m, msg, sizeof(msg), &msg_len) == SUCCEEDED);
+
+	/* a record written from the message */
+	init_writer_buffer(&w);
+	CHECK(write_snapshot_header(&w) == SUCCEEDED);
+	CHECK(write_snapshot_message(&w, 87, &m) == SUCCEEDED);
+	snap = writer_detach(&w, &snap_len);
+	check_record(&plan, snap, snap_len, msg, msg_len);
+	free(snap);
+
+	/* a record written from a view of the packed message */
+	init_view_plan(&v, &plan);
+	CHECK(unpack_view(&v, msg, msg_len) == SUCCEEDED);
+	init_writer_buffer(&w);
+	CHECK(write_snapshot_header(&w) == SUCCEEDED);
+	CHECK(write_snapshot_view(&w, 87, &v) == SUCCEEDED);
+	snap = writer_detach(&w, &snap_len);
+	check_record(&plan, snap, snap_len, msg, msg_len);
+	free(snap);
+
+	free_message(&m);
+	printf("snapshot-test: %s\n", failed? "FAILED" : "passed");
+	return failed? 1 : 0;
+}
@@ -0,0 +1,378 @@
+/*!	\file		snapshot.c
+ * 		\brief	This file writes ISO messages to snapshots and reads them back as views. \n
+ * 					A record holds the lengths of its fields ahead of their data, so reading it is a sum
+ * 					of lengths: the view refers to the record and nothing is decoded or copied. A file is
+ * 					mapped in memory, its records are valid until ::close_snapshot.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "snapshot.h"
+#include "errors.h"
+
+/*!	\brief	Read a little endian 16-bit integer */
+static inline unsigned int get16(const unsigned char *p){
+	return (unsigned int) p[0] | (unsigned int) p[1] << 8;
+}
+
+/*!	\brief	Read a little endian 32-bit integer */
+static inline unsigned long get32(const unsigned char *p){
+	return (unsigned long) p[0] | (unsigned long) p[1] << 8 | (unsigned long) p[2] << 16 | (unsigned long) p[3] << 24;
+}
+
+/*!	\brief	Write a little endian 16-bit integer */
+static inline void put16(unsigned char *p, unsigned int v){
+	p[0] = (unsigned char) v;
+	p[1] = (unsigned char) (v >> 8);
+}
+
+/*!	\brief	Write a little endian 32-bit integer */
+static inline void put32(unsigned char *p, unsigned long v){
+	p[0] = (unsigned char) v;
+	p[1] = (unsigned char) (v >> 8);
+	p[2] = (unsigned char) (v >> 16);
+	p[3] = (unsigned char) (v >> 24);
+}
+
+/*!	\func	void init_snapreg(snapreg *r);
+ * 		\brief	Initialize an empty registry of definitions
+ * 		\param	r is the ::snapreg to initialize
+ */
+void init_snapreg(snapreg *r){
+	r->count = 0;
+}
+
+/*!	\func	int snapreg_add(snapreg *r, unsigned int id, const isoplan *plan);
+ * 		\brief	Register the plan that the records of a definition id are read with. \n
+ * 					The same id must be given the same definition by the writer and the reader of a snapshot.
+ * 		\param	r is a ::snapreg initialized by ::init_snapreg
+ * 		\param	id is the definition id written in the records
+ * 		\param	plan is an ::isoplan compiled by ::compile_plan, it must outlive r
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_IVLIDX if id is already registered \n
+ * 					ERR_OUTRAG if the registry is full
+ */
+int snapreg_add(snapreg *r, unsigned int id, const isoplan *plan){
+	char err_msg[100];
+	if(snapreg_find(r, id) != NULL){
+		sprintf(err_msg, "The snapshot definition %u is already registered", id);
+		handle_err(ERR_IVLIDX, SYS, err_msg);
+		return ERR_IVLIDX;
+	}
+	if(r->count == SNAP_MAX_DEFS){
+		handle_err(ERR_OUTRAG, SYS, "The registry of snapshot definitions is full");
+		return ERR_OUTRAG;
+	}
+	r->def[r->count].id = id;
+	r->def[r->count].plan = plan;
+	r->count++;
+	return SUCCEEDED;
+}
+
+/*!	\func	const isoplan* snapreg_find(const snapreg *r, unsigned int id);
+ * 		\brief	Find the plan of a definition id
+ * 		\param	r is a ::snapreg initialized by ::init_snapreg
+ * 		\param	id is a definition id
+ * 		\return	the plan of id \n
+ * 					NULL if id is not registered
+ */
+const isoplan* snapreg_find(const snapreg *r, unsigned int id){
+	int i;
+	for(i = 0; i < r->count; i++)
+		if(r->def[i].id == id)
+			return r->def[i].plan;
+	return NULL;
+}
+
+/*!	\func	int write_snapshot_header(isowriter *w);
+ * 		\brief	Write the header of a snapshot, before its first record
+ * 		\param	w is the ::isowriter that receives the snapshot
+ * 		\return	SUCCEEDED if having no error \n
+ * 					the error of the writer
+ */
+int write_snapshot_header(isowriter *w){
+	char hdr[SNAP_HDR_LEN] = SNAP_MAGIC;
+	hdr[SNAP_HDR_LEN - 1] = SNAP_VERSION;
+	return writer_write(w, hdr, SNAP_HDR_LEN);
+}
+
+/*!	\func	static int write_record(isowriter *w, unsigned int def_id, const isobitmap *bmp, const bytes *fld, isoerr *e)
+ * 		\brief	Write the MTI and the fields 2..128 of a bitmap as a record, the errors are recorded into e
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_OVRLEN if a field is longer than 65535 bytes, nothing is written then \n
+ * 					the error of the writer
+ */
+static int write_record(isowriter *w, unsigned int def_id, const isobitmap *bmp, const bytes *fld, isoerr *e){
+	unsigned char head[SNAP_REC_LEN + 2*128];
+	isobitmap present = *bmp;
+	isofldit it;
+	unsigned long data_len = 0;
+	int i, n = SNAP_REC_LEN;
+
+	/* field 1 flags the fields 65..128, as in a packed bitmap */
+	present.w[0] = (present.w[0] & ~(uint64_t) 1) | (present.w[1] != 0);
+	bitmap_to_bytes(&present, head + 8, SNAP_BITMAP_LEN);
+	fldit_init(&it, &present);
+	i = 0;
+	do{
+		if(fld[i].length < 0 || fld[i].length > 0xFFFF)
+			return fail_isoerr(e, ERR_OVRLEN, i, -1, 0xFFFF, fld[i].length, -1);
+		put16(head + n, (unsigned int) fld[i].length);
+		n += 2;
+		data_len += fld[i].length;
+	}while((i = fldit_next(&it)) != 0);
+	put32(head, n - 4 + data_len);
+	put32(head + 4, def_id);
+
+	writer_write(w, (const char*) head, n);
+	fldit_init(&it, &present);
+	i = 0;
+	do{
+		if(fld[i].length > 0)
+			writer_write(w, fld[i].bytes, fld[i].length);
+	}while((i = fldit_next(&it)) != 0);
+	return w->err;
+}
+
+/*!	\func	int write_snapshot_message(isowriter *w, unsigned int def_id, const isomsg *m);
+ * 		\brief	Write the MTI and the fields that contain data of an iso message as a record
+ * 		\param	w is the ::isowriter that receives the snapshot
+ * 		\param	def_id is the id of the definition of m, that the reader registers by ::snapreg_add
+ * 		\param	m is an ::isomsg, an error is recorded into its error context, see ::set_errctx
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_OVRLEN if a field is longer than 65535 bytes \n
+ * 					the error of the writer
+ */
+int write_snapshot_message(isowriter *w, unsigned int def_id, const isomsg *m){
+	isoerr local, *e = (m->err != NULL)? m->err : &local;
+	isobitmap bmp;
+
+	e->code = SUCCEEDED;
+	message_bitmap(m, &bmp);
+	return report_isoerr(m->err, e, write_record(w, def_id, &bmp, m->fld, e));
+}
+
+/*!	\func	int write_snapshot_view(isowriter *w, unsigned int def_id, isoview *v);
+ * 		\brief	Write the MTI and the present fields of a view as a record, straight from its buffer
+ * 		\param	w is the ::isowriter that receives the snapshot
+ * 		\param	def_id is the id of the definition of v, that the reader registers by ::snapreg_add
+ * 		\param	v is an ::isoview opened by ::open_view, an error is recorded into its error context, see ::set_view_errctx
+ * 		\return	SUCCEEDED if having no error \n
+ * 					the error of ::index_view \n
+ * 					the error of the writer
+ */
+int write_snapshot_view(isowriter *w, unsigned int def_id, isoview *v){
+	isoerr local, *e = (v->err != NULL)? v->err : &local;
+	bytes fld[129];
+	isofldit it;
+	int i, err;
+
+	err = index_view(v);
+	if(err != SUCCEEDED)
+		return err;
+	fldit_init(&it, &v->bitmap);
+	i = 0;
+	do{
+		fld[i].bytes = (char*) v->buf + v->fld[i].offset;
+		fld[i].length = v->fld[i].length;
+	}while((i = fldit_next(&it)) != 0);
+	e->code = SUCCEEDED;
+	return report_isoerr(v->err, e, write_record(w, def_id, &v->bitmap, fld, e));
+}
+
+/*!	\func	static int check_header(const char *data, size_t size)
+ * 		\brief	Check the header of a snapshot
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_SNPHDR if data is not a snapshot of this version
+ */
+static int check_header(const char *data, size_t size){
+	if(size < SNAP_HDR_LEN || memcmp(data, SNAP_MAGIC, SNAP_HDR_LEN - 1) != 0 || data[SNAP_HDR_LEN - 1] != SNAP_VERSION){
+		handle_err(ERR_SNPHDR, SYS, "The data is not a snapshot of this version");
+		return ERR_SNPHDR;
+	}
+	return SUCCEEDED;
+}
+
+/*!	\func	int open_snapshot_buffer(snapfile *s, const char *data, size_t size, const snapreg *reg);
+ * 		\brief	Read the records of a snapshot held in memory
+ * 		\param	s is the ::snapfile to initialize
+ * 		\param	data is the snapshot, its header included, it must outlive the views of its records
+ * 		\param	size is the length of data
+ * 		\param	reg is the registry of the definitions of the records, it must outlive s
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_SNPHDR if data is not a snapshot
+ */
+int open_snapshot_buffer(snapfile *s, const char *data, size_t size, const snapreg *reg){
+	int err = check_header(data, size);
+	if(err != SUCCEEDED)
+		return err;
+	s->data = data;
+	s->size = size;
+	s->pos = SNAP_HDR_LEN;
+	s->mapped = 0;
+	s->reg = reg;
+	s->last = NULL;
+	return SUCCEEDED;
+}
+
+/*!	\func	int open_snapshot(snapfile *s, const char *path, const snapreg *reg);
+ * 		\brief	Map a snapshot file in memory to read its records. \n
+ * 					The pages are read by the system as the records are visited.
+ * 		\param	s is the ::snapfile to initialize
+ * 		\param	path is the path of the file
+ * 		\param	reg is the registry of the definitions of the records, it must outlive s
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_IOREAD if the file can't be opened or mapped \n
+ * 					ERR_SNPHDR if the file is not a snapshot
+ */
+int open_snapshot(snapfile *s, const char *path, const snapreg *reg){
+	struct stat st;
+	void *data;
+	int fd, err;
+	char err_msg[100];
+
+	fd = open(path, O_RDONLY);
+	if(fd < 0 || fstat(fd, &st) != 0 || st.st_size < SNAP_HDR_LEN){
+		if(fd >= 0)
+			close(fd);
+		snprintf(err_msg, sizeof(err_msg), "Can not open the snapshot %s", path);
+		handle_err(ERR_IOREAD, SYS, err_msg);
+		return ERR_IOREAD;
+	}
+	data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(data == MAP_FAILED){
+		snprintf(err_msg, sizeof(err_msg), "Can not map the snapshot %s", path);
+		handle_err(ERR_IOREAD, SYS, err_msg);
+		return ERR_IOREAD;
+	}
+#ifdef MADV_SEQUENTIAL
+	madvise(data, (size_t) st.st_size, MADV_SEQUENTIAL);
+#endif
+	err = open_snapshot_buffer(s, (const char*) data, (size_t) st.st_size, reg);
+	if(err != SUCCEEDED){
+		munmap(data, (size_t) st.st_size);
+		return err;
+	}
+	s->mapped = 1;
+	return SUCCEEDED;
+}
+
+/*!	\func	static int corrupted(isoerr *e, size_t pos, unsigned long expected, unsigned long actual)
+ * 		\brief	Record a record that can't be read into e, with the length that is not the expected one
+ * 		\return	ERR_SNPREC
+ */
+static int corrupted(isoerr *e, size_t pos, unsigned long expected, unsigned long actual){
+	return fail_isoerr(e, ERR_SNPREC, -1, (pos > INT_MAX)? -1 : (int) pos,
+			(expected > INT_MAX)? -1 : (int) expected, (actual > INT_MAX)? -1 : (int) actual, -1);
+}
+
+/*!	\func	int next_snapshot(snapfile *s, isoview *v);
+ * 		\brief	Read the next record of a snapshot into a view. \n
+ * 					The fields are located from the lengths of the record, the view refers to the record
+ * 					and is indexed: ::view_field, ::write_view and ::compact_view take it as it is. Its
+ * 					buffer is not a packed message though, it must not be unpacked or sent as one.
+ * 		\param	s is a ::snapfile opened by ::open_snapshot or ::open_snapshot_buffer
+ * 		\param	v receives the record, it is valid until s is closed. An error is recorded into its error
+ * 					context, see ::set_view_errctx, the offset of the error is the offset of the record.
+ * 		\return	SNAP_MSG if a record is read \n
+ * 					SNAP_END if every record is read \n
+ * 					ERR_SNPREC if the record is corrupted, the snapshot can't be read past it \n
+ * 					ERR_SNPDEF if the definition of the record is not registered, the next call reads the next record
+ */
+int next_snapshot(snapfile *s, isoview *v){
+	isoerr local, *e = (v->err != NULL)? v->err : &local;
+	const unsigned char *rec, *lens;
+	const isoplan *plan = NULL;
+	size_t rest = s->size - s->pos;
+	unsigned long body, off;
+	unsigned int id;
+	isobitmap bmp;
+	isofldit it;
+	int i, n;
+
+	if(rest == 0)
+		return SNAP_END;
+	e->code = SUCCEEDED;
+	if(rest < SNAP_REC_LEN)
+		return report_isoerr(v->err, e, corrupted(e, s->pos, SNAP_REC_LEN, rest));
+	rec = (const unsigned char*) s->data + s->pos;
+	body = get32(rec);
+	if(body < SNAP_REC_LEN - 4 || body > rest - 4)
+		return report_isoerr(v->err, e, corrupted(e, s->pos, rest - 4, body));
+
+	/* the fields are located before the definition, so an unknown one can be skipped */
+	bitmap_from_bytes(&bmp, rec + 8, SNAP_BITMAP_LEN);
+	bitmap_unset(&bmp, 1);
+	n = 1 + bitmap_count(&bmp);
+	if(SNAP_REC_LEN + 2*(unsigned long) n > body + 4)
+		return report_isoerr(v->err, e, corrupted(e, s->pos, SNAP_REC_LEN + 2*n - 4, body));
+	lens = rec + SNAP_REC_LEN;
+	off = SNAP_REC_LEN + 2*n;
+	fldit_init(&it, &bmp);
+	i = 0;
+	do{
+		v->fld[i].offset = (int) off;
+		v->fld[i].length = (int) get16(lens);
+		off += get16(lens);
+		lens += 2;
+	}while((i = fldit_next(&it)) != 0);
+	if(off != body + 4)
+		return report_isoerr(v->err, e, corrupted(e, s->pos, body + 4, off));
+	s->pos += off;
+
+	id = (unsigned int) get32(rec + 4);
+	if(s->last != NULL && s->last->id == id)
+		plan = s->last->plan;
+	for(i = 0; plan == NULL && i < s->reg->count; i++)
+		if(s->reg->def[i].id == id){
+			s->last = &s->reg->def[i];
+			plan = s->last->plan;
+		}
+	if(plan == NULL){
+		/* the record is skipped, the error is at its offset */
+		rest = s->pos - off;
+		return report_isoerr(v->err, e, fail_isoerr(e, ERR_SNPDEF, -1, (rest > INT_MAX)? -1 : (int) rest, -1, -1, -1));
+	}
+
+	/* the view is complete, as ::index_view leaves it */
+	v->prop = plan->prop;
+	v->def = plan->def;
+	v->plan = plan;
+	v->buf = (const char*) rec;
+	v->buf_len = (int) off;
+	v->msg_len = (int) off;
+	v->located = 128;
+	v->scan_pos = (int) off;
+	v->fld[1].offset = 0;
+	v->fld[1].length = 0;
+	if(bmp.w[1] != 0)
+		bitmap_set(&bmp, 1);
+	v->bitmap = bmp;
+	return SNAP_MSG;
+}
+
+/*!	\func	void rewind_snapshot(snapfile *s);
+ * 		\brief	Go back to the first record of a snapshot
+ * 		\param	s is a ::snapfile opened by ::open_snapshot or ::open_snapshot_buffer
+ */
+void rewind_snapshot(snapfile *s){
+	s->pos = SNAP_HDR_LEN;
+}
+
+/*!	\func	void close_snapshot(snapfile *s);
+ * 		\brief	Unmap a snapshot file, the views of its records are no longer valid
+ * 		\param	s is a ::snapfile opened by ::open_snapshot or ::open_snapshot_buffer
+ */
+void close_snapshot(snapfile *s){
+	if(s->mapped)
+		munmap((void*) s->data, s->size);
+	s->data = NULL;
+	s->size = 0;
+	s->pos = 0;
+	s->mapped = 0;
+}
@@ -0,0 +1,96 @@
+/*!	\file		snapshot.h
+ * 		\brief	A binary snapshot format for archiving ISO messages and replaying them as views. \n
+ * 				A snapshot is a header then a run of length-prefixed records:
+ * 				- the length of the rest of the record, 4 bytes little endian
+ * 				- the id of the definition of the message, 4 bytes little endian
+ * 				- the bitmap of the present fields, SNAP_BITMAP_LEN bytes in its packed binary form
+ * 				- the length of the MTI and of each present field 2..128, 2 bytes little endian each
+ * 				- the data of the MTI and of the present fields, one after the other
+ * 				A record is read back without knowing the wire format of the message: the fields of a
+ * 				view are located by summing the lengths.
+ */
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+#include <stddef.h>
+#include "iso8583.h"
+
+#define SNAP_MAGIC				"ISOSNAP"	/*!	\brief	The first bytes of a snapshot, followed by SNAP_VERSION */
+#define SNAP_VERSION			1			/*!	\brief	The version of the format, the last byte of the header */
+#define SNAP_HDR_LEN			8			/*!	\brief	The length of the header of a snapshot */
+#define SNAP_BITMAP_LEN			16			/*!	\brief	The length of the bitmap of a record */
+#define SNAP_REC_LEN			(8 + SNAP_BITMAP_LEN)	/*!	\brief	The length of the fixed part of a record */
+
+#define SNAP_MAX_DEFS			16			/*!	\brief	The number of definitions a registry holds */
+
+#define SNAP_END				0			/*!	\brief	::next_snapshot has read every record */
+#define SNAP_MSG				1			/*!	\brief	::next_snapshot has read a record */
+
+/*!	\struct		snapdef
+ * 		\brief		A definition of a registry, the plan that the records of an id are read with
+ */
+typedef struct {
+	unsigned int id;
+	const isoplan *plan;
+} snapdef;
+
+/*!	\struct		snapreg
+ * 		\brief		The registry of the definitions a snapshot refers to by id
+ */
+typedef struct {
+	/*! \brief The number of definitions */
+	int count;
+	/*! \brief The definitions */
+	snapdef def[SNAP_MAX_DEFS];
+} snapreg;
+
+/*!	\struct		snapfile
+ * 		\brief		A snapshot being read, from a mapped file or from memory
+ */
+typedef struct {
+	/*! \brief The snapshot, its size and the offset of the next record */
+	const char *data;
+	size_t size;
+	size_t pos;
+	/*! \brief Whether data is mapped by ::open_snapshot */
+	int mapped;
+	/*! \brief The registry the definition ids are looked up in */
+	const snapreg *reg;
+	/*! \brief The last definition found, records usually share it */
+	const snapdef *last;
+} snapfile;
+
+/*!	\brief	Initialize an empty registry */
+void init_snapreg(snapreg *r);
+
+/*!	\brief	Register the plan that the records of a definition id are read with */
+int snapreg_add(snapreg *r, unsigned int id, const isoplan *plan);
+
+/*!	\brief	Find the plan of a definition id, NULL if it is not registered */
+const isoplan* snapreg_find(const snapreg *r, unsigned int id);
+
+/*!	\brief	Write the header of a snapshot */
+int write_snapshot_header(isowriter *w);
+
+/*!	\brief	Write the fields of an iso message as a record of a snapshot */
+int write_snapshot_message(isowriter *w, unsigned int def_id, const isomsg *m);
+
+/*!	\brief	Write the fields of an iso message view as a record of a snapshot */
+int write_snapshot_view(isowriter *w, unsigned int def_id, isoview *v);
+
+/*!	\brief	Map a snapshot file to read its records */
+int open_snapshot(snapfile *s, const char *path, const snapreg *reg);
+
+/*!	\brief	Read the records of a snapshot held in memory */
+int open_snapshot_buffer(snapfile *s, const char *data, size_t size, const snapreg *reg);
+
+/*!	\brief	Read the next record of a snapshot into a view */
+int next_snapshot(snapfile *s, isoview *v);
+
+/*!	\brief	Go back to the first record of a snapshot */
+void rewind_snapshot(snapfile *s);
+
+/*!	\brief	Unmap a snapshot file */
+void close_snapshot(snapfile *s);
+
+#endif /*SNAPSHOT_H_*/
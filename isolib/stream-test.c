@@ -0,0 +1,160 @@
+/*
+ * Test of the stream decoder: the messages are fed whole, byte by byte and several in one chunk,
+ * and the length headers that are not valid are rejected.
+ *
+ * 	usage: stream-test		it prints the failed checks and returns 1 if there is one
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "iso8583.h"
+#include "iso8583_std.h"
+#include "errors.h"
+#include "stream.h"
+
+static int failed;
+
+#define CHECK(cond)	do{ if(!(cond)){ printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); failed++; } }while(0)
+
+/* pack a financial request with a LLVAR field, an alpha field and the secondary bitmap */
+static int make_message(const isoplan *plan, const char *stan, char *buf, int size, int *len)
+{
+	bytes fld[129];
+	isobitmap bmp;
+
+	memset(&bmp, 0, sizeof(bmp));
+	fld[0].bytes = "0200";			fld[0].length = 4;
+	fld[2].bytes = "4000001234567899";	fld[2].length = 16;
+	fld[3].bytes = "000000";		fld[3].length = 6;
+	fld[4].bytes = "000000001000";		fld[4].length = 12;
+	fld[11].bytes = (char*) stan;		fld[11].length = 6;
+	fld[41].bytes = "TERM0001";		fld[41].length = 8;
+	fld[70].bytes = "301";			fld[70].length = 3;
+	bitmap_set(&bmp, 2);
+	bitmap_set(&bmp, 3);
+	bitmap_set(&bmp, 4);
+	bitmap_set(&bmp, 11);
+	bitmap_set(&bmp, 41);
+	bitmap_set(&bmp, 70);
+	return pack_fields(plan, &bmp, fld, buf, size, len, NULL);
+}
+
+/* put a message after its binary length header */
+static int frame(const char *msg, int len, char *out)
+{
+	out[0] = (len >> 8) & 0xFF;
+	out[1] = len & 0xFF;
+	memcpy(out + 2, msg, len);
+	return len + 2;
+}
+
+static void check_stan(isostream *s, const char *stan)
+{
+	const char *data;
+	int len;
+
+	CHECK(view_field(&s->view, 11, &data, &len) == SUCCEEDED);
+	CHECK(len == 6 && memcmp(data, stan, 6) == 0);
+	CHECK(view_field(&s->view, 70, &data, &len) == SUCCEEDED);
+	CHECK(len == 3 && memcmp(data, "301", 3) == 0);
+}
+
+static void test_whole(const isoplan *plan, const char *msg, int len)
+{
+	isostream *s = (isostream*) malloc(sizeof(isostream));
+	char in[ISO_MAX_LENGTH];
+	int n = frame(msg, len, in), used;
+
+	CHECK(init_stream_plan(s, plan, STREAM_HDR_BINARY, 2, NULL) == SUCCEEDED);
+	CHECK(stream_feed(s, in, n, &used) == STREAM_MSG);
+	CHECK(used == n);
+	CHECK(s->view.msg_len == len);
+	check_stan(s, "000001");
+	free(s);
+}
+
+static void test_split(const isoplan *plan, const char *msg, int len)
+{
+	isostream *s = (isostream*) malloc(sizeof(isostream));
+	char in[ISO_MAX_LENGTH];
+	int n = frame(msg, len, in), used, i, err;
+
+	CHECK(init_stream_plan(s, plan, STREAM_HDR_BINARY, 2, NULL) == SUCCEEDED);
+	for(i = 0; i < n - 1; i++){
+		err = stream_feed(s, in + i, 1, &used);
+		CHECK(err == STREAM_MORE && used == 1);
+		CHECK(stream_pending(s));
+	}
+	CHECK(stream_feed(s, in + i, 1, &used) == STREAM_MSG);
+	CHECK(used == 1);
+	CHECK(!stream_pending(s));
+	check_stan(s, "000001");
+	free(s);
+}
+
+static void test_pipelined(const isoplan *plan, const char *msg1, int len1, const char *msg2, int len2)
+{
+	isostream *s = (isostream*) malloc(sizeof(isostream));
+	char in[3 * ISO_MAX_LENGTH];
+	int n, used, off;
+
+	n = frame(msg1, len1, in);
+	n += frame(msg2, len2, in + n);
+	frame(msg1, len1, in + n);
+	n += 2 + 3;		/* the third one is cut after 3 bytes of its MTI */
+	CHECK(init_stream_plan(s, plan, STREAM_HDR_BINARY, 2, NULL) == SUCCEEDED);
+	CHECK(stream_feed(s, in, n, &used) == STREAM_MSG);
+	check_stan(s, "000001");
+	off = used;
+	CHECK(off == len1 + 2);
+	CHECK(stream_feed(s, in + off, n - off, &used) == STREAM_MSG);
+	check_stan(s, "000002");
+	off += used;
+	CHECK(off == len1 + len2 + 4);
+	CHECK(stream_feed(s, in + off, n - off, &used) == STREAM_MORE);
+	CHECK(used == n - off);
+	CHECK(stream_pending(s));
+	free(s);
+}
+
+static void test_bad_header(const isoplan *plan)
+{
+	isostream *s = (isostream*) malloc(sizeof(isostream));
+	char ff[4] = {(char) 0xFF, (char) 0xFF, (char) 0xFF, (char) 0xFF};
+	char big[4] = {0x00, 0x00, 0x20, 0x01};
+	int used;
+
+	/* a 4 bytes header does not fit an int, it must not come back as a negative length */
+	CHECK(init_stream_plan(s, plan, STREAM_HDR_BINARY, 4, NULL) == SUCCEEDED);
+	CHECK(stream_feed(s, ff, 4, &used) == ERR_OVRLEN);
+	CHECK(s->msg_len == -1);
+	CHECK(stream_feed(s, ff, 4, &used) == ERR_IVLPOS);
+	reset_stream(s);
+	CHECK(stream_feed(s, big, 4, &used) == ERR_OVRLEN);
+	CHECK(init_stream_plan(s, plan, STREAM_HDR_ASCII, 4, NULL) == SUCCEEDED);
+	CHECK(stream_feed(s, "9999", 4, &used) == ERR_OVRLEN);
+	reset_stream(s);
+	CHECK(stream_feed(s, "12a4", 4, &used) == ERR_IVLLEN);
+	free(s);
+}
+
+int main(void)
+{
+	msgprop prop = {BMP_BINARY, ' ', '0'};
+	isoplan plan;
+	char msg1[ISO_MAX_LENGTH], msg2[ISO_MAX_LENGTH];
+	int len1, len2;
+
+	if(compile_plan(&plan, iso87, &prop, NULL) != SUCCEEDED
+			|| make_message(&plan, "000001", msg1, sizeof(msg1), &len1) != SUCCEEDED
+			|| make_message(&plan, "000002", msg2, sizeof(msg2), &len2) != SUCCEEDED){
+		printf("cannot pack the test messages\n");
+		return 1;
+	}
+	test_whole(&plan, msg1, len1);
+	test_split(&plan, msg1, len1);
+	test_pipelined(&plan, msg1, len1, msg2, len2);
+	test_bad_header(&plan);
+	printf("stream-test: %s\n", failed? "FAILED" : "passed");
+	return failed? 1 : 0;
+}
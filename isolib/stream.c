@@ -0,0 +1,276 @@
+/*!	\file		stream.c
+ * 		\brief	This file decodes ISO messages from a byte stream. \n
+ * 					The bytes may arrive in chunks of any size, e.g. as a non-blocking socket returns them.
+ * 					The decoder is a state machine that keeps the partial message between two calls and
+ * 					looks at each byte once: the length header, the MTI, the bitmap, then for each present
+ * 					field its LL/LLL header and its data.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include "stream.h"
+#include "errors.h"
+#include "hexa.h"
+
+#define ST_HDR			0		/*!	\brief	Reading the length header */
+#define ST_MTI			1		/*!	\brief	Reading the MTI */
+#define ST_BITMAP		2		/*!	\brief	Reading the primary or the secondary bitmap */
+#define ST_LEN			3		/*!	\brief	Reading the LL/LLL header of a field */
+#define ST_DATA			4		/*!	\brief	Reading the data of a field */
+#define ST_DONE			5		/*!	\brief	A message is complete */
+#define ST_FAILED		6		/*!	\brief	The stream is out of frame */
+
+/*!	\func	int init_stream(isostream *s, const isodef *def, const msgprop *prop, int hdr_type, int hdr_len, isoerr *err);
+ * 		\brief	Initialize a stream decoder. The plan of def and prop is compiled into the decoder.
+ * 		\param	s is the ::isostream to initialize, it holds a pointer to itself so it must not be copied
+ * 		\param	def is an array of 129 ::isodef structures, it must outlive s
+ * 		\param	prop is a ::msgprop pointer whose value will be set as the properties of the messages
+ * 		\param	hdr_type is STREAM_HDR_NONE, STREAM_HDR_ASCII or STREAM_HDR_BINARY
+ * 		\param	hdr_len is the length of the header, 1 to STREAM_MAX_HDR, ignored for STREAM_HDR_NONE
+ * 		\param	err is the error context of the decoder, NULL to log its errors
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_IVLFLG if the header is not valid \n
+ * 					the error of ::compile_plan
+ */
+int init_stream(isostream *s, const isodef *def, const msgprop *prop, int hdr_type, int hdr_len, isoerr *err){
+	int ret = compile_plan(&s->own_plan, def, prop, err);
+	if(ret != SUCCEEDED)
+		return ret;
+	return init_stream_plan(s, &s->own_plan, hdr_type, hdr_len, err);
+}
+
+/*!	\func	int init_stream_plan(isostream *s, const isoplan *plan, int hdr_type, int hdr_len, isoerr *err);
+ * 		\brief	Initialize a stream decoder that decodes with a compiled plan
+ * 		\param	s is the ::isostream to initialize
+ * 		\param	plan is an ::isoplan compiled by ::compile_plan, it must outlive s
+ * 		\param	hdr_type is STREAM_HDR_NONE, STREAM_HDR_ASCII or STREAM_HDR_BINARY
+ * 		\param	hdr_len is the length of the header, 1 to STREAM_MAX_HDR, ignored for STREAM_HDR_NONE
+ * 		\param	err is the error context of the decoder and of its views, NULL to log their errors. \n
+ * 					A stream that rejects frames from a peer should have one, so that a flood of
+ * 					malformed frames is neither formatted nor logged.
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_IVLFLG if the header is not valid
+ */
+int init_stream_plan(isostream *s, const isoplan *plan, int hdr_type, int hdr_len, isoerr *err){
+	isoerr local, *e = (err != NULL)? err : &local;
+
+	e->code = SUCCEEDED;
+	if(hdr_type == STREAM_HDR_NONE){
+		hdr_len = 0;
+	}else if((hdr_type != STREAM_HDR_ASCII && hdr_type != STREAM_HDR_BINARY) || hdr_len < 1 || hdr_len > STREAM_MAX_HDR){
+		return report_isoerr(err, e, fail_isoerr(e, ERR_IVLFLG, -1, -1, STREAM_MAX_HDR, hdr_len, -1));
+	}
+	s->plan = plan;
+	s->hdr_type = hdr_type;
+	s->hdr_len = hdr_len;
+	s->err = err;
+	init_view_plan(&s->view, plan);
+	set_view_errctx(&s->view, err);
+	reset_stream(s);
+	return SUCCEEDED;
+}
+
+/*!	\func	void reset_stream(isostream *s);
+ * 		\brief	Drop the partial message of a stream decoder, the next byte fed starts a new message. \n
+ * 					Call it after ::stream_feed returns an error, when the framing of the stream is resynchronized.
+ * 		\param	s is an ::isostream initialized by ::init_stream
+ */
+void reset_stream(isostream *s){
+	s->len = 0;
+	s->msg_len = -1;
+	s->field = 0;
+	if(s->hdr_type == STREAM_HDR_NONE){
+		s->state = ST_MTI;
+		s->need = s->plan->fld[0].max_len;
+	}else{
+		s->state = ST_HDR;
+		s->need = s->hdr_len;
+	}
+}
+
+/*!	\func	int stream_pending(const isostream *s);
+ * 		\brief	Tell whether a stream decoder holds the first bytes of a message that is not complete. \n
+ * 					A decoder that holds none can be reset and given to another stream, e.g. by a server
+ * 					that keeps decoders only for the connections in the middle of a message.
+ * 		\param	s is an ::isostream initialized by ::init_stream
+ * 		\return	1 if a message is partially received \n
+ * 					0 if the next byte fed starts a new message, or if the stream is out of frame
+ */
+int stream_pending(const isostream *s){
+	switch(s->state){
+		case ST_DONE:
+		case ST_FAILED:
+			return 0;
+		case ST_HDR:
+			return s->need != s->hdr_len;
+		default:
+			/* the length header may be read while no byte of the message is */
+			return s->len != 0 || s->msg_len >= 0;
+	}
+}
+
+/*!	\func	static int expect(isostream *s, int state, int need, isoerr *e)
+ * 		\brief	Go to the next step, which reads need bytes of the message
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_IVLLEN if the message is longer than its length header \n
+ * 					ERR_OVRLEN if the message is longer than ISO_MAX_LENGTH
+ */
+static int expect(isostream *s, int state, int need, isoerr *e){
+	if(s->msg_len >= 0 && s->len + need > s->msg_len)
+		return fail_isoerr(e, ERR_IVLLEN, s->field, s->len, s->msg_len, s->len + need, -1);
+	if(s->len + need > ISO_MAX_LENGTH)
+		return fail_isoerr(e, ERR_OVRLEN, s->field, s->len, ISO_MAX_LENGTH, s->len + need, -1);
+	s->state = state;
+	s->need = need;
+	return SUCCEEDED;
+}
+
+/*!	\func	static int next_field(isostream *s, isoerr *e)
+ * 		\brief	Go to the next present field, or complete the message if every field is read
+ */
+static int next_field(isostream *s, isoerr *e){
+	const isocodec *c;
+	int i = fldit_next(&s->it);
+
+	if(i == 0){
+		if(s->msg_len >= 0 && s->len != s->msg_len)
+			return fail_isoerr(e, ERR_IVLLEN, -1, -1, s->msg_len, s->len, -1);
+		/* the view is complete, as ::index_view leaves it */
+		s->view.buf_len = s->len;
+		s->view.msg_len = s->len;
+		s->view.located = 128;
+		s->view.scan_pos = s->len;
+		s->state = ST_DONE;
+		s->need = 0;
+		return SUCCEEDED;
+	}
+	s->field = i;
+	c = &s->plan->fld[i];
+	if(c->kind == CODEC_LLVAR)
+		return expect(s, ST_LEN, c->lenflds, e);
+	s->view.fld[i].offset = s->len;
+	s->view.fld[i].length = c->max_len;
+	return expect(s, ST_DATA, c->max_len, e);
+}
+
+/*!	\func	static int step(isostream *s, isoerr *e)
+ * 		\brief	Process the bytes of the step that has just been read, then go to the next step
+ */
+static int step(isostream *s, isoerr *e){
+	const isocodec *c;
+	unsigned long hdr;
+	int i, len, bmp_chunk, err;
+
+	bmp_chunk = (s->plan->prop.bmp_flag == BMP_HEXA)? 16 : 8;
+	switch(s->state){
+		case ST_HDR:
+			/* a 4 bytes binary header does not fit an int, it is checked before being stored */
+			for(hdr = 0, i = 0; i < s->hdr_len; i++){
+				if(s->hdr_type == STREAM_HDR_BINARY){
+					hdr = (hdr << 8) | (unsigned char) s->hdr[i];
+				}else{
+					if(s->hdr[i] < '0' || s->hdr[i] > '9')
+						return fail_isoerr(e, ERR_IVLLEN, -1, -1, -1, -1, ISO_NUMERIC);
+					hdr = hdr*10 + s->hdr[i] - '0';
+				}
+			}
+			if(hdr > ISO_MAX_LENGTH)
+				return fail_isoerr(e, ERR_OVRLEN, -1, -1, ISO_MAX_LENGTH, (hdr > INT_MAX)? INT_MAX : (int) hdr, -1);
+			s->msg_len = (int) hdr;
+			return expect(s, ST_MTI, s->plan->fld[0].max_len, e);
+		case ST_MTI:
+			return expect(s, ST_BITMAP, bmp_chunk, e);
+		case ST_BITMAP:
+			/* field 1 tells whether a secondary bitmap follows the primary one */
+			i = s->plan->fld[0].max_len;
+			if(s->len == i + bmp_chunk){
+				if(s->plan->prop.bmp_flag == BMP_HEXA)
+					len = hexa_value(s->buf[i]) & 0x08;
+				else
+					len = s->buf[i] & 0x80;
+				if(len)
+					return expect(s, ST_BITMAP, bmp_chunk, e);
+			}
+			/* the view records its error into the context of the stream, or logs it */
+			err = open_view(&s->view, s->buf, s->len);
+			if(err != SUCCEEDED)
+				return err;
+			fldit_init(&s->it, &s->view.bitmap);
+			return next_field(s, e);
+		case ST_LEN:
+			c = &s->plan->fld[s->field];
+			for(len = 0, i = s->len - c->lenflds; i < s->len; i++){
+				if(s->buf[i] < '0' || s->buf[i] > '9')
+					return fail_isoerr(e, ERR_IVLLEN, s->field, s->len - c->lenflds, -1, -1, c->format);
+				len = len*10 + s->buf[i] - '0';
+			}
+			if(len > c->max_len)
+				return fail_isoerr(e, ERR_OVRLEN, s->field, s->len - c->lenflds, c->max_len, len, c->format);
+			s->view.fld[s->field].offset = s->len;
+			s->view.fld[s->field].length = len;
+			return expect(s, ST_DATA, len, e);
+		case ST_DATA:
+			s->view.located = s->field;
+			s->view.scan_pos = s->len;
+			return next_field(s, e);
+		default:
+			break;
+	}
+	return fail_isoerr(e, ERR_IVLPOS, -1, -1, -1, -1, -1);
+}
+
+/*!	\func	int stream_feed(isostream *s, const char *data, int len, int *consumed);
+ * 		\brief	Decode the next chunk of a stream. \n
+ * 					The bytes are consumed until a message is complete, the caller feeds the rest of
+ * 					the chunk in the next call. A completed message is held by s->view, its fields refer
+ * 					to s->buf and it stays valid until the next call.
+ * 		\param	s is an ::isostream initialized by ::init_stream
+ * 		\param	data is the chunk of bytes received
+ * 		\param	len is the length of data, 0 is allowed
+ * 		\param	consumed receives the number of bytes of data that are used
+ * 		\return	STREAM_MORE if every byte is consumed and the message is not complete yet \n
+ * 					STREAM_MSG if a message is complete \n
+ * 					error number if the stream is not valid, the decoder then stays out of frame until ::reset_stream. \n
+ * 					The error is recorded into the context of s, or logged if it has none. ERR_IVLPOS, which
+ * 					is returned while the decoder is out of frame, is not.
+ */
+int stream_feed(isostream *s, const char *data, int len, int *consumed){
+	isoerr local, *e = (s->err != NULL)? s->err : &local;
+	int n, used = 0, err;
+
+	*consumed = 0;
+	if(s->state == ST_FAILED)
+		return ERR_IVLPOS;
+	e->code = SUCCEEDED;
+	if(s->state == ST_DONE)
+		reset_stream(s);
+	for(;;){
+		if(s->need > 0){
+			n = (len - used < s->need)? len - used : s->need;
+			if(n == 0)
+				break;
+			if(s->state == ST_HDR){
+				memcpy(s->hdr + s->hdr_len - s->need, data + used, n);
+			}else{
+				memcpy(s->buf + s->len, data + used, n);
+				s->len += n;
+			}
+			used += n;
+			s->need -= n;
+			if(s->need > 0)
+				break;
+		}
+		err = step(s, e);
+		if(err != SUCCEEDED){
+			s->state = ST_FAILED;
+			*consumed = used;
+			return report_isoerr(s->err, e, err);
+		}
+		if(s->state == ST_DONE){
+			*consumed = used;
+			return STREAM_MSG;
+		}
+	}
+	*consumed = used;
+	return STREAM_MORE;
+}
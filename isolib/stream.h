@@ -0,0 +1,66 @@
+/*!	\file		stream.h
+ * 		\brief	Incremental decoding of ISO messages that arrive in arbitrary chunks, e.g. from a TCP socket
+ */
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include "iso8583.h"
+
+#define STREAM_HDR_NONE			0		/*!	\brief	No length header, the end of a message is found by parsing it */
+#define STREAM_HDR_ASCII		1		/*!	\brief	The length header is a run of decimal digits */
+#define STREAM_HDR_BINARY		2		/*!	\brief	The length header is a big endian unsigned integer */
+
+#define STREAM_MAX_HDR			4		/*!	\brief	The longest length header */
+
+#define STREAM_MORE				1		/*!	\brief	::stream_feed needs more bytes to complete the message */
+#define STREAM_MSG				2		/*!	\brief	::stream_feed has completed a message */
+
+/*!	\struct		isostream
+ * 		\brief		The state of a stream decoder between two calls of ::stream_feed
+ */
+typedef struct {
+	/*! \brief The compiled plan the messages are decoded with, plan points either to it or to the caller's plan */
+	isoplan own_plan;
+	const isoplan *plan;
+	/*! \brief The kind of length header, one of STREAM_HDR_NONE, STREAM_HDR_ASCII, STREAM_HDR_BINARY */
+	int hdr_type;
+	/*! \brief The length of the length header */
+	int hdr_len;
+	/*! \brief The current step of the decoder */
+	int state;
+	/*! \brief The number of bytes the current step still needs */
+	int need;
+	/*! \brief The message length read from the header, -1 without a header */
+	int msg_len;
+	/*! \brief The field being decoded */
+	int field;
+	/*! \brief The present fields that are not decoded yet */
+	isofldit it;
+	/*! \brief The length header as it is received */
+	char hdr[STREAM_MAX_HDR];
+	/*! \brief The number of bytes of the current message in buf */
+	int len;
+	/*! \brief The error context of the decoder and of view, NULL to have their errors logged */
+	isoerr *err;
+	/*! \brief The last completed message, its fields refer to buf. It is valid until the next ::stream_feed */
+	isoview view;
+	/*! \brief The bytes of the current message, the header excluded */
+	char buf[ISO_MAX_LENGTH];
+} isostream;
+
+/*!	\brief	Initialize a stream decoder with an iso definition, message properties, the kind of length header and an error context */
+int init_stream(isostream *s, const isodef *def, const msgprop *prop, int hdr_type, int hdr_len, isoerr *err);
+
+/*!	\brief	Initialize a stream decoder with a compiled plan, the kind of length header and an error context */
+int init_stream_plan(isostream *s, const isoplan *plan, int hdr_type, int hdr_len, isoerr *err);
+
+/*!	\brief	Drop the partial message of a stream decoder, e.g. after an error */
+void reset_stream(isostream *s);
+
+/*!	\brief	Tell whether a stream decoder holds the first bytes of a message that is not complete */
+int stream_pending(const isostream *s);
+
+/*!	\brief	Decode the next chunk of a stream, returning STREAM_MORE, STREAM_MSG or an error number */
+int stream_feed(isostream *s, const char *data, int len, int *consumed);
+
+#endif /*STREAM_H_*/
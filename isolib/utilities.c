@@ -2,12 +2,16 @@
  * 		\brief	This file contains all functions that support main iso-related functions
  */
 #include "utilities.h"
-#include <ctype.h>
-#include <locale.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "errors.h"
+#include "hexa.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define UTILITIES_SIMD	1
+#include <emmintrin.h>
+#endif
 /*!	\fn	int hexachar2int(char hexa_char)
  * 		\brief	This function convert a hexa character to its correspondent integer value
  * 		\param		hexa_char	the character to convert
@@ -16,21 +20,11 @@
  * 						error number if having an error
  */
 int	hexachar2int(char hexa_char, int* ptrint){
-	setlocale(LC_CTYPE, "C");
-	if( isxdigit(hexa_char)){
-		if( isdigit(hexa_char)){
-			setlocale(LC_CTYPE, "");
-			*ptrint  =  hexa_char - '0';
-			return SUCCEEDED;
-		}else{
-			setlocale(LC_CTYPE, "");
-			*ptrint = tolower(hexa_char) - 'a' + 10 ;
-			return SUCCEEDED;
-		}
-	}else{
-		setlocale(LC_CTYPE, "");
+	int v = hexa_value(hexa_char);
+	if(v < 0)
 		return ERR_OUTRAG;
-	}
+	*ptrint = v;
+	return SUCCEEDED;
 }
 
 /*!	\fn	char int2hexachar(int num)
@@ -62,34 +56,24 @@ int	int2hexachar(int num, char* ptrch){
  * 						error number if having an error
  */
 int	hexachars2bytes(bytes* hexa_chars, bytes* binary_bytes){
-	int i, tmp, byte_len, err =0;
+	int tmp, even_len, err;
 
-	byte_len = hexa_chars->length/2 +1;
-	binary_bytes->bytes = (char*) calloc(byte_len, sizeof(char));
+	even_len = hexa_chars->length & ~1;
+	binary_bytes->bytes = (char*) calloc(hexa_chars->length/2 +1, sizeof(char));
 
 	if(!binary_bytes->bytes){
 		return ERR_OUTMEM;
 	}
 
-	for(i=0; i< byte_len; i++){
-
-		err = hexachar2int(hexa_chars->bytes[2*i], &tmp);
+	err = hexa_decode_strict(hexa_chars->bytes, even_len, binary_bytes->bytes);
+	if(err != SUCCEEDED) return ERR_OUTRAG;
+	binary_bytes->length = 4*even_len;
+	if(even_len < hexa_chars->length){
+		/* an odd number of hexa characters, the last one is the high nibble of a byte */
+		err = hexachar2int(hexa_chars->bytes[even_len], &tmp);
 		if(err != SUCCEEDED) return err;
-
-		if( 2*i <= hexa_chars->length - 2){
-				binary_bytes->bytes[i] = tmp << 4;
-				err = hexachar2int(hexa_chars->bytes[2*i+1], &tmp);
-				if(err != SUCCEEDED) return err;
-				binary_bytes->bytes[i] |= tmp;
-				if( 2*i == hexa_chars->length-2){
-					binary_bytes->length = 8*(i+1);
-					break;
-				}
-		}else{
-			binary_bytes->bytes[i] = tmp << 4;
-			binary_bytes->length = 8*i +4 ;
-			break;
-		}
+		binary_bytes->bytes[even_len/2] = (char) (tmp << 4);
+		binary_bytes->length += 4;
 	}
 	return SUCCEEDED;
 
@@ -106,24 +90,15 @@ int	hexachars2bytes(bytes* hexa_chars, bytes* binary_bytes){
  * 					error number if having an error
  */
 int bytes2hexachars(bytes* binary_bytes, bytes* hexa_chars){
-		int i, tmp, err = 0 ;
 		hexa_chars->length = binary_bytes->length / 4;
-		hexa_chars->bytes = (char*) calloc(hexa_chars->length, sizeof(char));
+		hexa_chars->bytes = (char*) calloc(hexa_chars->length +1, sizeof(char));
 		if( !hexa_chars->bytes)
 			return ERR_OUTMEM;
 
-		for( i = 0; i < hexa_chars->length; i+=2){
-			if(i+1 < hexa_chars->length ){
-				tmp = (binary_bytes->bytes[i/2] & 0xF0) >> 4;
-				if( ( err = int2hexachar(tmp, &hexa_chars->bytes[i])) != SUCCEEDED) return err;
-				tmp = binary_bytes->bytes[i/2] & 0x0F;
-			 	if( (err = int2hexachar(tmp, &hexa_chars->bytes[i+1])) != SUCCEEDED) return err;
-			}else{
-				tmp = (binary_bytes->bytes[i/2+1] & 0xF0) >> 4;
-				if( (err = int2hexachar(tmp, &hexa_chars->bytes[i])) != SUCCEEDED) return err;
-				break;
-			}
-		}
+		hexa_encode(binary_bytes->bytes, hexa_chars->length/2, hexa_chars->bytes);
+		if(hexa_chars->length % 2)
+			/* an odd number of nibbles, the last one is the high nibble of a byte */
+			hexa_chars->bytes[hexa_chars->length -1] = HEXA_DIGITS[(binary_bytes->bytes[hexa_chars->length/2] >> 4) & 0x0F];
 		return SUCCEEDED;
 }
 
@@ -157,115 +132,113 @@ int bytes2hexachars(bytes* binary_bytes, bytes* hexa_chars){
  		printf("The bytes struct has not contained data \n");
  		return;
  	}
- 	setlocale(LC_CTYPE, "C");
  	printf("Each char is seperated with a space.\n If a char is a space, it will be displayed as SP. \n \
  	If a chacter is not printable, it will be display in hexadecimal format. \n");
  	for(i =0 ; i < ptrbytes->length; i++){
  		char ch = *(ptrbytes->bytes +i);
  		/* Is this char printable? */
- 		if( isprint(ch)){
-			if( isspace(ch))
+ 		if( ch >= 0x20 && ch < 0x7F){
+			if( ch == ' ')
 				/* Is this char is a space character */
 				printf(" SP");
 			else
 				printf(" %c", ch);
  		}else{
  		/* This char is not printable, it will be printed in hexadecimal format */
- 			printf(" 0x%x", ch);
+ 			printf(" 0x%c%c", HEXA_DIGITS[(ch >> 4) & 0x0F], HEXA_DIGITS[ch & 0x0F]);
  		}
  	}
- 	setlocale(LC_CTYPE, "");
  }
 
+ #define	CHR_N		0x01		/*!	\brief	a numeric character */
+ #define	CHR_A		0x02		/*!	\brief	a letter */
+ #define	CHR_S		0x04		/*!	\brief	a special character */
+ #define	CHR_P		0x08		/*!	\brief	a pad character (space) */
+ #define	CHR_Z		0x10		/*!	\brief	a track 2 character, 0x30 - 0x3F and the 'D' separator */
+ #define	CHR_X		0x20		/*!	\brief	a debit/credit sign, 'C' or 'D' */
+
+ /*!	\brief	the classes of each character code, they match ::numeric_range, ::letter_range, ::special_range and ::pad_range */
+ static const unsigned char char_class[256] = {
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	/* 0x00 */
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	/* 0x10 */
+	0x08, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04,	/* 0x20 */
+	0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14,	/* 0x30 */
+	0x04, 0x02, 0x02, 0x22, 0x32, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02,	/* 0x40 */
+	0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x04, 0x04, 0x04, 0x04, 0x04,	/* 0x50 */
+	0x04, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02,	/* 0x60 */
+	0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x04, 0x04, 0x04, 0x04, 0x00,	/* 0x70 */
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	/* 0x80 */
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	/* 0x90 */
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	/* 0xA0 */
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	/* 0xB0 */
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	/* 0xC0 */
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	/* 0xD0 */
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	/* 0xE0 */
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00		/* 0xF0 */
+ };
+
+ /*!	\brief	the classes a character may belong to for each datatype, 0 means no restriction */
+ static const unsigned char datatype_mask[] = {
+	0,								/* ISO_BITMAP */
+	CHR_N,							/* ISO_NUMERIC */
+	CHR_A,							/* ISO_ALPHABETIC */
+	0,								/* ISO_BINARY */
+	CHR_Z,							/* ISO_Z */
+	CHR_N | CHR_A,					/* ISO_ALPHANUMERIC */
+	CHR_A | CHR_S,					/* ISO_ALPHASPECIAL */
+	CHR_N | CHR_S,					/* ISO_NUMERICSPECIAL */
+	CHR_N,							/* ISO_XNUMERIC, after the sign */
+	CHR_N | CHR_A | CHR_P,			/* ISO_ALPHANUMERIC_PAD */
+	CHR_N | CHR_A | CHR_S | CHR_P	/* ISO_ALPHANUMERIC_SPC */
+ };
+
+ #ifdef UTILITIES_SIMD
+ /*!		\fn		static int digits_sse2(const char *data, int len)
+ * 			\brief	Check the 16-byte blocks of data for digits
+ * 			\return	the number of bytes checked, less than len/16*16 if a block has a non digit
+ */
+ static int digits_sse2(const char *data, int len){
+	const __m128i zero = _mm_setzero_si128();
+	int i;
+	for(i = 0; i + 16 <= len; i += 16){
+		__m128i d = _mm_sub_epi8(_mm_loadu_si128((const __m128i*) (data + i)), _mm_set1_epi8('0'));
+		if(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(d, _mm_set1_epi8(9)), zero)) != 0xFFFF)
+			break;
+	}
+	return i;
+ }
+ #endif
+
  /*!		\fn		int verify_datatype(bytes*, int)
- * 			\brief	This function checks whether a bytes struct has its data conformed to a specified datatype
+ * 			\brief	This function checks whether a bytes struct has its data conformed to a specified datatype. \n
+ * 						Each character costs one lookup in ::char_class, numeric data is checked 16 characters at a time.
  * 			\param	 ptrbytes a bytes struct pointer that will be verified
  * 			\return   CONFORM(0) if the struct's data conform to the specified datatype
  * 						 NOT_CONFORM if the struct's data doesn't conform to the specified datatype
  */
  int verify_datatype(bytes* ptrbytes, int datatype){
- 	int i=0;
+ 	int i = 0;
+ 	unsigned char mask;
+ 	const unsigned char *data = (const unsigned char*) ptrbytes->bytes;
 
  	/* verify the data of the struct	*/
 	if(verify_bytes(ptrbytes) != HASDATA)
 		return NOT_CONFORM;
-	switch(datatype){
-		case ISO_BINARY:{
-			return CONFORM;
-		}
-		break;
-		case ISO_ALPHABETIC:{			// Alphabetic
-				while(i < ptrbytes->length){
-					if(is_in_range(letter_range, *(ptrbytes->bytes + i)) != IN_RANGE)
-						return NOT_CONFORM;
-					i++;
-				}
-				return CONFORM;
-		}
-		break;
-		case ISO_NUMERIC:{			// Numeric
-				while(i < ptrbytes->length){
-					if(is_in_range(numeric_range, *(ptrbytes->bytes + i)) != IN_RANGE)
-							return NOT_CONFORM;
-					i++;
-				}
-				return CONFORM;
-		}
-		break;
-		case ISO_Z:{			// Z
-			return CONFORM;
-		}
-		break;
-		case ISO_ALPHANUMERIC:{		// AN datatype
-			while(i < ptrbytes->length){
-				if(is_in_range(numeric_range, *(ptrbytes->bytes + i)) != IN_RANGE && is_in_range(letter_range, *(ptrbytes->bytes + i)) != IN_RANGE)
-						return NOT_CONFORM;
-				i++;
-			}
-			return CONFORM;
-		}
-		break;
-		case ISO_ALPHASPECIAL:{		//	AS datatype
-			while(i < ptrbytes->length){
-				if(is_in_range(letter_range, *(ptrbytes->bytes + i)) != IN_RANGE && is_in_range(special_range, *(ptrbytes->bytes + i)) != IN_RANGE)
-						return NOT_CONFORM;
-				i++;
-			}
-			return CONFORM;
-		}
-		break;
-		case ISO_NUMERICSPECIAL:{	//	NS datatype
-			while(i < ptrbytes->length){
-				if(is_in_range(numeric_range, *(ptrbytes->bytes + i)) != IN_RANGE && is_in_range(special_range, *(ptrbytes->bytes + i)) != IN_RANGE)
-						return NOT_CONFORM;
-				i++;
-			}
-			return CONFORM;
-		}
-		break;
-		case ISO_ALPHANUMERIC_PAD:{		// ANP datatype
-			while(i < ptrbytes->length){
-				if(is_in_range(numeric_range, *(ptrbytes->bytes + i)) != IN_RANGE && is_in_range(letter_range, *(ptrbytes->bytes + i)) != IN_RANGE \
-				&& is_in_range(pad_range, *(ptrbytes->bytes + i)) != IN_RANGE)
-						return NOT_CONFORM;
-				i++;
-			}
-			return CONFORM;
-		}
-		break;
-		case ISO_ALPHANUMERIC_SPC:{		// ANS datatype
-			while(i < ptrbytes->length){
-				if(is_in_range(numeric_range, *(ptrbytes->bytes + i)) != IN_RANGE && is_in_range(numeric_range, *(ptrbytes->bytes + i)) != IN_RANGE \
-				&& is_in_range(special_range, *(ptrbytes->bytes + i)) != IN_RANGE)
-						return NOT_CONFORM;
-				i++;
-			}
-			return CONFORM;
-		}
-		break;
-		default:
-		break;
+	if(datatype < 0 || datatype > ISO_ALPHANUMERIC_SPC || (mask = datatype_mask[datatype]) == 0)
+		return CONFORM;
+	if(datatype == ISO_XNUMERIC){
+		/* the first character is the 'C' or 'D' sign */
+		if(!(char_class[data[0]] & CHR_X))
+			return NOT_CONFORM;
+		i = 1;
 	}
+ #ifdef UTILITIES_SIMD
+	if(mask == CHR_N)
+		i += digits_sse2(ptrbytes->bytes + i, ptrbytes->length - i);
+ #endif
+	for(; i < ptrbytes->length; i++)
+		if(!(char_class[data[i]] & mask))
+			return NOT_CONFORM;
 	return CONFORM;
  }
 
@@ -321,7 +294,8 @@ int export_data(bytes* ptrbytes, char** ptrchar, int* ptrlen){
  }
 
 /*!	\func		int append_bytes(bytes* ptrdes, bytes*ptrsrc)
- * 		\brief		This function appends data of a bytes struct to another bytes struct.
+ * 		\brief		This function appends data of a bytes struct to another bytes struct. \n
+ * 						The memory of ptrdes is reallocated, it must come from ::import_data.
  * 		\param		ptrdes is a bytes struct pointer of the destination bytes
  * 		\param		ptrsrc is a bytes struct pointer of the source bytes
  * 		\return		SUCCEEDED (0) if successfully copied \n
@@ -329,20 +303,18 @@ int export_data(bytes* ptrbytes, char** ptrchar, int* ptrlen){
  */
 int append_bytes(bytes* ptrdes, bytes*ptrsrc){
 	char* tmp;
-	int err = 0;
 	int len = ptrdes->length + ptrsrc->length;
 	if( verify_bytes(ptrsrc) != HASDATA){
 		return ERR_APDNUL;
 	}
-	tmp = (char*) calloc( len , sizeof(char));
+	/* the destination grows in place when the allocator can extend it */
+	tmp = (char*) realloc(ptrdes->bytes, len);
 	if(tmp == NULL)
 		return ERR_OUTMEM;
-	memcpy(tmp, ptrdes->bytes, ptrdes->length);
 	memcpy(tmp + ptrdes->length, ptrsrc->bytes, ptrsrc->length);
-	free_bytes(ptrdes);
-	err = import_data(ptrdes, tmp, len);
-	free(tmp);
-	return err;
+	ptrdes->bytes = tmp;
+	ptrdes->length = len;
+	return SUCCEEDED;
 }
 
 /*!	\func
@@ -355,29 +327,24 @@ int append_bytes(bytes* ptrdes, bytes*ptrsrc){
  */
 int insert_bytes(bytes* ptrdes, bytes* ptrsrc, int pos){
 	char* tmp;
-	int err=0, len;
+	int len, at;
 	/* verify ptrsrc data */
 	if( verify_bytes(ptrsrc) != HASDATA)
 		return ERR_INSNUL;
 	if( pos < 0 || pos > ptrdes->length+1)
 		return ERR_IVLPOS;
 
+	/* pos counts from 1, 0 inserts at the start too */
+	at = (pos == 0)? 0 : pos - 1;
 	len = ptrdes->length + ptrsrc->length;
-	tmp = (char*) calloc(len, sizeof(char));
+	tmp = (char*) realloc(ptrdes->bytes, len);
 	if(tmp == NULL)
 		return ERR_OUTMEM;
-	if( pos == 0){
-		memcpy(tmp, ptrsrc->bytes, ptrsrc->length);
-		memcpy(tmp + ptrsrc->length, ptrdes->bytes, ptrdes->length);
-	}else{
-		memcpy(tmp, ptrdes->bytes, pos-1);
-		memcpy(tmp + pos-1, ptrsrc->bytes, ptrsrc->length);
-		memcpy(tmp + pos -1 + ptrsrc->length, ptrdes->bytes+ pos -1, len - pos - ptrsrc->length +1);
-	}
-	free_bytes(ptrdes);
-	err = import_data(ptrdes, tmp, len);
-	free(tmp);
-	return err;
+	memmove(tmp + at + ptrsrc->length, tmp + at, ptrdes->length - at);
+	memcpy(tmp + at, ptrsrc->bytes, ptrsrc->length);
+	ptrdes->bytes = tmp;
+	ptrdes->length = len;
+	return SUCCEEDED;
 }
 
  /*!		\fn 	set_length(bytes*, int)
@@ -424,7 +391,8 @@ int	int2bin(unsigned int in){
 }
 
 /*!	\fn			int left_pad(bytes*, char);
- * 		\brief 		This function pads the left side of a byte array with a character
+ * 		\brief 		This function pads the left side of a byte array with a character. \n
+ * 						The memory is reallocated once, use a ::bytebuf to pad without moving the data.
  * 		\param		ptrbytes	a pointer to a ::bytes struct to be padded
  * 		\param		max_len	the maximum length after padding
  * 		\param		ch	a charater that will be used to pad with
@@ -432,7 +400,7 @@ int	int2bin(unsigned int in){
  * 						error number if having an error
  */
 int left_pad(bytes* ptrbytes, int max_len, char ch){
-	int i = 0, err = 0 ;
+	int err = 0, pad;
 	char* tmp_bytes;
 
 	/* verify the bytes struct */
@@ -442,23 +410,16 @@ int left_pad(bytes* ptrbytes, int max_len, char ch){
 
 	if( ptrbytes->length > max_len)
 		return ERR_OVRLEN;
-	tmp_bytes = (char*) calloc( max_len, sizeof(char));
+	/* grow the buffer, then move the data to the right of the padding */
+	tmp_bytes = (char*) realloc(ptrbytes->bytes, max_len);
 	if(tmp_bytes == NULL){
 		return ERR_OUTMEM;
 	}
-	memcpy(tmp_bytes + (max_len - ptrbytes->length), ptrbytes->bytes, ptrbytes->length);
-	for(i = 0; i < (max_len - ptrbytes->length); i ++){
-		*(tmp_bytes + i) = ch;
-	}
-	/* free the old bytes struct */
-	free_bytes(ptrbytes);
-
-	/* create a new bytes struct */
-	err = import_data(ptrbytes, tmp_bytes, max_len);
-	if(err != SUCCEEDED){
-		free(tmp_bytes);
-		return err;
-	}
+	pad = max_len - ptrbytes->length;
+	memmove(tmp_bytes + pad, tmp_bytes, ptrbytes->length);
+	memset(tmp_bytes, ch, pad);
+	ptrbytes->bytes = tmp_bytes;
+	ptrbytes->length = max_len;
 	return SUCCEEDED;
 }
 
@@ -471,7 +432,7 @@ int left_pad(bytes* ptrbytes, int max_len, char ch){
  * 						error number if having an error
  */
 int right_pad(bytes* ptrbytes, int max_len, char ch){
-	int i = 0, err = 0 ;
+	int err = 0 ;
 	char* tmp_bytes;
 
 	/* verify the bytes struct */
@@ -481,28 +442,20 @@ int right_pad(bytes* ptrbytes, int max_len, char ch){
 
 	if( ptrbytes->length > max_len)
 		return ERR_OVRLEN;
-	tmp_bytes = (char*) calloc( max_len, sizeof(char));
+	/* grow the buffer, the data stays in place */
+	tmp_bytes = (char*) realloc(ptrbytes->bytes, max_len);
 	if(tmp_bytes == NULL){
 		return ERR_OUTMEM;
 	}
-	memcpy(tmp_bytes, ptrbytes->bytes, ptrbytes->length);
-	for(i = ptrbytes->length; i < max_len; i ++){
-		*(tmp_bytes + i) = ch;
-	}
-	/* free the old bytes struct */
-	free_bytes(ptrbytes);
-
-	/* create a new bytes struct */
-	err = import_data(ptrbytes, tmp_bytes, max_len);
-	if(err != SUCCEEDED){
-		free(tmp_bytes);
-		return err;
-	}
+	memset(tmp_bytes + ptrbytes->length, ch, max_len - ptrbytes->length);
+	ptrbytes->bytes = tmp_bytes;
+	ptrbytes->length = max_len;
 	return SUCCEEDED;
 }
 
 /*!	\fn			int left_trim(bytes*, char);
- * 		\brief 		This function trims the left side of a byte array
+ * 		\brief 		This function trims the left side of a byte array, in place. \n
+ * 						Nothing is allocated, a fully trimmed struct keeps its buffer with a length of 0.
  * 		\param		ptrbytes	a pointer to a ::bytes struct to be trimmed
  * 		\param		ch	a charater that will be trimmed out
  * 		\return		SUCCEEDED if successfully trimming \n
@@ -510,60 +463,112 @@ int right_pad(bytes* ptrbytes, int max_len, char ch){
  */
 int left_trim(bytes* ptrbytes, char ch){
 	int i = 0, err = 0 ;
-	bytes tmp_bytes;
 	err = verify_bytes(ptrbytes) ;
 	if(err != HASDATA)
 		return err;
-	/* copy data to a temporary struct */
-	empty_bytes(&tmp_bytes);
-	err = import_data(&tmp_bytes, ptrbytes->bytes, ptrbytes->length);
-	if(err != SUCCEEDED)
-		return err;
-	free_bytes(ptrbytes);
-	/* process the temporary struct */
-	while(*(tmp_bytes.bytes + i) == ch && i < tmp_bytes.length){
+	while(i < ptrbytes->length && *(ptrbytes->bytes + i) == ch){
 		i++;
 	}
-	if(i < tmp_bytes.length){
-		err = import_data(ptrbytes, tmp_bytes.bytes + i, tmp_bytes.length - i);
-		free_bytes(&tmp_bytes);
-		setlocale(LC_CTYPE, "");
-		return err;
-	}
-	setlocale(LC_CTYPE, "");
-	free_bytes(&tmp_bytes);
+	/* the data is moved in place, the buffer keeps its size */
+	if(i > 0)
+		memmove(ptrbytes->bytes, ptrbytes->bytes + i, ptrbytes->length - i);
+	ptrbytes->length -= i;
 	return SUCCEEDED;
 }
 
 /*!	\fn		int right_trim(bytes*, char);
- * 		\brief 	This function trims the right side of a byte array
+ * 		\brief 	This function trims the right side of a byte array, in place. \n
+ * 					Nothing is allocated, a fully trimmed struct keeps its buffer with a length of 0.
  * 		\param		ptrbytes	a pointer to a ::bytes struct to be trimmed
  * 		\param		ch	a charater that will be trimmed out
  * 		\return		SUCCEEDED if successfully trimming \n
  * 						error number			 if having an error
  */
 int right_trim(bytes* ptrbytes, char ch){
-	int i = ptrbytes->length -1, err = 0 ;
-	bytes tmp_bytes;
+	int i = ptrbytes->length, err = 0 ;
 	err = verify_bytes(ptrbytes) ;
 	if(err != HASDATA)
 		return err;
-	/* copy data to a temporary struct */
-	empty_bytes(&tmp_bytes);
-	err = import_data(&tmp_bytes, ptrbytes->bytes, ptrbytes->length);
-	if(err != SUCCEEDED)
-		return err;
-	free_bytes(ptrbytes);
-	/* process the temporary struct */
-	while(*(tmp_bytes.bytes + i) == ch && i >=0 ){
+	while(i > 0 && *(ptrbytes->bytes + i - 1) == ch){
 		i--;
 	}
-	if(i >= 0){
-		err = import_data(ptrbytes, tmp_bytes.bytes, i+1);
-		free_bytes(&tmp_bytes);
-		return err;
+	ptrbytes->length = i;
+	return SUCCEEDED;
+}
+
+/*!	\fn		int import_data_arena(isoarena*, bytes*, const char*, int)
+ * 		\brief	This function copies data to a bytes struct whose memory comes from an arena. \n
+ * 					The struct must not be freed by ::free_bytes, its memory goes back with the arena.
+ * 		\param		a		the arena that holds the copy
+ * 		\param		ptrbytes	the bytes struct that will point to the copy
+ * 		\param		ptrchar	the data to copy
+ * 		\param		len		the length of the data
+ * 		\return		SUCCEEDED if successfully copied \n
+ * 						ERR_OUTMEM if the arena can't grow
+ */
+int import_data_arena(isoarena* a, bytes* ptrbytes, const char* ptrchar, int len){
+	char *p = (char*) arena_alloc(a, len);
+	if(p == NULL){
+		empty_bytes(ptrbytes);
+		return ERR_OUTMEM;
 	}
-	free_bytes(&tmp_bytes);
+	memcpy(p, ptrchar, len);
+	ptrbytes->bytes = p;
+	ptrbytes->length = len;
+	return SUCCEEDED;
+}
+
+/*!	\fn		int left_pad_arena(isoarena*, bytes*, int, char)
+ * 		\brief 	This function pads the left side of a byte array with a character, the result comes from an arena. \n
+ * 					The old data is left in its place, it is given back with the arena or by its owner.
+ * 		\param		a		the arena that holds the result
+ * 		\param		ptrbytes	a pointer to a ::bytes struct to be padded
+ * 		\param		max_len	the length after padding
+ * 		\param		ch	a charater that will be used to pad with
+ * 		\return		SUCCEEDED if successfully padding \n
+ * 						error number if having an error
+ */
+int left_pad_arena(isoarena* a, bytes* ptrbytes, int max_len, char ch){
+	char *p;
+	int err = verify_bytes(ptrbytes);
+	if(err != HASDATA)
+		return err;
+	if(ptrbytes->length > max_len)
+		return ERR_OVRLEN;
+	p = (char*) arena_alloc(a, max_len);
+	if(p == NULL)
+		return ERR_OUTMEM;
+	memset(p, ch, max_len - ptrbytes->length);
+	memcpy(p + max_len - ptrbytes->length, ptrbytes->bytes, ptrbytes->length);
+	ptrbytes->bytes = p;
+	ptrbytes->length = max_len;
+	return SUCCEEDED;
+}
+
+/*!	\fn		int right_pad_arena(isoarena*, bytes*, int, char)
+ * 		\brief 	This function pads the right side of a byte array with a character, the result comes from an arena. \n
+ * 					The old data is left in its place, it is given back with the arena or by its owner.
+ * 		\param		a		the arena that holds the result
+ * 		\param		ptrbytes	a pointer to a ::bytes struct to be padded
+ * 		\param		max_len	the length after padding
+ * 		\param		ch	a charater that will be used to pad with
+ * 		\return		SUCCEEDED if successfully padding \n
+ * 						error number if having an error
+ */
+int right_pad_arena(isoarena* a, bytes* ptrbytes, int max_len, char ch){
+	char *p;
+	int err = verify_bytes(ptrbytes);
+	if(err != HASDATA)
+		return err;
+	if(ptrbytes->length > max_len)
+		return ERR_OVRLEN;
+	p = (char*) arena_alloc(a, max_len);
+	if(p == NULL)
+		return ERR_OUTMEM;
+	memcpy(p, ptrbytes->bytes, ptrbytes->length);
+	memset(p + ptrbytes->length, ch, max_len - ptrbytes->length);
+	ptrbytes->bytes = p;
+	ptrbytes->length = max_len;
 	return SUCCEEDED;
 }
 
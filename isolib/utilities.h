@@ -4,6 +4,8 @@
 #ifndef UTILITIES_H_
 #define UTILITIES_H_
 
+#include "arena.h"
+
 #define  HASDATA	0		/* contain data */
 #define  LENZERO	1		/* length is zero */
 #define 	DATNULL	2		/* data is null */
@@ -129,6 +131,15 @@ int left_trim(bytes*, char);
  */
 int right_trim(bytes*, char);
 
+/*!	\brief 	This function copies data to a bytes struct whose memory comes from an arena */
+int import_data_arena(isoarena*, bytes*, const char*, int);
+
+/*!	\brief 	This function pads the left side of a byte array with a character, the result comes from an arena */
+int left_pad_arena(isoarena*, bytes*, int, char);
+
+/*!	\brief 	This function pads the right side of a byte array with a character, the result comes from an arena */
+int right_pad_arena(isoarena*, bytes*, int, char);
+
 /*!	\fn	int is_in_range(int** , char);
  * 		\brief 	check whether a char is in a character range
  */
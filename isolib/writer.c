@@ -0,0 +1,361 @@
+/*!	\file		writer.c
+ * 		\brief	This file implements the output writer. \n
+ * 					Every kind of writer appends to a ::bytebuf. A WRITER_BUFFER writer keeps growing it,
+ * 					the other kinds send it to their output whenever WRITER_CHUNK bytes are collected,
+ * 					so a writer of any kind writes documents of any length.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "writer.h"
+#include "errors.h"
+#include "hexa.h"
+#include "base64.h"
+
+/*!	\brief	The entity of each character that must be escaped in an xml attribute, NULL for the others */
+static const char *xml_entity[256] = {
+	['&'] = "&amp;", ['<'] = "&lt;", ['>'] = "&gt;", ['"'] = "&quot;", ['\''] = "&apos;"
+};
+
+/*!	\func	static void init_writer(isowriter *w, int kind)
+ * 		\brief	Initialize the fields that every kind of writer has
+ */
+static void init_writer(isowriter *w, int kind){
+	w->kind = kind;
+	init_bytebuf(&w->out);
+	w->fp = NULL;
+	w->fd = -1;
+	w->sink = NULL;
+	w->ctx = NULL;
+	w->err = SUCCEEDED;
+}
+
+/*!	\func	void init_writer_buffer(isowriter *w);
+ * 		\brief	Initialize a writer whose output stays in a buffer that grows as needed. \n
+ * 					The output is taken by ::writer_detach.
+ * 		\param	w is the ::isowriter to initialize
+ */
+void init_writer_buffer(isowriter *w){
+	init_writer(w, WRITER_BUFFER);
+}
+
+/*!	\func	void init_writer_file(isowriter *w, FILE *fp);
+ * 		\brief	Initialize a writer whose output goes to a FILE
+ * 		\param	w is the ::isowriter to initialize
+ * 		\param	fp is the FILE, it is not closed by the writer
+ */
+void init_writer_file(isowriter *w, FILE *fp){
+	init_writer(w, WRITER_FILE);
+	w->fp = fp;
+}
+
+/*!	\func	void init_writer_fd(isowriter *w, int fd);
+ * 		\brief	Initialize a writer whose output goes to a file descriptor, e.g. a socket
+ * 		\param	w is the ::isowriter to initialize
+ * 		\param	fd is the file descriptor, it is not closed by the writer
+ */
+void init_writer_fd(isowriter *w, int fd){
+	init_writer(w, WRITER_FD);
+	w->fd = fd;
+}
+
+/*!	\func	void init_writer_sink(isowriter *w, isosink sink, void *ctx);
+ * 		\brief	Initialize a writer whose output goes to a callback
+ * 		\param	w is the ::isowriter to initialize
+ * 		\param	sink is the callback, it receives ctx and up to WRITER_CHUNK bytes at a time
+ * 		\param	ctx is passed to sink
+ */
+void init_writer_sink(isowriter *w, isosink sink, void *ctx){
+	init_writer(w, WRITER_SINK);
+	w->sink = sink;
+	w->ctx = ctx;
+}
+
+/*!	\func	static int send_output(isowriter *w, const char *data, int len)
+ * 		\brief	Send bytes to the output of a writer that is not a WRITER_BUFFER one
+ * 		\return	SUCCEEDED if having no error \n
+ * 					ERR_IOWRIT if the output fails \n
+ * 					the error of the callback
+ */
+static int send_output(isowriter *w, const char *data, int len){
+	ssize_t n;
+	switch(w->kind){
+		case WRITER_FILE:
+			if(len > 0 && fwrite(data, 1, len, w->fp) != (size_t) len)
+				return ERR_IOWRIT;
+			return SUCCEEDED;
+		case WRITER_FD:
+			while(len > 0){
+				n = write(w->fd, data, len);
+				if(n < 0){
+					if(errno == EINTR)
+						continue;
+					return ERR_IOWRIT;
+				}
+				data += n;
+				len -= n;
+			}
+			return SUCCEEDED;
+		case WRITER_SINK:
+			return w->sink(w->ctx, data, len);
+		default:
+			break;
+	}
+	return SUCCEEDED;
+}
+
+/*!	\func	int flush_writer(isowriter *w);
+ * 		\brief	Send the buffered output to the FILE, the descriptor or the callback of a writer. \n
+ * 					A WRITER_FILE writer also flushes its FILE. Nothing is done for a WRITER_BUFFER writer.
+ * 		\param	w is an ::isowriter
+ * 		\return	SUCCEEDED if having no error \n
+ * 					the first error of the writer
+ */
+int flush_writer(isowriter *w){
+	if(w->err != SUCCEEDED || w->kind == WRITER_BUFFER)
+		return w->err;
+	if(w->out.data.length > 0)
+		w->err = send_output(w, w->out.data.bytes, w->out.data.length);
+	clear_bytebuf(&w->out);
+	if(w->err == SUCCEEDED && w->kind == WRITER_FILE && fflush(w->fp) != 0)
+		w->err = ERR_IOWRIT;
+	return w->err;
+}
+
+/*!	\func	static char* writer_room(isowriter *w, int len)
+ * 		\brief	Make room for len bytes at the end of the output, flushing it first if a chunk is full
+ * 		\return	the end of the output, NULL if the writer has an error
+ */
+static char* writer_room(isowriter *w, int len){
+	int err;
+	if(w->err != SUCCEEDED)
+		return NULL;
+	if(w->kind != WRITER_BUFFER && w->out.data.length > 0 && w->out.data.length + len > WRITER_CHUNK){
+		err = send_output(w, w->out.data.bytes, w->out.data.length);
+		clear_bytebuf(&w->out);
+		if(err != SUCCEEDED){
+			w->err = err;
+			return NULL;
+		}
+	}
+	err = bytebuf_reserve(&w->out, len);
+	if(err != SUCCEEDED){
+		w->err = err;
+		return NULL;
+	}
+	return w->out.data.bytes + w->out.data.length;
+}
+
+/*!	\func	int writer_write(isowriter *w, const char *data, int len);
+ * 		\brief	Write bytes. A chunk or more is sent straight to the output of a writer that is not a WRITER_BUFFER one.
+ * 		\param	w is an ::isowriter
+ * 		\param	data is the bytes to write
+ * 		\param	len is the length of data
+ * 		\return	SUCCEEDED if having no error \n
+ * 					the first error of the writer
+ */
+int writer_write(isowriter *w, const char *data, int len){
+	char *p;
+	if(w->kind != WRITER_BUFFER && len >= WRITER_CHUNK){
+		if(flush_writer(w) == SUCCEEDED)
+			w->err = send_output(w, data, len);
+		return w->err;
+	}
+	p = writer_room(w, len);
+	if(p == NULL)
+		return w->err;
+	memcpy(p, data, len);
+	w->out.data.length += len;
+	return SUCCEEDED;
+}
+
+/*!	\func	int writer_string(isowriter *w, const char *str);
+ * 		\brief	Write a string terminated by '\0', the '\0' is not written
+ * 		\param	w is an ::isowriter
+ * 		\param	str is the string to write
+ * 		\return	SUCCEEDED if having no error \n
+ * 					the first error of the writer
+ */
+int writer_string(isowriter *w, const char *str){
+	return writer_write(w, str, strlen(str));
+}
+
+/*!	\func	int writer_char(isowriter *w, char ch);
+ * 		\brief	Write a character
+ * 		\param	w is an ::isowriter
+ * 		\param	ch is the character to write
+ * 		\return	SUCCEEDED if having no error \n
+ * 					the first error of the writer
+ */
+int writer_char(isowriter *w, char ch){
+	char *p = writer_room(w, 1);
+	if(p == NULL)
+		return w->err;
+	*p = ch;
+	w->out.data.length++;
+	return SUCCEEDED;
+}
+
+/*!	\func	int writer_int(isowriter *w, long n);
+ * 		\brief	Write an integer in decimal. The digits are produced from the right into a small buffer,
+ * 					without going through the printf machinery.
+ * 		\param	w is an ::isowriter
+ * 		\param	n is the integer to write
+ * 		\return	SUCCEEDED if having no error \n
+ * 					the first error of the writer
+ */
+int writer_int(isowriter *w, long n){
+	char digits[24];
+	char *p = digits + sizeof(digits);
+	unsigned long u = (n < 0)? 0UL - (unsigned long) n : (unsigned long) n;
+	do{
+		*--p = '0' + (char) (u % 10);
+		u /= 10;
+	}while(u != 0);
+	if(n < 0)
+		*--p = '-';
+	return writer_write(w, p, (int) (digits + sizeof(digits) - p));
+}
+
+/*!	\func	int writer_hexa(isowriter *w, const char *data, int len);
+ * 		\brief	Write bytes as uppercase hexa characters, two per byte, encoded straight into the output
+ * 		\param	w is an ::isowriter
+ * 		\param	data is the bytes to write
+ * 		\param	len is the length of data
+ * 		\return	SUCCEEDED if having no error \n
+ * 					the first error of the writer
+ */
+int writer_hexa(isowriter *w, const char *data, int len){
+	int n;
+	char *p;
+	while(len > 0){
+		/* a writer that flushes takes the bytes a chunk at a time */
+		n = (w->kind != WRITER_BUFFER && len > WRITER_CHUNK/2)? WRITER_CHUNK/2 : len;
+		p = writer_room(w, 2*n);
+		if(p == NULL)
+			return w->err;
+		hexa_encode(data, n, p);
+		w->out.data.length += 2*n;
+		data += n;
+		len -= n;
+	}
+	return w->err;
+}
+
+/*!	\func	int writer_xml(isowriter *w, const char *data, int len);
+ * 		\brief	Write bytes as the value of an xml attribute. \n
+ * 					The markup characters & < > " ' are written as entities, the runs of other characters are
+ * 					copied as they are.
+ * 		\param	w is an ::isowriter
+ * 		\param	data is the bytes to write
+ * 		\param	len is the length of data
+ * 		\return	SUCCEEDED if having no error \n
+ * 					the first error of the writer
+ */
+int writer_xml(isowriter *w, const char *data, int len){
+	int i, start = 0;
+	const char *entity;
+	for(i = 0; i < len; i++){
+		entity = xml_entity[(unsigned char) data[i]];
+		if(entity == NULL)
+			continue;
+		if(i > start)
+			writer_write(w, data + start, i - start);
+		writer_string(w, entity);
+		start = i + 1;
+	}
+	if(len > start)
+		writer_write(w, data + start, len - start);
+	return w->err;
+}
+
+/*!	\func	int writer_base64(isowriter *w, const char *data, int len);
+ * 		\brief	Write bytes as base64 characters, encoded straight into the output
+ * 		\param	w is an ::isowriter
+ * 		\param	data is the bytes to write
+ * 		\param	len is the length of data
+ * 		\return	SUCCEEDED if having no error \n
+ * 					the first error of the writer
+ */
+int writer_base64(isowriter *w, const char *data, int len){
+	int n;
+	char *p;
+	while(len > 0){
+		/* a writer that flushes takes the bytes a chunk at a time, only the last one may be padded */
+		n = (w->kind != WRITER_BUFFER && len > WRITER_CHUNK/4*3)? WRITER_CHUNK/4*3 : len;
+		p = writer_room(w, BASE64_LEN(n));
+		if(p == NULL)
+			return w->err;
+		base64_encode(data, n, p);
+		w->out.data.length += BASE64_LEN(n);
+		data += n;
+		len -= n;
+	}
+	return w->err;
+}
+
+/*!	\func	int writer_json(isowriter *w, const char *data, int len);
+ * 		\brief	Write bytes as the content of a json string. \n
+ * 					The quote, the backslash and the control characters are escaped, the runs of other
+ * 					characters are copied as they are.
+ * 		\param	w is an ::isowriter
+ * 		\param	data is the bytes to write
+ * 		\param	len is the length of data
+ * 		\return	SUCCEEDED if having no error \n
+ * 					the first error of the writer
+ */
+int writer_json(isowriter *w, const char *data, int len){
+	int i, start = 0;
+	unsigned char ch;
+	char esc[6] = {'\\', 'u', '0', '0'};
+	for(i = 0; i < len; i++){
+		ch = (unsigned char) data[i];
+		if(ch >= 0x20 && ch != '"' && ch != '\\' && ch != 0x7F)
+			continue;
+		if(i > start)
+			writer_write(w, data + start, i - start);
+		if(ch == '"' || ch == '\\'){
+			esc[1] = (char) ch;
+			writer_write(w, esc, 2);
+		}else{
+			esc[1] = 'u';
+			esc[4] = HEXA_DIGITS[ch >> 4];
+			esc[5] = HEXA_DIGITS[ch & 0x0F];
+			writer_write(w, esc, 6);
+		}
+		start = i + 1;
+	}
+	if(len > start)
+		writer_write(w, data + start, len - start);
+	return w->err;
+}
+
+/*!	\func	char* writer_detach(isowriter *w, int *len);
+ * 		\brief	Take the output of a WRITER_BUFFER writer. The writer is left empty.
+ * 		\param	w is an ::isowriter initialized by ::init_writer_buffer
+ * 		\param	len receives the length of the output, it may be NULL
+ * 		\return	the output terminated by '\0', the caller frees it \n
+ * 					NULL if the writer has an error
+ */
+char* writer_detach(isowriter *w, int *len){
+	bytes out;
+	char *p = writer_room(w, 1);
+	if(p == NULL){
+		free_bytebuf(&w->out);
+		return NULL;
+	}
+	*p = '\0';
+	bytebuf_detach(&w->out, &out);
+	if(len != NULL)
+		*len = out.length;
+	return out.bytes;
+}
+
+/*!	\func	void free_writer(isowriter *w);
+ * 		\brief	Free the buffer of a writer, the output that is not flushed is dropped
+ * 		\param	w is an ::isowriter
+ */
+void free_writer(isowriter *w){
+	free_bytebuf(&w->out);
+}
@@ -0,0 +1,87 @@
+/*!	\file		writer.h
+ * 		\brief	An output writer that appends text to a growable buffer, a FILE, a file descriptor or a callback
+ */
+#ifndef WRITER_H_
+#define WRITER_H_
+
+#include <stdio.h>
+#include "bytebuf.h"
+
+#define WRITER_BUFFER		0		/*!	\brief	The output stays in the buffer of the writer */
+#define WRITER_FILE			1		/*!	\brief	The output goes to a FILE */
+#define WRITER_FD			2		/*!	\brief	The output goes to a file descriptor */
+#define WRITER_SINK			3		/*!	\brief	The output goes to a callback */
+
+/*!	\brief	The number of bytes a writer keeps before it flushes them to a FILE, a descriptor or a callback */
+#define WRITER_CHUNK		4096
+
+/*!	\brief	A callback that receives the output of a writer, it returns SUCCEEDED or an error number */
+typedef int (*isosink)(void *ctx, const char *data, int len);
+
+/*!	\struct		isowriter
+ * 		\brief		An output writer. \n
+ * 						The output is collected in a ::bytebuf that tracks its own end, so a write costs the
+ * 						length of what is written whatever was written before.
+ */
+typedef struct {
+	/*! \brief The kind of output, one of WRITER_BUFFER, WRITER_FILE, WRITER_FD, WRITER_SINK */
+	int kind;
+	/*! \brief The output not flushed yet, the whole output for WRITER_BUFFER */
+	bytebuf out;
+	/*! \brief The FILE of WRITER_FILE */
+	FILE *fp;
+	/*! \brief The file descriptor of WRITER_FD */
+	int fd;
+	/*! \brief The callback of WRITER_SINK and its context */
+	isosink sink;
+	void *ctx;
+	/*! \brief The first error, the writes after it are ignored */
+	int err;
+} isowriter;
+
+/*!	\brief	Initialize a writer whose output stays in a growable buffer */
+void init_writer_buffer(isowriter *w);
+
+/*!	\brief	Initialize a writer whose output goes to a FILE */
+void init_writer_file(isowriter *w, FILE *fp);
+
+/*!	\brief	Initialize a writer whose output goes to a file descriptor */
+void init_writer_fd(isowriter *w, int fd);
+
+/*!	\brief	Initialize a writer whose output goes to a callback */
+void init_writer_sink(isowriter *w, isosink sink, void *ctx);
+
+/*!	\brief	Write len bytes */
+int writer_write(isowriter *w, const char *data, int len);
+
+/*!	\brief	Write a string terminated by '\0' */
+int writer_string(isowriter *w, const char *str);
+
+/*!	\brief	Write a character */
+int writer_char(isowriter *w, char ch);
+
+/*!	\brief	Write an integer in decimal */
+int writer_int(isowriter *w, long n);
+
+/*!	\brief	Write bytes as hexa characters */
+int writer_hexa(isowriter *w, const char *data, int len);
+
+/*!	\brief	Write bytes as the value of an xml attribute, escaping the markup characters */
+int writer_xml(isowriter *w, const char *data, int len);
+
+/*!	\brief	Write bytes as base64 characters */
+int writer_base64(isowriter *w, const char *data, int len);
+
+/*!	\brief	Write bytes as the content of a json string, escaping the quote, the backslash and the control characters */
+int writer_json(isowriter *w, const char *data, int len);
+
+/*!	\brief	Send the buffered output to the FILE, the descriptor or the callback */
+int flush_writer(isowriter *w);
+
+/*!	\brief	Take the output of a WRITER_BUFFER writer as a string terminated by '\0' */
+char* writer_detach(isowriter *w, int *len);
+
+/*!	\brief	Free the buffer of a writer, the buffered output is dropped */
+void free_writer(isowriter *w);
+
+#endif /*WRITER_H_*/
@@ -1,111 +1,89 @@
 /* Created by Anjuta version 1.2.3 */
 /*	This file will not be overwritten */
 
+/*
+ * An ISO 8583 test server: the messages are iso87 with a hexa bitmap, framed by a 4-digit length
+ * header. Each request is answered with its fields, the response MTI and the response code 00.
+ * It serves every terminal from one thread, see server.h.
+ *
+ * 	usage: main [port]		the port is 7000 by default
+ */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
 #include "iso8583.h"
-#include "convert.h"
 #include "iso8583_std.h"
-#include <sys/types.h>
-#include <sys/socket.h> 
-#include <netinet/in.h>
+#include "errors.h"
+#include "server.h"
 
+static isoserver srv;
+static long served;
+/* the errors of the requests, a peer that sends malformed frames is disconnected without any log */
+static isoerr srv_err;
 
-int main()
+static void on_signal(int sig)
 {
-	int mssock, membersoc;
-	struct sockaddr_in address, client_add;
-	int soklen;
-	char *buf;
-	soklen = sizeof(address);
-    if ((mssock = socket(AF_INET,SOCK_STREAM,0)) < 0) {
-        perror("server: socket");
-        exit(1);
-    }
-	/* type of socket created in socket() */
-	address.sin_family = AF_INET;
-  	address.sin_addr.s_addr = INADDR_ANY;
-	/* 7000 is the port to use for connections */
-  	address.sin_port = htons(7000);
-	/* bind the socket to the port specified above */
- 	if (bind(mssock,(struct sockaddr *)&address,sizeof(address)) < 0)
-	{
-		perror("server: socket");
-		exit(1);
+	stop_server(&srv);
+}
+
+/*
+ * Answer a request: its fields refer to the received bytes, they are packed again as they are,
+ * only the MTI and the response code are replaced.
+ */
+static int answer(isoconn *c, isoview *req, char *resp, int resp_size, int *resp_len, void *arg)
+{
+	const isoplan *plan = (const isoplan*) arg;
+	bytes fld[129];
+	isobitmap bmp = req->bitmap;
+	isofldit it;
+	char mti[4];
+	const char *data;
+	int i, len;
+
+	if (view_field(req, 0, &data, &len) != SUCCEEDED || len != 4)
+		return SERVER_CLOSE;
+	/* 0200 -> 0210, 0800 -> 0810 */
+	memcpy(mti, data, 4);
+	mti[2]++;
+	fld[0].bytes = mti;
+	fld[0].length = 4;
+	fldit_init(&it, &bmp);
+	while ((i = fldit_next(&it)) != 0) {
+		if (view_field(req, i, &data, &len) != SUCCEEDED)
+			return SERVER_CLOSE;
+		fld[i].bytes = (char*) data;
+		fld[i].length = len;
+	}
+	bitmap_set(&bmp, 39);
+	fld[39].bytes = "00";
+	fld[39].length = 2;
+	if (pack_fields(plan, &bmp, fld, resp, resp_size, resp_len, req->err) != SUCCEEDED) {
+		*resp_len = 0;
+		return SERVER_CLOSE;
 	}
-	if (listen(mssock, 3) < 0)
-	{
+	served++;
+	return SUCCEEDED;
+}
+
+int main(int argc, char **argv)
+{
+	msgprop prop = {BMP_HEXA, ' ', '0'};
+	isoplan plan;
+	int port = (argc > 1)? atoi(argv[1]) : 7000;
+
+	if (compile_plan(&plan, iso87, &prop, NULL) != SUCCEEDED)
+		exit(1);
+	if (init_server(&srv, &plan, STREAM_HDR_ASCII, 4, answer, &plan, &srv_err) != SUCCEEDED
+			|| listen_server(&srv, NULL, port, 0) != SUCCEEDED) {
 		perror("server: socket");
 		exit(1);
 	}
-	for (;;)
-	{
-		if ((membersoc = accept(mssock, (struct sockaddr_in *)&client_add, &soklen)) < 0) {
-        perror("server: accept");
-        exit(1);
-		
-		}	
-		if (!fork())
-		{
-			buf = malloc(1024);
-			FILE *fp;
-			if (recv(membersoc, buf, 1024, 0))
-			{
-				
-				isomsg m;
-				int index;
-				char *xmlbuf, *isobuf;
-//				printf("\n%s", buf);
-				buf = buf + 4;
-				printf("\n%s", buf);
-				init_message(&m, BMP_HEXA);
-				if (unpack_message(&m, iso87, buf))
-				{
-					printf("\nError during unpack message");
-					exit(1);
-				}
-				fp = fopen("dump_msg.log", "wt");
-				dump_message(fp, &m, 0);
-				fclose(fp);
-				free_message(&m);
-				xmlbuf = iso_to_xml(buf, iso87, BMP_HEXA);
-				if (xmlbuf != NULL)
-				{
-					printf("Create xml dump message");
-					fp = fopen("dump_msg.xml", "wt");
-					if (fp != NULL)
-					{
-						fprintf(fp, "%s", xmlbuf);
-						fclose(fp);
-						//exit(1);
-					}
-					else
-						printf("\n Can not create file");
-					isobuf = xml_to_iso(xmlbuf, iso87, BMP_HEXA);
-					printf(xmlbuf);
-					if (isobuf == NULL)
-					{
-						printf("\nKo unpack dc message dang iso");
-						exit(1);
-					}
-					else	
-					{
-						fp = fopen("dump_msg_cvt.log", "wt");
-						dump_message(fp, &m, 0);
-						fclose(fp);
-						
-					}
-					free(xmlbuf);
-				}
-				else
-				{
-					printf("\nError during convert message");
-					exit(1);
-				}
-			}
-		
-		}
-		close(membersoc);
-	
-	}
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	printf("listening on port %d\n", port);
+	run_server(&srv);
+	printf("%ld messages served\n", served);
+	close_server(&srv);
 	return (0);
 }